@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = bench-protocol
+QT += core network testlib
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+SOURCES += src/bench_protocol.cpp \
+           ../common/colorconvert.cpp
+HEADERS += ../common/colorconvert.h
+include(../common/common.pri)
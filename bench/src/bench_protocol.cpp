@@ -0,0 +1,721 @@
+// ===============================================
+// bench/src/bench_protocol.cpp
+// Codec micro-benchmarks for common/: buildPacket, drainPackets, RecvBuffer,
+// FLAG_COMPRESSED payload codecs, the binary device batch codec and the
+// camera YUV -> RGB32 kernels
+// - QBENCHMARK timings (use -csv / -xml for machine-readable output); drainCoalesced
+//   times pre-copied buffers by hand so the copy stays out of the measurement
+// - frames/s, MB/s and allocations per frame printed for every data row
+// - decode allocation counts are asserted, so a codec change that adds a
+//   per-frame copy fails the run (regression gate for common/)
+// - every colour kernel, scalar included, is compared byte for byte against an
+//   independent copy of the original per-pixel loop, plus hand-computed clamp edges
+// - compression rows print ratio, bandwidth saved and CPU per saved KiB, and
+//   check the round trip through decodeFrames()
+// ===============================================
+
+#include <QtTest>
+#include <atomic>
+#include "protocol.h"
+#include "bufferpool.h"
+#include "compression.h"
+#include "devicedata.h"
+#include "colorconvert.h"
+
+/* ---------- allocation counter (glibc: wrap malloc family) ---------- */
+
+static std::atomic<quint64> g_allocs(0);
+static std::atomic<bool> g_countAllocs(false);
+
+#if defined(__GLIBC__)
+#define HAVE_ALLOC_COUNTER 1
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static inline void countAlloc()
+{
+    if (g_countAllocs.load(std::memory_order_relaxed)) {
+        g_allocs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+extern "C" void* malloc(size_t size) { countAlloc(); return __libc_malloc(size); }
+extern "C" void* calloc(size_t n, size_t size) { countAlloc(); return __libc_calloc(n, size); }
+extern "C" void* realloc(void* ptr, size_t size) { countAlloc(); return __libc_realloc(ptr, size); }
+#else
+#define HAVE_ALLOC_COUNTER 0
+#endif
+
+// Upper bound for a decoded frame: Packet::raw + roomId + senderId strings.
+// The amortized QVector growth stays well below one allocation per frame.
+static const double MAX_DECODE_ALLOCS_PER_FRAME = 3.5;
+
+static const int TCP_SEGMENT = 1460; // fragmented input: one Ethernet MSS per read
+
+/* ---------- helpers ---------- */
+
+// Feeds caller-owned chunks to RecvBuffer::readFrom like a socket would
+class ChunkDevice : public QIODevice {
+public:
+    ChunkDevice() { open(QIODevice::ReadOnly | QIODevice::Unbuffered); }
+    void feed(const char* data, qint64 size) { data_ = data; left_ = size; }
+    qint64 bytesAvailable() const override { return left_ + QIODevice::bytesAvailable(); }
+    bool isSequential() const override { return true; }
+
+protected:
+    qint64 readData(char* dst, qint64 maxSize) override {
+        const qint64 n = qMin(maxSize, left_);
+        memcpy(dst, data_, n);
+        data_ += n;
+        left_ -= n;
+        return n;
+    }
+    qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+    const char* data_ = nullptr;
+    qint64 left_ = 0;
+};
+
+static QJsonObject makeJson(int approxSize)
+{
+    // Same shape as a client MSG_VIDEO_FRAME / MSG_DEVICE_DATA header object
+    QJsonObject j{{"roomId", "R123"},
+                  {"sender", "factory-A"},
+                  {"ts", QDateTime::currentMSecsSinceEpoch()}};
+    const int base = toJsonBytes(j).size();
+    if (approxSize > base) {
+        j["pad"] = QString(approxSize - base - 9, QChar('x'));
+    }
+    return j;
+}
+
+static QByteArray makeStream(const QByteArray& frame, int frames)
+{
+    QByteArray stream;
+    stream.reserve(frame.size() * frames);
+    for (int i = 0; i < frames; ++i) {
+        stream.append(frame);
+    }
+    return stream;
+}
+
+// Enough frames per stream to amortize setup, bounded to ~16 MB of input
+static int framesForSize(int frameSize)
+{
+    return qBound(1, (16 * 1024 * 1024) / qMax(1, frameSize), 2000);
+}
+
+static QString sizeLabel(int bytes)
+{
+    if (bytes >= 1024 * 1024) return QString("%1MiB").arg(bytes / (1024 * 1024));
+    if (bytes >= 1024) return QString("%1KiB").arg(bytes / 1024);
+    return QString("%1B").arg(bytes);
+}
+
+static void report(const char* what, int frames, qint64 bytes, qint64 nsecs, quint64 allocs)
+{
+    const double secs = qMax<qint64>(1, nsecs) / 1e9;
+    const QString row = QString::fromLatin1(QTest::currentDataTag());
+    QString allocText = HAVE_ALLOC_COUNTER
+        ? QString::number(double(allocs) / qMax(1, frames), 'f', 2)
+        : QString("n/a");
+    qInfo().noquote() << QString("%1 %2: %3 frames/s, %4 MB/s, %5 allocs/frame")
+                         .arg(what, row)
+                         .arg(frames / secs, 0, 'f', 0)
+                         .arg(bytes / secs / 1e6, 0, 'f', 1)
+                         .arg(allocText);
+}
+
+template <typename Fn>
+static quint64 countAllocations(Fn fn)
+{
+    g_allocs.store(0);
+    g_countAllocs.store(true);
+    fn();
+    g_countAllocs.store(false);
+    return g_allocs.load();
+}
+
+// Realistic compressible payloads: one device sample, a batch of samples,
+// a page of chat history; plus incompressible bytes standing in for JPEG
+static QByteArray makeCompressionPayload(const QString& kind, QJsonObject* json)
+{
+    quint32 seed = 0x9e3779b9u;
+    auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+    auto sample = [&](int i) {
+        QJsonObject d{{"roomId", "R123"}, {"sender", "factory-A"}, {"device", "press-07"},
+                      {"ts", qint64(1700000000000LL + i * 100)}, {"status", "running"}};
+        const char* sensors[] = {"temperature", "pressure", "vibration", "current", "voltage",
+                                 "rpm", "torque", "flow", "humidity", "oilLevel"};
+        for (int k = 0; k < 10; ++k) d[sensors[k]] = 50.0 + (next() % 10000) / 100.0;
+        return d;
+    };
+
+    if (kind == "device-sample") {
+        *json = sample(0);
+    } else if (kind == "device-batch") {
+        QJsonArray samples;
+        for (int i = 0; i < 50; ++i) samples.append(sample(i));
+        *json = QJsonObject{{"roomId", "R123"}, {"sender", "factory-A"}, {"samples", samples}};
+    } else if (kind == "chat-history") {
+        const char* words[] = {"valve", "check", "the", "pressure", "on", "line", "two", "please",
+                               "ok", "restarting", "pump", "reading", "looks", "normal", "now", "send"};
+        QJsonArray messages;
+        for (int i = 0; i < 100; ++i) {
+            QStringList text;
+            for (int w = 0; w < 4 + int(next() % 12); ++w) text << words[next() % 16];
+            messages.append(QJsonObject{{"sender", i % 2 ? "expert-B" : "factory-A"},
+                                        {"content", text.join(' ')},
+                                        {"ts", qint64(1700000000000LL + i * 7000)}});
+        }
+        *json = QJsonObject{{"roomId", "R123"}, {"history", messages}};
+    } else {
+        *json = QJsonObject{{"roomId", "R123"}, {"sender", "factory-A"}};
+        QByteArray noise(16 * 1024, Qt::Uninitialized);
+        for (int i = 0; i < noise.size(); ++i) noise[i] = char(next());
+        return noise;
+    }
+    return QByteArray();
+}
+
+// Reference for the colour kernels, deliberately independent of colorconvert.cpp:
+// the original per-pixel BT.601 loop, with each pixel fetching its own samples
+static quint32 referenceYuvPixel(int y, int u, int v)
+{
+    y = y - 16;
+    u = u - 128;
+    v = v - 128;
+    const int r = qBound(0, (298 * y + 409 * v + 128) >> 8, 255);
+    const int g = qBound(0, (298 * y - 100 * u - 208 * v + 128) >> 8, 255);
+    const int b = qBound(0, (298 * y + 516 * u + 128) >> 8, 255);
+    return 0xff000000u | (quint32(r) << 16) | (quint32(g) << 8) | quint32(b); // qRgb, without QtGui
+}
+
+static QByteArray referenceYuvToRgb32(YuvFormat fmt, const YuvPlanes& planes, int width, int height)
+{
+    QByteArray out(width * height * 4, '\0');
+    quint32* dst = reinterpret_cast<quint32*>(out.data());
+    for (int row = 0; row < height; ++row) {
+        const uchar* luma = planes.data[0] + row * planes.stride[0];
+        const uchar* c1 = planes.data[1] ? planes.data[1] + (row / 2) * planes.stride[1] : nullptr;
+        const uchar* c2 = planes.data[2] ? planes.data[2] + (row / 2) * planes.stride[2] : nullptr;
+        for (int x = 0; x < width; ++x) {
+            const int pair = x & ~1;
+            int y, u, v;
+            switch (fmt) {
+            case YuvFormat::YUYV:
+                y = luma[x * 2]; u = luma[pair * 2 + 1]; v = luma[pair * 2 + 3];
+                break;
+            case YuvFormat::UYVY:
+                y = luma[x * 2 + 1]; u = luma[pair * 2]; v = luma[pair * 2 + 2];
+                break;
+            case YuvFormat::NV12:
+                y = luma[x]; u = c1[pair]; v = c1[pair + 1];
+                break;
+            case YuvFormat::I420:
+            default:
+                y = luma[x]; u = c1[x / 2]; v = c2[x / 2];
+                break;
+            }
+            dst[row * width + x] = referenceYuvPixel(y, u, v);
+        }
+    }
+    return out;
+}
+
+// A width x height frame of one colour in any format, wide enough for the SIMD bodies
+static void fillSolidYuv(YuvFormat fmt, int width, int height, int y, int u, int v,
+                         QByteArray planeData[3], YuvPlanes* planes)
+{
+    const bool packed = (fmt == YuvFormat::YUYV || fmt == YuvFormat::UYVY);
+    if (packed) {
+        const char quad[4] = {char(fmt == YuvFormat::YUYV ? y : u), char(fmt == YuvFormat::YUYV ? u : y),
+                              char(fmt == YuvFormat::YUYV ? y : v), char(fmt == YuvFormat::YUYV ? v : y)};
+        planeData[0].clear();
+        for (int i = 0; i < width * height / 2; ++i) planeData[0].append(quad, 4);
+        planes->stride[0] = width * 2;
+    } else {
+        planeData[0].fill(char(y), width * height);
+        planes->stride[0] = width;
+        if (fmt == YuvFormat::NV12) {
+            planeData[1].clear();
+            for (int i = 0; i < width * height / 4; ++i) planeData[1].append(char(u)).append(char(v));
+            planes->stride[1] = width;
+        } else {
+            planeData[1].fill(char(u), width * height / 4);
+            planeData[2].fill(char(v), width * height / 4);
+            planes->stride[1] = planes->stride[2] = width / 2;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        planes->data[i] = planeData[i].isEmpty() ? nullptr : reinterpret_cast<const uchar*>(planeData[i].constData());
+    }
+}
+
+/* ---------- benchmarks ---------- */
+
+class BenchProtocol : public QObject {
+    Q_OBJECT
+
+private:
+    void addSizeRows();
+
+private slots:
+    void initTestCase();
+
+    void buildPacket_data() { addSizeRows(); }
+    void buildPacket();
+
+    void drainCoalesced_data() { addSizeRows(); }
+    void drainCoalesced();
+
+    void drainFragmented_data() { addSizeRows(); }
+    void drainFragmented();
+
+    void recvBufferFragmented_data() { addSizeRows(); }
+    void recvBufferFragmented();
+
+    void compressFrame_data();
+    void compressFrame();
+
+    void deviceBatch_data();
+    void deviceBatch();
+
+    void yuvToRgb32_data();
+    void yuvToRgb32();
+    void yuvToRgb32Edges_data();
+    void yuvToRgb32Edges();
+};
+
+void BenchProtocol::initTestCase()
+{
+    // Per-frame qCDebug output would dominate every measurement
+    QLoggingCategory::setFilterRules("protocol.debug=false");
+}
+
+void BenchProtocol::addSizeRows()
+{
+    QTest::addColumn<int>("jsonSize");
+    QTest::addColumn<int>("binSize");
+
+    const int jsonSizes[] = {64, 1024, 16 * 1024};
+    const int binSizes[] = {0, 1024, 64 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+    for (int jsonSize : jsonSizes) {
+        for (int binSize : binSizes) {
+            const QString tag = QString("json=%1 bin=%2").arg(sizeLabel(jsonSize), sizeLabel(binSize));
+            QTest::newRow(tag.toLatin1().constData()) << jsonSize << binSize;
+        }
+    }
+}
+
+void BenchProtocol::buildPacket()
+{
+    QFETCH(int, jsonSize);
+    QFETCH(int, binSize);
+    const QJsonObject json = makeJson(jsonSize);
+    const QByteArray bin(binSize, 'b');
+
+    QBENCHMARK {
+        QByteArray frame = ::buildPacket(MSG_VIDEO_FRAME, json, bin, "R123", "factory-A");
+        Q_UNUSED(frame);
+    }
+
+    const int frames = framesForSize(jsonSize + binSize) / 4 + 1;
+    qint64 bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    const quint64 allocs = countAllocations([&]() {
+        for (int i = 0; i < frames; ++i) {
+            bytes += ::buildPacket(MSG_VIDEO_FRAME, json, bin, "R123", "factory-A").size();
+        }
+    });
+    report("buildPacket", frames, bytes, timer.nsecsElapsed(), allocs);
+}
+
+void BenchProtocol::drainCoalesced()
+{
+    QFETCH(int, jsonSize);
+    QFETCH(int, binSize);
+    const QByteArray frame = ::buildPacket(MSG_VIDEO_FRAME, makeJson(jsonSize),
+                                           QByteArray(binSize, 'b'), "R123", "factory-A");
+    const int frames = framesForSize(frame.size());
+    const QByteArray stream = makeStream(frame, frames);
+
+    // drainPackets() consumes its buffer, and remove() on a buffer shared with
+    // `stream` may copy it. Every timed pass gets its own detached copy, made
+    // before the clock starts, so only decoding is measured (QBENCHMARK cannot
+    // exclude per-iteration setup, hence the manual timing)
+    const int passes = qBound(1, (64 * 1024 * 1024) / qMax(1, stream.size()), 16);
+    QVector<QByteArray> buffers(passes);
+    for (QByteArray& buffer : buffers) {
+        buffer = stream;
+        buffer.detach();
+    }
+    QVector<Packet> out;
+    out.reserve(frames);
+    QElapsedTimer timer;
+    timer.start();
+    for (QByteArray& buffer : buffers) {
+        out.clear();
+        ::drainPackets(buffer, out);
+    }
+    QTest::setBenchmarkResult(qreal(timer.nsecsElapsed()) / passes, QTest::WalltimeNanoseconds);
+    QCOMPARE(out.size(), frames);
+
+    QByteArray buffer = stream;
+    buffer.detach();
+    out.clear();
+    timer.restart();
+    const quint64 allocs = countAllocations([&]() {
+        ::drainPackets(buffer, out);
+    });
+    report("drainPackets/coalesced", frames, stream.size(), timer.nsecsElapsed(), allocs);
+#if HAVE_ALLOC_COUNTER
+    QVERIFY2(double(allocs) / frames <= MAX_DECODE_ALLOCS_PER_FRAME, "decode allocations per frame regressed");
+#endif
+}
+
+void BenchProtocol::drainFragmented()
+{
+    QFETCH(int, jsonSize);
+    QFETCH(int, binSize);
+    const QByteArray frame = ::buildPacket(MSG_VIDEO_FRAME, makeJson(jsonSize),
+                                           QByteArray(binSize, 'b'), "R123", "factory-A");
+    const int frames = qMin(framesForSize(frame.size()), 200);
+    const QByteArray stream = makeStream(frame, frames);
+
+    // Legacy path: append every segment to a QByteArray and drain it
+    auto run = [&]() {
+        QByteArray buffer;
+        QVector<Packet> out;
+        int decoded = 0;
+        for (int offset = 0; offset < stream.size(); offset += TCP_SEGMENT) {
+            buffer.append(stream.constData() + offset, qMin(TCP_SEGMENT, stream.size() - offset));
+            out.clear();
+            ::drainPackets(buffer, out);
+            decoded += out.size();
+        }
+        return decoded;
+    };
+
+    int decoded = 0;
+    QBENCHMARK {
+        decoded = run();
+    }
+    QCOMPARE(decoded, frames);
+
+    QElapsedTimer timer;
+    timer.start();
+    const quint64 allocs = countAllocations([&]() { run(); });
+    report("drainPackets/fragmented", frames, stream.size(), timer.nsecsElapsed(), allocs);
+}
+
+void BenchProtocol::recvBufferFragmented()
+{
+    QFETCH(int, jsonSize);
+    QFETCH(int, binSize);
+    const QByteArray frame = ::buildPacket(MSG_VIDEO_FRAME, makeJson(jsonSize),
+                                           QByteArray(binSize, 'b'), "R123", "factory-A");
+    const int frames = qMin(framesForSize(frame.size()), 200);
+    const QByteArray stream = makeStream(frame, frames);
+
+    // Server/client path: segments read straight into a pooled block, decoded in place
+    ChunkDevice device;
+    QVector<Packet> out;
+    auto run = [&]() {
+        RecvBuffer rx;
+        int decoded = 0;
+        for (int offset = 0; offset < stream.size(); offset += TCP_SEGMENT) {
+            device.feed(stream.constData() + offset, qMin(TCP_SEGMENT, stream.size() - offset));
+            rx.readFrom(&device);
+            out.clear();
+            rx.decode(out);
+            decoded += out.size();
+        }
+        return decoded;
+    };
+
+    int decoded = 0;
+    QBENCHMARK {
+        decoded = run();
+    }
+    QCOMPARE(decoded, frames);
+
+    QElapsedTimer timer;
+    timer.start();
+    const quint64 allocs = countAllocations([&]() { run(); });
+    report("RecvBuffer/fragmented", frames, stream.size(), timer.nsecsElapsed(), allocs);
+#if HAVE_ALLOC_COUNTER
+    // Blocks come from the pool; only frames that outgrow the slab reallocate
+    if (frame.size() < RECV_SLAB_SIZE) {
+        QVERIFY2(double(allocs) / frames <= MAX_DECODE_ALLOCS_PER_FRAME, "decode allocations per frame regressed");
+    }
+#endif
+}
+
+void BenchProtocol::compressFrame_data()
+{
+    QTest::addColumn<QString>("payload");
+    QTest::addColumn<int>("codec");
+
+    const char* payloads[] = {"device-sample", "device-batch", "chat-history", "jpeg-like"};
+    for (const char* payload : payloads) {
+        for (CompressionCodec codec : {CODEC_ZLIB, CODEC_LZ4}) {
+            const QString tag = QString("%1 %2").arg(payload, compressionCodecName(codec));
+            QTest::newRow(tag.toLatin1().constData()) << QString(payload) << int(codec);
+        }
+    }
+}
+
+void BenchProtocol::compressFrame()
+{
+    QFETCH(QString, payload);
+    QFETCH(int, codec);
+    const CompressionCodec c = CompressionCodec(codec);
+    if (!compressionCodecAvailable(c)) {
+        QSKIP("codec not built in (liblz4 missing)");
+    }
+    QJsonObject json;
+    const QByteArray bin = makeCompressionPayload(payload, &json);
+    const quint16 type = bin.isEmpty() ? MSG_DEVICE_DATA : MSG_VIDEO_FRAME;
+    const QByteArray frame = ::buildPacket(type, json, bin, "R123", "factory-A");
+
+    QByteArray packed;
+    QBENCHMARK {
+        packed = ::compressFrame(frame, c);
+    }
+
+    // Video stays as it is; everything else must shrink and survive the round trip
+    if (type == MSG_VIDEO_FRAME) {
+        QVERIFY(packed == frame);
+        return;
+    }
+    QVERIFY(packed.size() < frame.size());
+    QVector<Packet> out;
+    QCOMPARE(::decodeFrames(packed.constData(), packed.size(), out), packed.size());
+    QCOMPARE(out.size(), 1);
+    QVERIFY(out[0].flags & FLAG_COMPRESSED);
+    QCOMPARE(out[0].json(), json);
+    QCOMPARE(::decompressFrame(packed).mid(sizeof(FrameHeader)), frame.mid(sizeof(FrameHeader)));
+
+    const int rounds = qBound(100, (8 * 1024 * 1024) / frame.size(), 20000);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < rounds; ++i) {
+        packed = ::compressFrame(frame, c);
+    }
+    const qint64 compressNs = timer.nsecsElapsed();
+    timer.restart();
+    for (int i = 0; i < rounds; ++i) {
+        QByteArray body;
+        ::inflateFrameBody(packed, &body);
+        ::releaseInflated(body);
+    }
+    const qint64 inflateNs = timer.nsecsElapsed();
+
+    const double saved = double(frame.size() - packed.size());
+    const double cpuUsPerFrame = double(compressNs + inflateNs) / rounds / 1000.0;
+    qInfo().noquote() << QString("compressFrame %1: %2 -> %3 bytes (%4% saved), compress %5 MB/s, "
+                                 "inflate %6 MB/s, %7 us CPU per KiB saved")
+                         .arg(QString::fromLatin1(QTest::currentDataTag()))
+                         .arg(frame.size())
+                         .arg(packed.size())
+                         .arg(100.0 * saved / frame.size(), 0, 'f', 1)
+                         .arg(double(frame.size()) * rounds / (compressNs / 1e9) / 1e6, 0, 'f', 1)
+                         .arg(double(frame.size()) * rounds / (inflateNs / 1e9) / 1e6, 0, 'f', 1)
+                         .arg(cpuUsPerFrame / (saved / 1024.0), 0, 'f', 2);
+}
+
+void BenchProtocol::deviceBatch_data()
+{
+    QTest::addColumn<int>("samples");
+    QTest::addColumn<int>("channels");
+
+    for (int samples : {100, 1000, 10000}) {
+        for (int channels : {3, 16}) {
+            const QString tag = QString("samples=%1 channels=%2").arg(samples).arg(channels);
+            QTest::newRow(tag.toLatin1().constData()) << samples << channels;
+        }
+    }
+}
+
+void BenchProtocol::deviceBatch()
+{
+    QFETCH(int, samples);
+    QFETCH(int, channels);
+
+    // Half float channels, half int16 raw channels, 1 kHz uniform sampling
+    DeviceSchema schema;
+    schema.schemaId = 7;
+    for (int c = 0; c < channels; ++c) {
+        DeviceChannel ch;
+        ch.id = quint16(c + 1);
+        ch.name = QString("ch%1").arg(c + 1);
+        if (c % 2) {
+            ch.type = DeviceSampleType::Int16;
+            ch.scale = 0.001;
+        }
+        schema.channels.append(ch);
+    }
+    DeviceBatchBuilder builder(schema, samples);
+    QVector<double> row(channels);
+    for (int i = 0; i < samples; ++i) {
+        for (int c = 0; c < channels; ++c) row[c] = qSin(i * 0.01 + c);
+        builder.append(1700000000000000LL + i * 1000, row.constData());
+    }
+    const DeviceBatch batch = builder.take();
+    QVERIFY(batch.intervalUs == 1000);
+
+    QByteArray bin;
+    QBENCHMARK {
+        bin = encodeDeviceBatch(batch);
+    }
+
+    // Same samples as the JSON a client would otherwise send: one object per sample
+    QJsonArray rows;
+    for (int i = 0; i < samples; ++i) {
+        QJsonObject o{{"ts", batch.timestampUs(i)}};
+        for (int c = 0; c < channels; ++c) o[schema.channels.at(c).name] = batch.columns.at(c).value(i, schema.channels.at(c).scale);
+        rows.append(o);
+    }
+    const QByteArray json = toJsonBytes(QJsonObject{{"samples", rows}});
+
+    const int rounds = qBound(10, 2000000 / (samples * channels), 2000);
+    DeviceBatch decoded;
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0; r < rounds; ++r) {
+        QVERIFY(decodeDeviceBatch(bin, &decoded));
+    }
+    const qint64 binaryNs = timer.nsecsElapsed();
+    const int jsonRounds = qMax(1, rounds / 10); // JSON is far slower; scale back to `rounds`
+    timer.restart();
+    for (int r = 0; r < jsonRounds; ++r) {
+        const QJsonArray parsed = fromJsonBytes(json).value("samples").toArray();
+        QCOMPARE(parsed.size(), samples);
+    }
+    const qint64 jsonNs = timer.nsecsElapsed() * rounds / jsonRounds;
+
+    QCOMPARE(decoded.sampleCount, samples);
+    for (int c = 0; c < channels; ++c) {
+        QCOMPARE(decoded.columns.at(c).channel, batch.columns.at(c).channel);
+        QCOMPARE(decoded.columns.at(c).floats, batch.columns.at(c).floats);
+        QCOMPARE(decoded.columns.at(c).ints, batch.columns.at(c).ints);
+    }
+    const double values = double(samples) * channels * rounds;
+    qInfo().noquote() << QString("deviceBatch %1: %2 bytes binary vs %3 bytes JSON, decode %4 Msamples/s binary vs %5 JSON")
+                         .arg(QString::fromLatin1(QTest::currentDataTag()))
+                         .arg(bin.size())
+                         .arg(json.size())
+                         .arg(values / (binaryNs / 1e9) / 1e6, 0, 'f', 1)
+                         .arg(values / (jsonNs / 1e9) / 1e6, 0, 'f', 2);
+}
+
+void BenchProtocol::yuvToRgb32_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("kernel");
+
+    const char* formats[] = {"YUYV", "UYVY", "NV12", "I420"};
+    for (int f = 0; f < 4; ++f) {
+        for (int k = int(ColorKernel::Scalar); k <= int(ColorKernel::AVX2); ++k) {
+            const QString tag = QString("%1 %2").arg(formats[f], colorKernelName(ColorKernel(k)));
+            QTest::newRow(tag.toLatin1().constData()) << f << k;
+        }
+    }
+}
+
+void BenchProtocol::yuvToRgb32()
+{
+    QFETCH(int, format);
+    QFETCH(int, kernel);
+    // 1080p plus an odd width so the scalar tail after the SIMD body is covered
+    const int width = 1921, height = 1080;
+    const YuvFormat fmt = YuvFormat(format);
+    const bool packed = (fmt == YuvFormat::YUYV || fmt == YuvFormat::UYVY);
+    const int lumaStride = packed ? (width + 1) * 2 : width;
+    const int chromaStride = (fmt == YuvFormat::NV12) ? width + 1 : (width + 1) / 2;
+
+    QByteArray planeData[3];
+    planeData[0].resize(lumaStride * height);
+    planeData[1].resize(chromaStride * ((height + 1) / 2));
+    planeData[2].resize(chromaStride * ((height + 1) / 2));
+    quint32 seed = 0x2545f491u;
+    YuvPlanes planes;
+    for (int i = 0; i < 3; ++i) {
+        for (int b = 0; b < planeData[i].size(); ++b) {
+            seed = seed * 1664525u + 1013904223u;
+            planeData[i][b] = char(seed >> 24);
+        }
+        planes.data[i] = reinterpret_cast<const uchar*>(planeData[i].constData());
+        planes.stride[i] = (i == 0) ? lumaStride : chromaStride;
+    }
+
+    const QByteArray expected = referenceYuvToRgb32(fmt, planes, width, height);
+
+    if (setColorKernel(ColorKernel(kernel)) != ColorKernel(kernel)) {
+        QSKIP("kernel not supported by this CPU");
+    }
+    QByteArray out(width * height * 4, '\0');
+    QBENCHMARK {
+        convertYuvToRgb32(fmt, planes, width, height, reinterpret_cast<uchar*>(out.data()), width * 4);
+    }
+    setColorKernel(ColorKernel::AVX2); // back to the best supported kernel
+    QVERIFY2(out == expected, "kernel output differs from the original per-pixel formula");
+}
+
+void BenchProtocol::yuvToRgb32Edges_data()
+{
+    QTest::addColumn<int>("y");
+    QTest::addColumn<int>("u");
+    QTest::addColumn<int>("v");
+    QTest::addColumn<uint>("rgb");
+
+    // Computed by hand from the formula; each row hits at least one clamp
+    QTest::newRow("Y0 grey") << 0 << 128 << 128 << 0xff000000u;
+    QTest::newRow("Y16 grey") << 16 << 128 << 128 << 0xff000000u;
+    QTest::newRow("Y235 grey") << 235 << 128 << 128 << 0xffffffffu;
+    QTest::newRow("Y255 grey") << 255 << 128 << 128 << 0xffffffffu;
+    QTest::newRow("U0 V0") << 128 << 0 << 0 << 0xff00ff00u;
+    QTest::newRow("U255 V255") << 128 << 255 << 255 << 0xffff00ffu;
+    QTest::newRow("Y0 U0 V0") << 0 << 0 << 0 << 0xff008700u;
+    QTest::newRow("Y255 U255 V255") << 255 << 255 << 255 << 0xffff7dffu;
+    QTest::newRow("Y255 U0 V255") << 255 << 0 << 255 << 0xffffe114u;
+    QTest::newRow("Y0 U255 V0") << 0 << 255 << 0 << 0xff0024edu;
+}
+
+void BenchProtocol::yuvToRgb32Edges()
+{
+    QFETCH(int, y);
+    QFETCH(int, u);
+    QFETCH(int, v);
+    QFETCH(uint, rgb);
+    QCOMPARE(uint(referenceYuvPixel(y, u, v)), rgb);
+
+    const int width = 64, height = 2;
+    const YuvFormat formats[] = {YuvFormat::YUYV, YuvFormat::UYVY, YuvFormat::NV12, YuvFormat::I420};
+    for (int k = int(ColorKernel::Scalar); k <= int(ColorKernel::AVX2); ++k) {
+        if (setColorKernel(ColorKernel(k)) != ColorKernel(k)) continue; // not on this CPU
+        for (YuvFormat fmt : formats) {
+            QByteArray planeData[3];
+            YuvPlanes planes;
+            fillSolidYuv(fmt, width, height, y, u, v, planeData, &planes);
+            QVector<quint32> out(width * height, 0);
+            QVERIFY(convertYuvToRgb32(fmt, planes, width, height,
+                                      reinterpret_cast<uchar*>(out.data()), width * 4));
+            for (int i = 0; i < out.size(); ++i) {
+                if (out[i] != rgb) {
+                    QFAIL(qPrintable(QString("%1 format %2 pixel %3: %4, expected %5")
+                                         .arg(colorKernelName(ColorKernel(k))).arg(int(fmt)).arg(i)
+                                         .arg(out[i], 8, 16, QChar('0')).arg(rgb, 8, 16, QChar('0'))));
+                }
+            }
+        }
+    }
+    setColorKernel(ColorKernel::AVX2); // back to the best supported kernel
+}
+
+QTEST_GUILESS_MAIN(BenchProtocol)
+#include "bench_protocol.moc"
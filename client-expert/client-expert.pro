@@ -9,6 +9,7 @@ HEADERS += src/mainwindow.h \
            src/clientconn.h
 FORMS   +=
 include(../common/common.pri)
+include(../common/media.pri)
 QT += core gui multimedia multimediawidgets
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
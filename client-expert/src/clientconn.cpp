@@ -1,37 +1,253 @@
 #include "clientconn.h"
 
+// 下行可靠流的 ACK 攒批间隔（与服务器回上行 ACK 的节奏一致）
+static const int ACK_BATCH_MS = 20;
+
+// 重连退避：从 RECONNECT_MIN_MS 起每次翻倍，封顶 RECONNECT_MAX_MS，并在后一半区间里随机（避免一起重连）
+static const int RECONNECT_MIN_MS = 500;
+static const int RECONNECT_MAX_MS = 30 * 1000;
+
 // 构造函数：创建socket并挂载事件回调
 ClientConn::ClientConn(QObject* parent) : QObject(parent) {
     connect(&sock_, &QTcpSocket::readyRead, this, &ClientConn::onReadyRead);
     connect(&sock_, &QTcpSocket::connected,  this, &ClientConn::onConnected);
     connect(&sock_, &QTcpSocket::disconnected, this, &ClientConn::onDisconnected);
+    connect(&sock_, &QTcpSocket::bytesWritten, this, &ClientConn::onBytesWritten);
+    livenessTimer_.setInterval(int(HEARTBEAT_INTERVAL_MS));
+    connect(&livenessTimer_, &QTimer::timeout, this, &ClientConn::onLivenessTimer);
+    connect(&sock_, &QTcpSocket::stateChanged, this, &ClientConn::onStateChanged);
+    feedbackTimer_.setSingleShot(true);
+    feedbackTimer_.setInterval(ACK_BATCH_MS);
+    connect(&feedbackTimer_, &QTimer::timeout, this, &ClientConn::onFeedbackTimer);
+    reconnectTimer_.setSingleShot(true);
+    connect(&reconnectTimer_, &QTimer::timeout, this, &ClientConn::reconnect);
 }
 
 // 连接到指定主机端口
 void ClientConn::connectTo(const QString& host, quint16 port) {
+    host_ = host;
+    port_ = port;
+    reconnectTimer_.stop();
+    reconnectAttempt_ = 0;
     sock_.connectToHost(host, port);
 }
 
-// 发送协议包：封包为 [type|len|json|bin] 写入socket
-void ClientConn::send(quint16 type, const QJsonObject& json, const QByteArray& bin) {
-    sock_.write(buildPacket(type, json, bin));
+void ClientConn::setAutoReconnect(bool on) {
+    autoReconnect_ = on;
+    if (!on) {
+        reconnectTimer_.stop();
+        reconnectAttempt_ = 0;
+    }
+}
+
+// 安排下一次重连；已经排上了就不重复
+void ClientConn::scheduleReconnect() {
+    if (!autoReconnect_ || host_.isEmpty() || reconnectTimer_.isActive()) return;
+    const int shift = qMin(reconnectAttempt_, 16);
+    const int ceiling = int(qMin<qint64>(RECONNECT_MAX_MS, qint64(RECONNECT_MIN_MS) << shift));
+    const int delayMs = ceiling / 2 + int(QRandomGenerator::global()->bounded(ceiling / 2 + 1));
+    reconnectAttempt_++;
+    reconnectTimer_.start(delayMs);
+    emit reconnecting(reconnectAttempt_, delayMs);
+}
+
+void ClientConn::reconnect() {
+    if (sock_.state() != QAbstractSocket::UnconnectedState) return;
+    sock_.connectToHost(host_, port_);
 }
 
+// 重连没连上（不会触发 disconnected）：接着退避
+void ClientConn::onStateChanged(QAbstractSocket::SocketState state) {
+    if (state == QAbstractSocket::UnconnectedState && reconnectAttempt_ > 0) scheduleReconnect();
+}
+
+void ClientConn::resendUnacked() {
+    for (const ReliableFrame& f : reliable_.unacked()) txq_.enqueue(f.type, f.frame, f.flags);
+    txq_.pump(&sock_);
+}
+
+// 发送协议包：封包后进入发送队列，socket 缓冲有空间时按优先级写出
+// 控制命令不会排在大量视频帧之后；积压超限时先丢旧视频帧
+void ClientConn::send(quint16 type, const QJsonObject& json, const QByteArray& bin, quint16 flags, quint16 layer) {
+    // 记下加入的用户名，会话恢复时告诉服务器
+    if (type == MSG_JOIN_WORKORDER && json.contains("user")) resumeUser_ = json.value("user").toString();
+    // 控制/文本要求确认（逐流编号，重传缓冲保留到 ACK）；媒体仍是尽力而为
+    quint32 seq = 0;
+    if (isReliableType(type)) {
+        flags |= FLAG_ACK_REQUIRED;
+        seq = reliable_.nextSeq(type);
+    }
+    // 文本/设备数据等超过阈值时按协商的编码压缩，视频音频原样发送
+    const QByteArray frame = compressFrame(buildPacket(type, json, bin, QString(), QString(), flags, seq, layer),
+                                           compression_);
+    if (seq) {
+        ReliableFrame f;
+        f.type = type;
+        f.seq = seq;
+        f.flags = flags;
+        f.frame = frame;
+        reliable_.store(f);
+        // 断线或恢复/重新加入前先不发：连上后从重传缓冲按服务器确认到的位置补发，免得重复或错号
+        if (!isConnected() || resuming_ || resendAfterJoin_) return;
+    }
+    txq_.enqueue(type, frame, flags);
+    if (isConnected()) txq_.pump(&sock_);
+}
+
+qint64 ClientConn::pendingBytes() const {
+    return txq_.queuedBytes() + sock_.bytesToWrite();
+}
+
+// socket 缓冲有空间了 -> 继续从发送队列补帧
+void ClientConn::onBytesWritten(qint64 bytes) { bytesSent_ += bytes; txq_.pump(&sock_); }
+
 // 检查连接状态
 bool ClientConn::isConnected() const {
     return sock_.state() == QAbstractSocket::ConnectedState;
 }
 
 // socket已连接 -> 转发connected信号
-void ClientConn::onConnected() { emit connected(); }
+void ClientConn::onConnected() {
+    lastRxMs_ = heartbeatClockUs() / 1000;
+    livenessTimer_.start();
+    reconnectTimer_.stop();
+    // 登录过：先出示令牌和房间号恢复会话（插到最前），不必重新登录、加入
+    if (!sessionToken_.isEmpty()) {
+        resuming_ = true;
+        QJsonObject req{{"token", sessionToken_}, {"roomId", resumeRoom_}, {"compress", compressionOffer()}};
+        if (!resumeUser_.isEmpty()) req["user"] = resumeUser_;
+        // 下行各流收到哪里：服务器从下一条补发断线时没送到的控制/文本
+        req["ack"] = reliableRx_.takeAck(true).value("ack");
+        txq_.enqueue(MSG_RESUME_SESSION, buildPacket(MSG_RESUME_SESSION, req), FLAG_PRIORITY);
+    } else {
+        reconnectAttempt_ = 0;
+        reliableRx_ = ReliableReceiver(); // 服务器为新连接的下行流从 1 开始编号
+    }
+    txq_.pump(&sock_);
+    emit connected();
+}
 // socket断开 -> 转发disconnected信号
-void ClientConn::onDisconnected() { emit disconnected(); }
+void ClientConn::onDisconnected() {
+    livenessTimer_.stop();
+    feedbackTimer_.stop();
+    serverHeartbeats_ = false;
+    resuming_ = false;
+    if (autoReconnect_ && !sessionToken_.isEmpty()) {
+        // 准备恢复会话：服务器保留着收到哪里，未确认的帧保持原序号，恢复后从确认位置补发
+    } else {
+        // 新连接上服务器从 1 开始收：未确认的帧保留并重新编号，等重新加入房间后重发
+        if (reliable_.size() > 0) {
+            reliable_.renumber();
+            resendAfterJoin_ = true;
+        }
+        sessionToken_.clear();
+        resumeRoom_.clear();
+    }
+    rttMs_ = -1;
+    jitterMs_ = 0;
+    txq_.clear(); rx_.release(); compression_ = CODEC_NONE;
+    scheduleReconnect();
+    emit disconnected();
+}
+
+// Wi-Fi 掉线时 TCP 不会很快报错：服务器心跳停了就当连接已死，立即断开
+void ClientConn::onLivenessTimer() {
+    if (!serverHeartbeats_) return;
+    const qint64 silentMs = heartbeatClockUs() / 1000 - lastRxMs_;
+    if (silentMs >= HEARTBEAT_TIMEOUT_MS) {
+        qWarning() << "ClientConn: no data from server for" << silentMs << "ms, dropping connection";
+        sock_.abort();
+    }
+}
+
+// 下行可靠流：累计 ACK；缺号超过 NACK 延迟才请求重传，还有洞就过一会儿再看
+void ClientConn::onFeedbackTimer() {
+    const QJsonObject ack = reliableRx_.takeAck();
+    if (!ack.isEmpty()) send(MSG_ACK, ack);
+    const QJsonObject nack = reliableRx_.takeNack(heartbeatClockUs() / 1000);
+    if (!nack.isEmpty()) send(MSG_NACK, nack);
+    if (reliableRx_.hasGaps()) feedbackTimer_.start();
+}
 
-// 收到数据 -> 累加到缓冲并尽可能解析成Packet，逐个发出
+// 收到数据 -> 直接读入接收块并原地解析成Packet，逐个发出
 void ClientConn::onReadyRead() {
-    buf_.append(sock_.readAll());
+    lastRxMs_ = heartbeatClockUs() / 1000;
+    rx_.readFrom(&sock_);
     QVector<Packet> pkts;
-    if (drainPackets(buf_, pkts)) {
-        for (auto& p : pkts) emit packetArrived(p);
+    rx_.decode(pkts);
+    for (auto& p : pkts) {
+        // 服务器心跳：原样回显时间戳（控制类，越过排队的视频），顺带带回服务器测得的 RTT
+        if (p.type == MSG_HEARTBEAT) {
+            serverHeartbeats_ = true;
+            send(MSG_ACK, QJsonObject{{"hb", p.json().value("hb")}});
+            if (p.json().contains("rtt")) {
+                rttMs_ = p.json().value("rtt").toDouble();
+                jitterMs_ = p.json().value("jitter").toDouble();
+                emit rttUpdated(rttMs_, jitterMs_);
+            }
+            continue;
+        }
+        // 可靠流的确认/重传请求只在连接层处理
+        if (p.type == MSG_ACK) {
+            reliable_.onAck(p.json());
+            continue;
+        }
+        if (p.type == MSG_NACK) {
+            for (const ReliableFrame& f : reliable_.onNack(p.json())) txq_.enqueue(f.type, f.frame, f.flags);
+            txq_.pump(&sock_);
+            continue;
+        }
+        // 服务器下发的控制/文本：重传或重复的帧只补 ACK，不再交给界面
+        if ((p.flags & FLAG_ACK_REQUIRED) && isReliableType(p.type)) {
+            const bool fresh = reliableRx_.accept(p.type, p.seq, heartbeatClockUs() / 1000);
+            if (!feedbackTimer_.isActive()) feedbackTimer_.start();
+            if (!fresh) continue;
+        }
+        // 登录成功应答里带着服务器选定的压缩编码（请求时用 compressionOffer() 报能力）
+        if (p.type == MSG_SERVER_EVENT && p.json().contains("compress")) {
+            compression_ = compressionCodecFromName(p.json().value("compress").toString());
+        }
+        if (p.type == MSG_SERVER_EVENT) {
+            const QString message = p.json().value("message").toString();
+            if (message == "login successful") {
+                sessionToken_ = p.json().value("token").toString();
+            } else if (message == "joined") {
+                resumeRoom_ = p.json().value("roomId").toString();
+                // 断线前没确认的控制/文本：认证并进入房间后才能被转发，所以等 joined 再重发
+                if (resendAfterJoin_) {
+                    resendAfterJoin_ = false;
+                    resendUnacked();
+                }
+            } else if (message == "resumed") {
+                // 服务器保留了上下文就带回各流收到的位置，从下一条补发；否则它从 1 开始收
+                resuming_ = false;
+                resendAfterJoin_ = false;
+                if (p.json().value("restored").toBool()) {
+                    reliable_.onAck(p.json());
+                } else {
+                    reliable_.renumber();
+                    reliableRx_ = ReliableReceiver(); // 服务器没保留上下文：下行流重新从 1 编号
+                }
+                resumeRoom_ = p.json().value("roomId").toString();
+                reconnectAttempt_ = 0;
+                resendUnacked();
+                emit resumed(resumeRoom_);
+                continue;
+            } else if (message == "resume failed") {
+                // 令牌失效（服务器重启/过期）：回到未登录状态，重新登录并加入后再补发
+                resuming_ = false;
+                sessionToken_.clear();
+                resumeRoom_.clear();
+                reconnectAttempt_ = 0;
+                reliableRx_ = ReliableReceiver();
+                if (reliable_.size() > 0) {
+                    reliable_.renumber();
+                    resendAfterJoin_ = true;
+                }
+                emit resumeFailed(p.json().value("message").toString());
+                continue;
+            }
+        }
+        emit packetArrived(p);
     }
 }
@@ -2,10 +2,16 @@
 // ===============================================
 // 客户端连接封装（两端共用一份拷贝）
 // 提供：connectTo(host,port)、sendPacket(type,json,bin)、信号 packetArrived
+// 可选自动重连：指数退避，登录过则用缓存的会话令牌 + 房间号一次往返恢复（MSG_RESUME_SESSION）
 // ===============================================
 #include <QtCore>
 #include <QtNetwork>
 #include "../../common/protocol.h"
+#include "../../common/sendqueue.h"
+#include "../../common/bufferpool.h"
+#include "../../common/compression.h"
+#include "../../common/heartbeat.h"
+#include "../../common/reliable.h"
 
 
 
@@ -14,17 +20,63 @@ class ClientConn : public QObject {
 public:
     explicit ClientConn(QObject* parent=nullptr); // 构造：初始化QTcpSocket并连接信号
     void connectTo(const QString& host, quint16 port); // 主动发起到服务器的TCP连接
-    void send(quint16 type, const QJsonObject& json, const QByteArray& bin = QByteArray()); // 发送一个协议包
+    void send(quint16 type, const QJsonObject& json, const QByteArray& bin = QByteArray(),
+              quint16 flags = FLAG_NONE, quint16 layer = 0); // 发送一个协议包（按优先级排队，FLAG_PRIORITY 插到最前；layer 为分层视频层号）
+    qint64 pendingBytes() const; // 尚未写入网络的字节数（发送队列 + socket 缓冲）
+    qint64 bytesSent() const { return bytesSent_; } // 累计已写入网络的字节数（用于估算上行速率）
+    quint64 droppedVideo() const { return txq_.stats().droppedVideo; } // 积压时被丢弃的视频帧数
     bool isConnected() const; // 检查是否已连接到服务器
+    CompressionCodec compression() const { return compression_; } // 登录时与服务器协商出的压缩编码
+    double rttMs() const { return rttMs_; }       // 服务器心跳测得的往返时延，未测到为 -1
+    double jitterMs() const { return jitterMs_; }
+    int unackedFrames() const { return reliable_.size(); } // 控制/文本帧中服务器尚未确认的
+    void setAutoReconnect(bool on); // 意外断线后按指数退避自动重连（默认关闭）
+    bool willReconnect() const { return autoReconnect_ && (reconnectTimer_.isActive() || reconnectAttempt_ > 0); }
 signals: // 对外信号（供UI层连接）
     void connected();
     void disconnected();
-    void packetArrived(Packet pkt);
+    void packetArrived(Packet pkt); // 心跳不会出现在这里，由连接层自己应答
+    void rttUpdated(double rttMs, double jitterMs); // 每个服务器心跳一次（最近一次样本，未平滑）
+    void reconnecting(int attempt, int delayMs);    // 已安排第 attempt 次重连
+    void resumed(const QString& roomId);            // 会话已恢复（已认证，roomId 非空表示已回到房间）
+    void resumeFailed(const QString& reason);       // 令牌失效：需要重新登录
 private slots: // 内部槽函数（socket事件）
     void onReadyRead();
     void onConnected();
     void onDisconnected();
+    void onBytesWritten(qint64 bytes);
+    void onLivenessTimer();
+    void onFeedbackTimer();
+    void onStateChanged(QAbstractSocket::SocketState state);
+    void reconnect();
 private:
     QTcpSocket sock_;
-    QByteArray buf_;
+    RecvBuffer rx_; // 流式拆帧：读游标 + 每批只压缩一次
+    SendQueue txq_; // 严格优先级：控制 > 音频 > 文本 > 视频
+    qint64 bytesSent_ = 0;
+    CompressionCodec compression_ = CODEC_NONE; // 登录应答带 "compress" 后启用，断线复位
+    // 存活检测：服务器发过心跳后，超过 HEARTBEAT_TIMEOUT_MS 没收到任何数据就主动断开
+    QTimer livenessTimer_;
+    qint64 lastRxMs_ = 0;
+    bool serverHeartbeats_ = false; // 旧服务器不发心跳，不能据此判死
+    double rttMs_ = -1;
+    double jitterMs_ = 0;
+    // 控制/文本走可靠流：带 FLAG_ACK_REQUIRED 和逐流序号，未确认的帧留在有界重传缓冲里
+    ReliableSender reliable_;
+    bool resendAfterJoin_ = false; // 断线时有未确认帧：重新加入房间后重发
+    // 服务器下发的控制/文本同样是可靠流：去重，攒一小段时间回累计 ACK / NACK
+    ReliableReceiver reliableRx_;
+    QTimer feedbackTimer_;
+    // 自动重连与会话恢复
+    void scheduleReconnect();
+    void resendUnacked();
+    QString host_;
+    quint16 port_ = 0;
+    bool autoReconnect_ = false;
+    QTimer reconnectTimer_;
+    int reconnectAttempt_ = 0;
+    QString sessionToken_; // 登录应答里的令牌，断线重连时出示
+    QString resumeRoom_;   // 最近加入的房间
+    QString resumeUser_;
+    bool resuming_ = false; // 已发恢复请求、等待应答：期间可靠帧只进重传缓冲
 };
@@ -17,6 +17,7 @@
 #include <QPixmap>
 #include <QCheckBox>
 #include <QMessageBox>
+#include "logsink.h"
 
 // 假设这些宏和类在其他地方定义
 // #define MSG_JOIN_WORKORDER 100
@@ -59,6 +60,8 @@ MainWindow::MainWindow(QWidget *parent)
 
     /* 日志 */
     txtLog = new QTextEdit; txtLog->setReadOnly(true);
+    // 日志：定时批量刷到控件（最多 2000 行，重复行合并），完整历史写滚动文件
+    log_ = new LogSink(txtLog, LogSink::defaultLogPath("client-factory"), 2000, 4 * 1024 * 1024, 3, this);
     lay->addWidget(txtLog);
 
     /* 视频区 - 本地和远端视频并排显示 */
@@ -75,6 +78,9 @@ MainWindow::MainWindow(QWidget *parent)
     localLabel->setAlignment(Qt::AlignCenter);
     localVideoLayout->addWidget(localLabel);
     localVideoLayout->addWidget(videoLabel_);
+    videoStatsLabel_ = new QLabel;
+    videoStatsLabel_->setAlignment(Qt::AlignCenter);
+    localVideoLayout->addWidget(videoStatsLabel_);
     
     // 远端视频显示 (右侧)
     QVBoxLayout *remoteVideoLayout = new QVBoxLayout;
@@ -119,13 +125,32 @@ MainWindow::MainWindow(QWidget *parent)
     connect(&conn_,    &ClientConn::packetArrived, this, &MainWindow::onPkt);
     connect(&conn_,    &ClientConn::connected, this, &MainWindow::onConnected);
     connect(&conn_,    &ClientConn::disconnected, this, &MainWindow::onDisconnected);
+    // 现场网络不稳：断线后自动重连并回到原房间
+    conn_.setAutoReconnect(true);
+    connect(&conn_,    &ClientConn::reconnecting, this, [this](int attempt, int delayMs) {
+        log_->append(QString("%1 ms 后第 %2 次重连").arg(delayMs).arg(attempt));
+    });
+    connect(&conn_,    &ClientConn::rttUpdated, this, [this](double rttMs, double) {
+        adapt_.reportRtt(qRound64(rttMs)); // 码率控制用服务器心跳测得的 RTT
+    });
+    connect(&pipeline_, &VideoPipeline::previewReady, this, &MainWindow::onPreviewReady);
+    connect(&pipeline_, &VideoPipeline::frameEncoded, this, &MainWindow::onFrameEncoded);
+    connect(&pipeline_, &VideoPipeline::formatChanged, this, &MainWindow::onVideoFormatChanged);
+    // 分层发送：服务器按每个接收端的带宽只转发其中一层（video/simulcastLayers=1 关闭）
+    pipeline_.setSimulcastLayers(settings_.value("video/simulcastLayers", SIMULCAST_MAX_LAYERS).toInt());
+    connect(&remoteVideo_, &RemoteVideoDecoder::frameDecoded, this, &MainWindow::onRemoteFrame);
+    connect(&remoteVideo_, &RemoteVideoDecoder::keyframeNeeded, this, &MainWindow::requestKeyframe);
+    remoteVideo_.setDisplaySize(remoteLabel_->size());
+    connect(&adaptTimer_, &QTimer::timeout, this, &MainWindow::onAdaptTick);
+    adaptTimer_.start(500);
+    applyVideoSettings();
 }
 
 /* ---------- 网络 ---------- */
 void MainWindow::onConnect()
 {
     conn_.connectTo(edHost->text(), edPort->text().toUShort());
-    txtLog->append("Connecting...");
+    log_->append("Connecting...");
 }
 void MainWindow::onJoin()
 {
@@ -139,7 +164,7 @@ void MainWindow::onSendText()
                   {"sender",  edUser->text()},
                   {"content", edInput->text()},
                   {"ts",      QDateTime::currentMSecsSinceEpoch()}};
-    txtLog->append(QString("[%1] %2: %3")
+    log_->append(QString("[%1] %2: %3")
                    .arg(edRoom->text(), edUser->text(), edInput->text()));
     conn_.send(MSG_TEXT, j);
     edInput->clear();
@@ -149,36 +174,39 @@ void MainWindow::onPkt(Packet p)
     switch (p.type)
     {
     case MSG_TEXT:
-        txtLog->append(QString("[%1] %2: %3")
-                       .arg(p.json["roomId"].toString(),
-                            p.json["sender"].toString(),
-                            p.json["content"].toString()));
+        log_->append(QString("[%1] %2: %3")
+                       .arg(p.json()["roomId"].toString(),
+                            p.json()["sender"].toString(),
+                            p.json()["content"].toString()));
         break;
     case MSG_VIDEO_FRAME:
     {
-        QString sender = p.json["sender"].toString();
-        QString roomId = p.json["roomId"].toString();
+        QString sender = p.json()["sender"].toString();
+        QString roomId = p.json()["roomId"].toString();
         
         // 只显示来自其他用户且在当前房间的视频
         if (sender != edUser->text() && roomId == currentRoom_ && isJoinedRoom_) {
-            QPixmap pix; 
-            pix.loadFromData(p.bin);
-            if (!pix.isNull()) {
-                remoteLabel_->setPixmap(pix.scaled(remoteLabel_->size(), Qt::KeepAspectRatio));
-            }
+            remoteVideo_.submit(sender, p); // 解码在工作线程，积压的旧帧不解码直接丢弃
         }
         break;
     }
+    case MSG_CONTROL_CMD:
+        // 房间内有人的增量帧断链：若点名的是本端，下一帧发关键帧
+        if (p.json()["cmd"].toString() == "keyframe_request" &&
+            p.json()["target"].toString() == edUser->text()) {
+            pipeline_.requestKeyframe();
+        }
+        break;
     case MSG_SERVER_EVENT:
     {
-        txtLog->append(QString("[server] %1")
-                       .arg(QString::fromUtf8(QJsonDocument(p.json).toJson())));
+        log_->append(QString("[server] %1")
+                       .arg(QString::fromUtf8(QJsonDocument(p.json()).toJson())));
         
         // 检查是否是房间加入成功的响应
-        if (p.json.contains("code") && p.json["code"].toInt() == 0 && 
-            p.json.contains("message") && p.json["message"].toString() == "joined") {
+        if (p.json().contains("code") && p.json()["code"].toInt() == 0 && 
+            p.json().contains("message") && p.json()["message"].toString() == "joined") {
             isJoinedRoom_ = true;
-            txtLog->append(QString("成功加入房间: %1").arg(currentRoom_));
+            log_->append(QString("成功加入房间: %1").arg(currentRoom_));
             
             // 尝试自动启动摄像头
             tryAutoStartCamera();
@@ -195,7 +223,7 @@ void MainWindow::startCamera()
 
     const QList<QCameraInfo> cameras = QCameraInfo::availableCameras();
     if (cameras.isEmpty()) {
-        txtLog->append("没有可用摄像头");
+        log_->append("没有可用摄像头");
         QMessageBox::information(this, "Camera Not Found", 
             "No camera device found. Please:\n"
             "• Install qtmultimedia and gstreamer packages\n"
@@ -210,9 +238,11 @@ void MainWindow::startCamera()
     if (probe_->setSource(camera_)) {
         connect(probe_, &QVideoProbe::videoFrameProbed,
                 this, &MainWindow::onVideoFrame);
+        pipeline_.setPreviewSize(videoLabel_->size());
+        pipeline_.start();
         camera_->start(); // 启动摄像头
     } else {
-        txtLog->append("无法设置探头或启动摄像头");
+        log_->append("无法设置探头或启动摄像头");
         // 清理已创建的摄像头对象
         camera_->deleteLater();
         camera_ = nullptr;
@@ -222,13 +252,14 @@ void MainWindow::startCamera()
     }
 
     btnCamera_->setText("关闭摄像头");
-    txtLog->append("摄像头已启动");
+    log_->append("摄像头已启动");
 }
 
 void MainWindow::stopCamera()
 {
     if (!camera_) return;
     camera_->stop();
+    pipeline_.stop();
     // 确保在删除 QVideoProbe 之前断开连接
     if (probe_) {
         disconnect(probe_, &QVideoProbe::videoFrameProbed,
@@ -241,7 +272,7 @@ void MainWindow::stopCamera()
 
     videoLabel_->setText("本地视频预览");
     btnCamera_->setText("开启摄像头");
-    txtLog->append("摄像头已关闭");
+    log_->append("摄像头已关闭");
 }
 
 void MainWindow::onToggleCamera()
@@ -251,150 +282,114 @@ void MainWindow::onToggleCamera()
 }
 
 /* ---------- 帧采集 + 发送 ---------- */
+// GUI 线程只负责把帧交给流水线；颜色转换、预览缩放、JPEG 编码都在工作线程
 void MainWindow::onVideoFrame(const QVideoFrame &frame)
 {
     if (!camera_ || !frame.isValid()) {
         return;
     }
+    // 未连接或未加入房间时不编码（只出预览）
+    pipeline_.setEncodingEnabled(conn_.isConnected() && isJoinedRoom_);
+    pipeline_.push(frame);
+}
 
-    QVideoFrame clone(frame);
-
-    if (!clone.map(QAbstractVideoBuffer::ReadOnly)) {
-        txtLog->append("onVideoFrame: 无法映射视频帧数据。");
-        return;
-    }
-
-    QImage img;
-    QVideoFrame::PixelFormat pixelFormat = clone.pixelFormat();
-
-    qDebug() << "Video Frame Pixel Format:" << pixelFormat;
-    txtLog->append(QString("检测到视频帧像素格式: %1").arg(pixelFormat));
-
+void MainWindow::onPreviewReady(const QImage &image)
+{
+    if (!camera_) return; // 摄像头已关闭，丢弃迟到的预览
+    videoLabel_->setPixmap(QPixmap::fromImage(image));
+}
 
-    if (pixelFormat == QVideoFrame::Format_ARGB32 ||
-        pixelFormat == QVideoFrame::Format_ARGB32_Premultiplied) {
-        img = QImage(clone.bits(), clone.width(), clone.height(),
-                     clone.bytesPerLine(), QImage::Format_ARGB32);
-    } else if (pixelFormat == QVideoFrame::Format_RGB32) {
-        img = QImage(clone.bits(), clone.width(), clone.height(),
-                     clone.bytesPerLine(), QImage::Format_RGB32);
-    }
-    // 处理 BGR32: 加载为 RGB32，然后交换通道
-    else if (pixelFormat == QVideoFrame::Format_BGR32) {
-        img = QImage(clone.bits(), clone.width(), clone.height(),
-                     clone.bytesPerLine(), QImage::Format_RGB32).rgbSwapped();
-    }
-    else if (pixelFormat == QVideoFrame::Format_RGB24) {
-        img = QImage(clone.bits(), clone.width(), clone.height(),
-                     clone.bytesPerLine(), QImage::Format_RGB888); // RGB888 对应 24-bit RGB
-    }
-    // 处理 BGR24: 加载为 RGB888，然后交换通道
-    else if (pixelFormat == QVideoFrame::Format_BGR24) {
-        img = QImage(clone.bits(), clone.width(), clone.height(),
-                     clone.bytesPerLine(), QImage::Format_RGB888).rgbSwapped();
-    }
-    // **核心修改：处理 YUYV 格式**
-    else if (pixelFormat == QVideoFrame::Format_YUYV) {
-        const uchar *yuyv_data = clone.bits();
-        int width = clone.width();
-        int height = clone.height();
-        int bytesPerLine = clone.bytesPerLine();
-
-        // 为 RGB 图像分配内存。使用 QImage::Format_RGB32 来简化处理
-        // 或者使用 QImage::Format_RGB888 如果你想节省内存
-        img = QImage(width, height, QImage::Format_RGB32);
-
-        for (int y = 0; y < height; ++y) {
-            const uchar *line_ptr = yuyv_data + y * bytesPerLine;
-            QRgb *rgb_line_ptr = (QRgb *)img.scanLine(y);
-
-            for (int x = 0; x < width; x += 2) {
-                // YUYV 格式: Y0 U0 Y1 V0 ...
-                // 每个宏像素包含 Y0, U, Y1, V
-                int y0 = line_ptr[x * 2];
-                int u  = line_ptr[x * 2 + 1];
-                int y1 = line_ptr[x * 2 + 2];
-                int v  = line_ptr[x * 2 + 3];
-
-                // YUV to RGB 转换公式 (BT.601 标准，常见于摄像头)
-                // 调整亮度偏移
-                y0 = y0 - 16;
-                y1 = y1 - 16;
-                u  = u  - 128;
-                v  = v  - 128;
-
-                // 计算第一个像素 (Y0) 的 RGB
-                int r0 = qBound(0, (298 * y0 + 409 * v + 128) >> 8, 255);
-                int g0 = qBound(0, (298 * y0 - 100 * u - 208 * v + 128) >> 8, 255);
-                int b0 = qBound(0, (298 * y0 + 516 * u + 128) >> 8, 255);
-                rgb_line_ptr[x] = qRgb(r0, g0, b0);
-
-                // 计算第二个像素 (Y1) 的 RGB
-                int r1 = qBound(0, (298 * y1 + 409 * v + 128) >> 8, 255);
-                int g1 = qBound(0, (298 * y1 - 100 * u - 208 * v + 128) >> 8, 255);
-                int b1 = qBound(0, (298 * y1 + 516 * u + 128) >> 8, 255);
-                rgb_line_ptr[x + 1] = qRgb(r1, g1, b1);
-            }
-        }
+void MainWindow::onFrameEncoded(const QByteArray &payload, quint16 flags,
+                                const QJsonObject &meta, qint64 captureMs, quint16 layer)
+{
+    // 添加防护条件：只有在连接且已加入房间时才发送
+    if (!conn_.isConnected() || !isJoinedRoom_) {
+        pipeline_.requestKeyframe(); // 这一帧没发出去，增量链从关键帧重新开始
+        return; // 不发送帧数据
     }
-    // 如果像素格式不被直接支持，你可能需要根据实际情况实现转换逻辑
-    else {
-        txtLog->append(QString("onVideoFrame: 不支持的像素格式 %1，无法直接转换为 QImage。").arg(pixelFormat));
-        clone.unmap();
-        return;
+    // 发送队列积压时丢过视频帧：接收端的画布已缺块，下一帧改发关键帧
+    if (conn_.droppedVideo() != lastDroppedVideo_) {
+        lastDroppedVideo_ = conn_.droppedVideo();
+        pipeline_.requestKeyframe();
     }
 
+    QJsonObject j{{"roomId", edRoom->text()},
+                  {"sender", edUser->text()},
+                  {"ts",     captureMs}};
+    for (auto it = meta.constBegin(); it != meta.constEnd(); ++it) j.insert(it.key(), it.value());
+    conn_.send(MSG_VIDEO_FRAME, j, payload, flags, layer);
+}
 
-    if (img.isNull() || img.sizeInBytes() == 0) { // 检查 img 是否被有效构建
-        txtLog->append("onVideoFrame: 创建QImage失败或图像数据为空。");
-        clone.unmap();
-        return;
-    }
+void MainWindow::onRemoteFrame(const QString &sender, const QImage &image)
+{
+    if (!isJoinedRoom_ || sender == edUser->text()) return; // 已离开房间，丢弃迟到的画面
+    remoteLabel_->setPixmap(QPixmap::fromImage(image));
+}
 
-    clone.unmap(); // 尽早解除映射，释放资源
+void MainWindow::requestKeyframe(const QString &sender)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - keyframeRequestMs_.value(sender, 0) < 1000) return;
+    keyframeRequestMs_[sender] = now;
+    QJsonObject j{{"roomId", currentRoom_},
+                  {"sender", edUser->text()},
+                  {"cmd",    "keyframe_request"},
+                  {"target", sender}};
+    conn_.send(MSG_CONTROL_CMD, j);
+}
 
-    // 本地预览
-    QPixmap pixmap = QPixmap::fromImage(img);
-    if (!pixmap.isNull()) {
-        videoLabel_->setPixmap(pixmap.scaled(videoLabel_->size(), Qt::KeepAspectRatio));
-    } else {
-        txtLog->append("onVideoFrame: 无法从QImage创建QPixmap。");
+// 每 500ms 采样一次发送积压与已发送字节，控制器按阶梯升降档
+void MainWindow::onAdaptTick()
+{
+    if (adapt_.update(conn_.pendingBytes(), conn_.bytesSent(), QDateTime::currentMSecsSinceEpoch())) {
+        applyVideoSettings();
+        log_->append(QString("视频自适应: %1").arg(adapt_.describe(pipeline_.frameSize())));
     }
+    videoStatsLabel_->setText(adapt_.describe(pipeline_.frameSize()));
+}
 
-    // 远端发送
-    QByteArray jpeg;
-    QBuffer buffer(&jpeg);
-    buffer.open(QIODevice::WriteOnly);
-    if (!img.save(&buffer, "JPEG", 60)) {
-        txtLog->append("onVideoFrame: 无法将图像保存为JPEG格式。");
-        return;
-    }
-    buffer.close();
+void MainWindow::applyVideoSettings()
+{
+    const VideoSettings& vs = adapt_.settings();
+    pipeline_.setJpegQuality(vs.jpegQuality);
+    pipeline_.setEncodeScale(vs.scale);
+    pipeline_.setMaxFps(vs.maxFps);
+}
 
-    // 添加防护条件：只有在连接且已加入房间时才发送
-    if (!conn_.isConnected() || !isJoinedRoom_) {
-        return; // 不发送帧数据
+void MainWindow::onVideoFormatChanged(int pixelFormat, bool supported)
+{
+    if (supported) {
+        log_->append(QString("检测到视频帧像素格式: %1").arg(pixelFormat));
+    } else {
+        log_->append(QString("onVideoFrame: 不支持的像素格式 %1，无法直接转换为 QImage。").arg(pixelFormat));
     }
-
-    QJsonObject j{{"roomId", edRoom->text()},
-                  {"sender", edUser->text()},
-                  {"ts",     QDateTime::currentMSecsSinceEpoch()}};
-    conn_.send(MSG_VIDEO_FRAME, j, jpeg);
 }
 
 /* ---------- 连接状态处理 ---------- */
 void MainWindow::onConnected()
 {
     isConnected_ = true;
-    txtLog->append("已连接到服务器");
+    log_->append("已连接到服务器");
+    // 自动重连上来：没有会话可恢复，重新加入断线前的房间
+    if (!currentRoom_.isEmpty()) {
+        conn_.send(MSG_JOIN_WORKORDER, QJsonObject{{"roomId", currentRoom_}, {"user", edUser->text()}});
+    }
 }
 
 void MainWindow::onDisconnected()
 {
     isConnected_ = false;
+    adapt_.reset(); // 新连接从最高档重新探测
+    remoteVideo_.reset();
+    keyframeRequestMs_.clear();
+    applyVideoSettings();
     isJoinedRoom_ = false;
+    if (conn_.willReconnect()) {
+        log_->append("与服务器断开连接，正在重连...");
+        return; // 保留 currentRoom_，连上后重新加入
+    }
     currentRoom_.clear();
-    txtLog->append("与服务器断开连接");
+    log_->append("与服务器断开连接");
 }
 
 /* ---------- 自动启动功能 ---------- */
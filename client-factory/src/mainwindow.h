@@ -5,6 +5,9 @@
 #include <QCamera>      // 包含 QCamera
 #include <QVideoProbe>  // 包含 QVideoProbe
 #include <QSettings>    // 包含 QSettings for auto-start preference
+#include "videopipeline.h"
+#include "adaptivevideo.h"
+#include "videodecoder.h"
 #include "clientconn.h" // 假设你的 clientconn.h 在这里
 
 // 前向声明
@@ -14,6 +17,7 @@ class QLabel;
 class QTextEdit;
 class QVideoFrame; // 确保声明 QVideoFrame
 class QCheckBox;
+class LogSink;
 
 class MainWindow : public QMainWindow
 {
@@ -32,13 +36,21 @@ private slots:
     void onDisconnected(); // 处理连接断开
 
     void onToggleCamera();
-    void onVideoFrame(const QVideoFrame &frame); // 接收视频帧的槽函数
+    void onVideoFrame(const QVideoFrame &frame); // 接收视频帧的槽函数（只移交给流水线）
+    void onPreviewReady(const QImage &image);    // 工作线程缩放好的本地预览
+    void onFrameEncoded(const QByteArray &payload, quint16 flags,
+                        const QJsonObject &meta, qint64 captureMs, quint16 layer); // 编码完成的帧 -> 发送
+    void onVideoFormatChanged(int pixelFormat, bool supported);
+    void onAdaptTick();                          // 按发送积压/上行速率调整视频质量
+    void onRemoteFrame(const QString &sender, const QImage &image); // 解码线程输出（已缩放到显示尺寸）
+    void requestKeyframe(const QString &sender); // 增量帧断链时请求关键帧（每发送者 1 次/秒）
     void onAutoStartToggled(bool checked); // 处理自动启动选项切换
 
 private:
     // 这两个函数是内部实现细节，保持 private
 
     void stopCamera();
+    void applyVideoSettings(); // 把自适应控制器的当前档位下发给流水线
     void tryAutoStartCamera(); // 尝试自动启动摄像头
     void saveAutoStartPreference(bool enabled); // 保存自动启动偏好
     bool loadAutoStartPreference(); // 加载自动启动偏好
@@ -49,12 +61,20 @@ private:
     QLineEdit *edRoom;
     QLineEdit *edInput;
     QTextEdit *txtLog;
+    LogSink *log_;              // txtLog 的批量/限长写入 + 滚动日志文件
     QLabel *videoLabel_;        // 本地视频预览
     QLabel *remoteLabel_;       // 远端视频显示
+    QLabel *videoStatsLabel_;   // 当前视频档位（质量/分辨率/帧率/估计延迟）
     QPushButton *btnCamera_;
     QCheckBox *chkAutoStart_; // 自动启动摄像头复选框
 
     ClientConn conn_; // 你的网络连接类
+    VideoPipeline pipeline_; // 采集 -> 转换 -> 编码 流水线（工作线程）
+    AdaptiveVideoController adapt_; // 目标发送延迟 300ms
+    QTimer adaptTimer_;
+    RemoteVideoDecoder remoteVideo_;              // 远端视频解码线程（每发送者只保留最新帧）
+    QHash<QString, qint64> keyframeRequestMs_;    // 上次请求关键帧的时间
+    quint64 lastDroppedVideo_ = 0;
 
     QCamera *camera_;       // 摄像头对象
     QVideoProbe *probe_;    // 视频探头，用于捕获帧
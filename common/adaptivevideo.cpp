@@ -0,0 +1,116 @@
+#include "adaptivevideo.h"
+
+// Step 0 matches the previous fixed behaviour (quality 60, full size, every frame)
+static const VideoSettings LADDER[] = {
+    {60, 1.0,  30},
+    {50, 1.0,  20},
+    {45, 0.75, 15},
+    {40, 0.5,  15},
+    {35, 0.5,  10},
+    {30, 0.33, 8},
+    {25, 0.25, 5},
+};
+static const int LADDER_SIZE = int(sizeof(LADDER) / sizeof(LADDER[0]));
+
+static const qint64 DOWN_HOLD_MS = 1000;   // at most one step down per second
+static const qint64 UP_CALM_MS = 5000;     // delay must stay low this long before stepping up
+static const double RATE_ALPHA = 0.3;
+static const double RTT_ALPHA = 0.125;     // same smoothing as TCP SRTT
+
+AdaptiveVideoController::AdaptiveVideoController(qint64 targetDelayMs)
+    : targetDelayMs_(qMax<qint64>(50, targetDelayMs))
+{
+}
+
+const VideoSettings& AdaptiveVideoController::settings() const
+{
+    return LADDER[level_];
+}
+
+int AdaptiveVideoController::levelCount() const
+{
+    return LADDER_SIZE;
+}
+
+void AdaptiveVideoController::reset()
+{
+    level_ = 0;
+    lastSampleMs_ = -1;
+    lastPending_ = 0;
+    rateBps_ = 0;
+    rttMs_ = 0;
+    delayMs_ = 0;
+    calmSinceMs_ = -1;
+}
+
+void AdaptiveVideoController::reportRtt(qint64 rttMs)
+{
+    if (rttMs < 0) return;
+    rttMs_ = (rttMs_ <= 0) ? rttMs : (1 - RTT_ALPHA) * rttMs_ + RTT_ALPHA * rttMs;
+}
+
+bool AdaptiveVideoController::update(qint64 pendingBytes, qint64 bytesSent, qint64 nowMs)
+{
+    if (lastSampleMs_ < 0 || bytesSent < lastBytesSent_) {
+        lastSampleMs_ = nowMs;
+        lastBytesSent_ = bytesSent;
+        lastPending_ = pendingBytes;
+        return false;
+    }
+    const qint64 dt = nowMs - lastSampleMs_;
+    if (dt <= 0) return false;
+
+    // Drain rate. Only a backlogged interval measures link capacity; an idle one
+    // only proves the link can do at least that much.
+    const double observed = double(bytesSent - lastBytesSent_) * 1000.0 / dt;
+    const bool backlogged = lastPending_ > 0 && pendingBytes > 0;
+    if (backlogged || rateBps_ <= 0) {
+        rateBps_ = (rateBps_ <= 0) ? observed : (1 - RATE_ALPHA) * rateBps_ + RATE_ALPHA * observed;
+    } else {
+        rateBps_ = qMax(rateBps_, observed);
+    }
+    lastSampleMs_ = nowMs;
+    lastBytesSent_ = bytesSent;
+    lastPending_ = pendingBytes;
+
+    // Queue delay; a stalled link (nothing drained, data waiting) counts as far over target
+    qint64 queueMs = 0;
+    if (pendingBytes > 0) {
+        queueMs = (rateBps_ > 1) ? qint64(pendingBytes * 1000.0 / rateBps_) : 10 * targetDelayMs_;
+    }
+    delayMs_ = queueMs + qint64(rttMs_ / 2);
+
+    const int before = level_;
+    if (delayMs_ > targetDelayMs_) {
+        calmSinceMs_ = -1;
+        if (nowMs - lastChangeMs_ >= DOWN_HOLD_MS && level_ < LADDER_SIZE - 1) {
+            const int steps = (delayMs_ > 3 * targetDelayMs_) ? 2 : 1;
+            level_ = qMin(LADDER_SIZE - 1, level_ + steps);
+        }
+    } else if (delayMs_ < targetDelayMs_ / 2) {
+        if (calmSinceMs_ < 0) calmSinceMs_ = nowMs;
+        if (nowMs - calmSinceMs_ >= UP_CALM_MS && level_ > 0) {
+            level_--;
+            calmSinceMs_ = nowMs; // probe one step at a time
+        }
+    } else {
+        calmSinceMs_ = -1;
+    }
+
+    if (level_ != before) {
+        lastChangeMs_ = nowMs;
+        return true;
+    }
+    return false;
+}
+
+QString AdaptiveVideoController::describe(const QSize& cameraSize) const
+{
+    const VideoSettings& s = settings();
+    const QString size = cameraSize.isValid()
+        ? QString("%1x%2").arg(qRound(cameraSize.width() * s.scale)).arg(qRound(cameraSize.height() * s.scale))
+        : QString("%1%").arg(qRound(s.scale * 100));
+    return QString("Q%1 %2 %3fps | delay ~%4ms, uplink %5 KB/s, rtt %6ms")
+        .arg(s.jpegQuality).arg(size).arg(s.maxFps)
+        .arg(delayMs_).arg(qint64(rateBps_ / 1024)).arg(qint64(rttMs_));
+}
@@ -0,0 +1,49 @@
+#pragma once
+// ===============================================
+// common/adaptivevideo.h
+// Adaptive video quality for the capture pipeline
+// - input: bytes still queued for the socket, bytes already written, RTT
+// - estimated sender delay = queued bytes / measured uplink rate + RTT / 2
+// - walks a ladder of (JPEG quality, scale, fps) steps to keep that delay
+//   under the target: fast step-down on congestion, slow step-up when idle
+// ===============================================
+
+#include <QtCore>
+
+struct VideoSettings {
+    int jpegQuality = 60;
+    double scale = 1.0;   // encode resolution relative to the camera frame
+    int maxFps = 30;
+};
+
+class AdaptiveVideoController {
+public:
+    explicit AdaptiveVideoController(qint64 targetDelayMs = 300);
+
+    // Called periodically (e.g. every 500 ms) from the connection's thread.
+    // Returns true when settings() changed.
+    bool update(qint64 pendingBytes, qint64 bytesSent, qint64 nowMs);
+
+    void reportRtt(qint64 rttMs);   // round-trip feedback, smoothed internally
+    void reset();                   // new connection: back to the top step
+
+    const VideoSettings& settings() const;
+    int level() const { return level_; }
+    int levelCount() const;
+    qint64 estimatedDelayMs() const { return delayMs_; }
+    qint64 uplinkBytesPerSec() const { return qint64(rateBps_); }
+    qint64 rttMs() const { return qint64(rttMs_); }
+    QString describe(const QSize& cameraSize = QSize()) const; // one-line status for the UI
+
+private:
+    qint64 targetDelayMs_;
+    int level_ = 0;
+    qint64 lastSampleMs_ = -1;
+    qint64 lastBytesSent_ = 0;
+    qint64 lastPending_ = 0;
+    double rateBps_ = 0;      // EWMA of the uplink drain rate
+    double rttMs_ = 0;        // EWMA of reported RTT
+    qint64 delayMs_ = 0;
+    qint64 lastChangeMs_ = 0;
+    qint64 calmSinceMs_ = -1; // start of the current below-target stretch
+};
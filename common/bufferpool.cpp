@@ -0,0 +1,127 @@
+#include "bufferpool.h"
+#include <QMutexLocker>
+
+BufferPool::BufferPool(int slabSize, int maxFree)
+    : slabSize_(slabSize), maxFree_(maxFree)
+{
+}
+
+BufferPool& BufferPool::shared()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+QByteArray BufferPool::acquire()
+{
+    {
+        QMutexLocker locker(&mutex_);
+        if (!free_.isEmpty()) {
+            return free_.takeLast();
+        }
+    }
+
+    QByteArray block;
+    block.reserve(slabSize_);        // capacityReserved: resize() never shrinks the allocation
+    block.resize(block.capacity());
+    return block;
+}
+
+void BufferPool::release(QByteArray& block)
+{
+    if (block.capacity() < slabSize_ || block.capacity() > RECV_SLAB_MAX_POOLED) {
+        block = QByteArray(); // not a slab (or grown for a huge frame): let it go
+        return;
+    }
+
+    QMutexLocker locker(&mutex_);
+    if (free_.size() < maxFree_) {
+        free_.append(std::move(block));
+    }
+    block = QByteArray();
+}
+
+int BufferPool::freeCount() const
+{
+    QMutexLocker locker(&mutex_);
+    return free_.size();
+}
+
+RecvBuffer::RecvBuffer(BufferPool* pool)
+    : pool_(pool)
+{
+}
+
+RecvBuffer::~RecvBuffer()
+{
+    release();
+}
+
+void RecvBuffer::release()
+{
+    if (!block_.isNull()) {
+        pool_->release(block_);
+    }
+    head_ = tail_ = 0;
+}
+
+void RecvBuffer::reserveTail(int bytes)
+{
+    if (block_.isNull()) {
+        block_ = pool_->acquire();
+    }
+    if (tail_ + bytes <= block_.size()) {
+        return;
+    }
+
+    // Move the unread tail to the front first; grow only if that is not enough
+    if (head_ > 0) {
+        const int pending = tail_ - head_;
+        memmove(block_.data(), block_.constData() + head_, pending);
+        head_ = 0;
+        tail_ = pending;
+    }
+    if (tail_ + bytes > block_.size()) {
+        block_.reserve(tail_ + bytes);
+        block_.resize(block_.capacity());
+    }
+}
+
+qint64 RecvBuffer::readFrom(QIODevice* device)
+{
+    qint64 total = 0;
+    qint64 available;
+    while ((available = device->bytesAvailable()) > 0) {
+        reserveTail(static_cast<int>(available));
+        qint64 n = device->read(block_.data() + tail_, block_.size() - tail_);
+        if (n <= 0) break;
+        tail_ += static_cast<int>(n);
+        total += n;
+    }
+    return total;
+}
+
+bool RecvBuffer::decode(QVector<Packet>& out, QString* error)
+{
+    if (tail_ == head_) {
+        return true;
+    }
+
+    const int consumed = decodeFrames(block_.constData() + head_, tail_ - head_, out, error);
+    if (consumed < 0) {
+        head_ = tail_ = 0; // Discard buffer on validation error
+        return false;
+    }
+
+    head_ += consumed;
+    if (head_ == tail_) {
+        head_ = tail_ = 0; // common case: batch ended on a frame boundary, nothing to move
+    } else if (head_ > block_.size() / 2) {
+        // Compact once per batch so the free space stays contiguous
+        const int pending = tail_ - head_;
+        memmove(block_.data(), block_.constData() + head_, pending);
+        head_ = 0;
+        tail_ = pending;
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+// ===============================================
+// common/bufferpool.h
+// Slab pool of fixed-capacity byte blocks plus a per-connection receive buffer
+// - BufferPool hands out QByteArray blocks with reserved capacity and takes them
+//   back on release, so connect/disconnect churn does not touch the allocator
+// - RecvBuffer reads socket data straight into its block and decodes complete
+//   frames in place; the unread tail is compacted once per read batch
+// ===============================================
+
+#include <QtCore>
+#include "protocol.h"
+
+static const int RECV_SLAB_SIZE = 64 * 1024;       // default block capacity
+static const int RECV_SLAB_MAX_POOLED = 1024 * 1024; // larger (grown) blocks are freed, not pooled
+
+class BufferPool {
+public:
+    explicit BufferPool(int slabSize = RECV_SLAB_SIZE, int maxFree = 1024);
+
+    QByteArray acquire();             // block with capacity >= slabSize, size() == capacity
+    void release(QByteArray& block);  // return a block (block is left empty)
+
+    int slabSize() const { return slabSize_; }
+    int freeCount() const;
+
+    static BufferPool& shared();      // process-wide pool for receive buffers
+
+private:
+    mutable QMutex mutex_;
+    QVector<QByteArray> free_;
+    int slabSize_;
+    int maxFree_;
+};
+
+class RecvBuffer {
+public:
+    explicit RecvBuffer(BufferPool* pool = &BufferPool::shared());
+    ~RecvBuffer();
+
+    // Append everything currently available on the device; returns bytes read
+    qint64 readFrom(QIODevice* device);
+
+    // Decode all complete frames in place, then compact the remaining tail once.
+    // Returns false (and discards the buffer) on an invalid frame header.
+    bool decode(QVector<Packet>& out, QString* error = nullptr);
+
+    int size() const { return tail_ - head_; }
+    void release(); // give the block back to the pool now
+
+private:
+    Q_DISABLE_COPY(RecvBuffer)
+
+    BufferPool* pool_;
+    QByteArray block_;
+    int head_ = 0; // first unread byte
+    int tail_ = 0; // one past the last written byte
+
+    void reserveTail(int bytes);
+};
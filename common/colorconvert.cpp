@@ -0,0 +1,353 @@
+#include "colorconvert.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define REXP_COLOR_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define REXP_TARGET_SSE2
+#define REXP_TARGET_AVX2
+#else
+#define REXP_TARGET_SSE2 __attribute__((target("sse2")))
+#define REXP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define REXP_COLOR_X86 0
+#endif
+
+/* ---------- scalar reference (the original capture loop) ---------- */
+
+// y, u, v are raw samples; same integer math and rounding as the per-pixel loop
+static inline quint32 yuvPixel(int y, int u, int v)
+{
+    y -= 16;
+    u -= 128;
+    v -= 128;
+    const int r = qBound(0, (298 * y + 409 * v + 128) >> 8, 255);
+    const int g = qBound(0, (298 * y - 100 * u - 208 * v + 128) >> 8, 255);
+    const int b = qBound(0, (298 * y + 516 * u + 128) >> 8, 255);
+    return 0xff000000u | (quint32(r) << 16) | (quint32(g) << 8) | quint32(b);
+}
+
+// Converts pixels [x0, width) of one row; x0 is always even.
+// The SIMD rows below share this signature and return where they stopped.
+static void scalarRow(YuvFormat format, const uchar* p0, const uchar* p1, const uchar* p2,
+                      quint32* dst, int x0, int width)
+{
+    for (int x = x0; x < width; x += 2) {
+        int y0, y1, u, v;
+        switch (format) {
+        case YuvFormat::YUYV: {
+            const uchar* s = p0 + x * 2;
+            y0 = s[0]; u = s[1]; y1 = s[2]; v = s[3];
+            break;
+        }
+        case YuvFormat::UYVY: {
+            const uchar* s = p0 + x * 2;
+            u = s[0]; y0 = s[1]; v = s[2]; y1 = s[3];
+            break;
+        }
+        case YuvFormat::NV12:
+            y0 = p0[x];
+            y1 = (x + 1 < width) ? p0[x + 1] : 0;
+            u = p1[x]; v = p1[x + 1];
+            break;
+        case YuvFormat::I420:
+        default:
+            y0 = p0[x];
+            y1 = (x + 1 < width) ? p0[x + 1] : 0;
+            u = p1[x / 2]; v = p2[x / 2];
+            break;
+        }
+        dst[x] = yuvPixel(y0, u, v);
+        if (x + 1 < width) dst[x + 1] = yuvPixel(y1, u, v);
+    }
+}
+
+#if REXP_COLOR_X86
+
+/* ---------- SSE2: 8 pixels per step ---------- */
+// Coefficient pairs go through _mm_madd_epi16 (int16 x int16 -> int32 sums), so
+// the intermediate precision matches the scalar int math exactly; the
+// packs/packus saturation then gives the same clamp as qBound(0, c, 255).
+
+REXP_TARGET_SSE2 static inline __m128i pair16(int lo, int hi)
+{
+    return _mm_set1_epi32(int((quint32(quint16(hi)) << 16) | quint16(lo)));
+}
+
+// y, u, v: 8 lanes of raw samples widened to int16 (chroma already duplicated per pair)
+REXP_TARGET_SSE2 static inline void storeRgb8(__m128i y, __m128i u, __m128i v, quint32* dst)
+{
+    y = _mm_sub_epi16(y, _mm_set1_epi16(16));
+    u = _mm_sub_epi16(u, _mm_set1_epi16(128));
+    v = _mm_sub_epi16(v, _mm_set1_epi16(128));
+    const __m128i round = _mm_set1_epi32(128);
+
+    const __m128i yvLo = _mm_unpacklo_epi16(y, v), yvHi = _mm_unpackhi_epi16(y, v);
+    const __m128i yuLo = _mm_unpacklo_epi16(y, u), yuHi = _mm_unpackhi_epi16(y, u);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i v1Lo = _mm_unpacklo_epi16(v, one), v1Hi = _mm_unpackhi_epi16(v, one);
+
+    const __m128i kR = pair16(298, 409), kGy = pair16(298, -100), kGv = pair16(-208, 128), kB = pair16(298, 516);
+    __m128i rLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yvLo, kR), round), 8);
+    __m128i rHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yvHi, kR), round), 8);
+    __m128i gLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuLo, kGy), _mm_madd_epi16(v1Lo, kGv)), 8);
+    __m128i gHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuHi, kGy), _mm_madd_epi16(v1Hi, kGv)), 8);
+    __m128i bLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuLo, kB), round), 8);
+    __m128i bHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuHi, kB), round), 8);
+
+    const __m128i r16 = _mm_packs_epi32(rLo, rHi);
+    const __m128i g16 = _mm_packs_epi32(gLo, gHi);
+    const __m128i b16 = _mm_packs_epi32(bLo, bHi);
+    const __m128i r8 = _mm_packus_epi16(r16, r16);
+    const __m128i g8 = _mm_packus_epi16(g16, g16);
+    const __m128i b8 = _mm_packus_epi16(b16, b16);
+
+    // Memory order of 0xffRRGGBB on little endian: B G R A
+    const __m128i bg = _mm_unpacklo_epi8(b8, g8);
+    const __m128i ra = _mm_unpacklo_epi8(r8, _mm_set1_epi8(char(0xff)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4), _mm_unpackhi_epi16(bg, ra));
+}
+
+// c: interleaved chroma as int16 lanes U0 V0 U1 V1 U2 V2 U3 V3 -> per-pixel U and V
+REXP_TARGET_SSE2 static inline void splitChroma(__m128i c, __m128i* u, __m128i* v)
+{
+    *u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    *v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+REXP_TARGET_SSE2 static int sse2Row(YuvFormat format, const uchar* p0, const uchar* p1, const uchar* p2,
+                                    quint32* dst, int x0, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    int x = x0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i y, c, u, v;
+        switch (format) {
+        case YuvFormat::YUYV: {
+            const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + x * 2));
+            y = _mm_and_si128(s, lowBytes);
+            splitChroma(_mm_srli_epi16(s, 8), &u, &v);
+            break;
+        }
+        case YuvFormat::UYVY: {
+            const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + x * 2));
+            y = _mm_srli_epi16(s, 8);
+            splitChroma(_mm_and_si128(s, lowBytes), &u, &v);
+            break;
+        }
+        case YuvFormat::NV12:
+            y = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p0 + x)), zero);
+            c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p1 + x)), zero);
+            splitChroma(c, &u, &v);
+            break;
+        case YuvFormat::I420:
+        default: {
+            int u4, v4;
+            memcpy(&u4, p1 + x / 2, 4);
+            memcpy(&v4, p2 + x / 2, 4);
+            y = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p0 + x)), zero);
+            const __m128i uu = _mm_cvtsi32_si128(u4), vv = _mm_cvtsi32_si128(v4);
+            u = _mm_unpacklo_epi8(_mm_unpacklo_epi8(uu, uu), zero);
+            v = _mm_unpacklo_epi8(_mm_unpacklo_epi8(vv, vv), zero);
+            break;
+        }
+        }
+        storeRgb8(y, u, v, dst + x);
+    }
+    return x;
+}
+
+/* ---------- AVX2: 16 pixels per step ---------- */
+// Same math as SSE2. Pack/unpack work per 128-bit lane, so lane 0 carries
+// pixels 0-7 and lane 1 pixels 8-15 until the final cross-lane store.
+
+REXP_TARGET_AVX2 static inline __m256i pair16x2(int lo, int hi)
+{
+    return _mm256_set1_epi32(int((quint32(quint16(hi)) << 16) | quint16(lo)));
+}
+
+REXP_TARGET_AVX2 static inline void storeRgb16(__m256i y, __m256i u, __m256i v, quint32* dst)
+{
+    y = _mm256_sub_epi16(y, _mm256_set1_epi16(16));
+    u = _mm256_sub_epi16(u, _mm256_set1_epi16(128));
+    v = _mm256_sub_epi16(v, _mm256_set1_epi16(128));
+    const __m256i round = _mm256_set1_epi32(128);
+
+    const __m256i yvLo = _mm256_unpacklo_epi16(y, v), yvHi = _mm256_unpackhi_epi16(y, v);
+    const __m256i yuLo = _mm256_unpacklo_epi16(y, u), yuHi = _mm256_unpackhi_epi16(y, u);
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i v1Lo = _mm256_unpacklo_epi16(v, one), v1Hi = _mm256_unpackhi_epi16(v, one);
+
+    const __m256i kR = pair16x2(298, 409), kGy = pair16x2(298, -100), kGv = pair16x2(-208, 128), kB = pair16x2(298, 516);
+    __m256i rLo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yvLo, kR), round), 8);
+    __m256i rHi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yvHi, kR), round), 8);
+    __m256i gLo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yuLo, kGy), _mm256_madd_epi16(v1Lo, kGv)), 8);
+    __m256i gHi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yuHi, kGy), _mm256_madd_epi16(v1Hi, kGv)), 8);
+    __m256i bLo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yuLo, kB), round), 8);
+    __m256i bHi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yuHi, kB), round), 8);
+
+    const __m256i r16 = _mm256_packs_epi32(rLo, rHi);
+    const __m256i g16 = _mm256_packs_epi32(gLo, gHi);
+    const __m256i b16 = _mm256_packs_epi32(bLo, bHi);
+    const __m256i r8 = _mm256_packus_epi16(r16, r16);
+    const __m256i g8 = _mm256_packus_epi16(g16, g16);
+    const __m256i b8 = _mm256_packus_epi16(b16, b16);
+
+    const __m256i bg = _mm256_unpacklo_epi8(b8, g8);
+    const __m256i ra = _mm256_unpacklo_epi8(r8, _mm256_set1_epi8(char(0xff)));
+    const __m256i lo = _mm256_unpacklo_epi16(bg, ra);   // pixels 0-3 | 8-11
+    const __m256i hi = _mm256_unpackhi_epi16(bg, ra);   // pixels 4-7 | 12-15
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+REXP_TARGET_AVX2 static inline void splitChroma16(__m256i c, __m256i* u, __m256i* v)
+{
+    *u = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    *v = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+REXP_TARGET_AVX2 static int avx2Row(YuvFormat format, const uchar* p0, const uchar* p1, const uchar* p2,
+                                    quint32* dst, int x0, int width)
+{
+    const __m256i lowBytes = _mm256_set1_epi16(0x00ff);
+    int x = x0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i y, u, v;
+        switch (format) {
+        case YuvFormat::YUYV: {
+            const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p0 + x * 2));
+            y = _mm256_and_si256(s, lowBytes);
+            splitChroma16(_mm256_srli_epi16(s, 8), &u, &v);
+            break;
+        }
+        case YuvFormat::UYVY: {
+            const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p0 + x * 2));
+            y = _mm256_srli_epi16(s, 8);
+            splitChroma16(_mm256_and_si256(s, lowBytes), &u, &v);
+            break;
+        }
+        case YuvFormat::NV12:
+            y = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + x)));
+            splitChroma16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + x))), &u, &v);
+            break;
+        case YuvFormat::I420:
+        default: {
+            y = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + x)));
+            const __m128i uu = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p1 + x / 2));
+            const __m128i vv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p2 + x / 2));
+            u = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(uu, uu));
+            v = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(vv, vv));
+            break;
+        }
+        }
+        storeRgb16(y, u, v, dst + x);
+    }
+    return x;
+}
+
+/* ---------- CPU dispatch ---------- */
+
+static ColorKernel bestColorKernel()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) return ColorKernel::AVX2;
+    }
+    return sse2 ? ColorKernel::SSE2 : ColorKernel::Scalar;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return ColorKernel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return ColorKernel::SSE2;
+    return ColorKernel::Scalar;
+#endif
+}
+
+#else // !REXP_COLOR_X86
+
+static ColorKernel bestColorKernel()
+{
+    return ColorKernel::Scalar;
+}
+
+#endif
+
+/* ---------- public API ---------- */
+
+static std::atomic<int> g_colorKernel(-1);
+
+static ColorKernel supportedColorKernel()
+{
+    static const ColorKernel best = bestColorKernel();
+    return best;
+}
+
+ColorKernel activeColorKernel()
+{
+    int k = g_colorKernel.load(std::memory_order_relaxed);
+    if (k < 0) {
+        k = int(supportedColorKernel());
+        g_colorKernel.store(k, std::memory_order_relaxed);
+    }
+    return ColorKernel(k);
+}
+
+ColorKernel setColorKernel(ColorKernel kernel)
+{
+    const ColorKernel k = (int(kernel) > int(supportedColorKernel())) ? supportedColorKernel() : kernel;
+    g_colorKernel.store(int(k), std::memory_order_relaxed);
+    return k;
+}
+
+const char* colorKernelName(ColorKernel kernel)
+{
+    switch (kernel) {
+    case ColorKernel::AVX2: return "avx2";
+    case ColorKernel::SSE2: return "sse2";
+    case ColorKernel::Scalar:
+    default:                return "scalar";
+    }
+}
+
+bool convertYuvToRgb32(YuvFormat format, const YuvPlanes& src, int width, int height,
+                       uchar* dst, int dstStride)
+{
+    const bool planar = (format == YuvFormat::NV12 || format == YuvFormat::I420);
+    if (width <= 0 || height <= 0 || !dst || !src.data[0]) return false;
+    if (planar && !src.data[1]) return false;
+    if (format == YuvFormat::I420 && !src.data[2]) return false;
+
+    const ColorKernel kernel = activeColorKernel();
+    for (int row = 0; row < height; ++row) {
+        const uchar* p0 = src.data[0] + qptrdiff(row) * src.stride[0];
+        const uchar* p1 = planar ? src.data[1] + qptrdiff(row / 2) * src.stride[1] : nullptr;
+        const uchar* p2 = (format == YuvFormat::I420) ? src.data[2] + qptrdiff(row / 2) * src.stride[2] : nullptr;
+        quint32* out = reinterpret_cast<quint32*>(dst + qptrdiff(row) * dstStride);
+
+        int done = 0;
+#if REXP_COLOR_X86
+        if (kernel == ColorKernel::AVX2) {
+            done = avx2Row(format, p0, p1, p2, out, done, width);
+        }
+        if (kernel != ColorKernel::Scalar) {
+            done = sse2Row(format, p0, p1, p2, out, done, width);
+        }
+#endif
+        scalarRow(format, p0, p1, p2, out, done, width);
+    }
+    return true;
+}
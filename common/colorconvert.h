@@ -0,0 +1,42 @@
+#pragma once
+// ===============================================
+// common/colorconvert.h
+// YUV -> RGB32 (0xffRRGGBB, QImage::Format_RGB32) conversion for camera capture
+// - formats: YUYV, UYVY (packed 4:2:2), NV12, I420 (planar 4:2:0)
+// - BT.601 limited range, integer math bit-exact with the original per-pixel
+//   loop: c = qBound(0, (298*(Y-16) + k*(U|V-128) + 128) >> 8, 255)
+// - SSE2 / AVX2 row kernels with a scalar fallback, picked once at runtime
+//   from the CPU feature bits
+// ===============================================
+
+#include <QtGlobal>
+
+enum class YuvFormat {
+    YUYV,   // Y0 U0 Y1 V0, one plane
+    UYVY,   // U0 Y0 V0 Y1, one plane
+    NV12,   // Y plane + interleaved UV plane (half height)
+    I420    // Y plane + U plane + V plane (half width, half height)
+};
+
+enum class ColorKernel {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+struct YuvPlanes {
+    const uchar* data[3] = {nullptr, nullptr, nullptr};
+    int stride[3] = {0, 0, 0};   // bytes per line of each plane
+};
+
+// Converts a width x height frame into dst (dstStride in bytes, e.g. QImage::bytesPerLine()).
+// Returns false for missing planes or non-positive sizes; dst is left untouched then.
+bool convertYuvToRgb32(YuvFormat format, const YuvPlanes& src, int width, int height,
+                       uchar* dst, int dstStride);
+
+ColorKernel activeColorKernel();
+const char* colorKernelName(ColorKernel kernel);
+
+// Forces a kernel (benchmarks / comparisons). Requests for kernels the CPU
+// lacks fall back to the best supported one; returns the kernel now in use.
+ColorKernel setColorKernel(ColorKernel kernel);
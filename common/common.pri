@@ -1,3 +1,29 @@
 INCLUDEPATH += $$PWD
-SOURCES += $$PWD/protocol.cpp
-HEADERS += $$PWD/protocol.h
+SOURCES += $$PWD/protocol.cpp \
+           $$PWD/sendqueue.cpp \
+           $$PWD/bufferpool.cpp \
+           $$PWD/compression.cpp \
+           $$PWD/devicedata.cpp \
+           $$PWD/heartbeat.cpp \
+           $$PWD/reliable.cpp
+HEADERS += $$PWD/protocol.h \
+           $$PWD/sendqueue.h \
+           $$PWD/bufferpool.h \
+           $$PWD/compression.h \
+           $$PWD/devicedata.h \
+           $$PWD/heartbeat.h \
+           $$PWD/reliable.h
+
+# LZ4 codec for FLAG_COMPRESSED when liblz4 is installed; zlib (qCompress) otherwise
+packagesExist(liblz4) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += liblz4
+    DEFINES += REXP_HAVE_LZ4
+}
+
+# zlib headers let the zlib codec inflate into pooled slabs; qUncompress otherwise
+packagesExist(zlib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+    DEFINES += REXP_HAVE_ZLIB
+}
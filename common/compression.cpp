@@ -0,0 +1,234 @@
+#include "compression.h"
+#include "bufferpool.h"
+#include <QtEndian>
+#ifdef REXP_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef REXP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Level 1: on telemetry and chat JSON it stays within ~4 points of the default
+// level's ratio at about twice the speed (see bench/ compressFrame rows)
+static const int ZLIB_LEVEL = 1;
+
+static const int HEADER_SIZE = sizeof(FrameHeader);
+
+// Most compressible frames are a few KiB; larger ones fall back to a plain allocation
+static BufferPool& inflatePool()
+{
+    static BufferPool pool(64 * 1024, 64);
+    return pool;
+}
+
+QString compressionCodecName(CompressionCodec codec)
+{
+    switch (codec) {
+    case CODEC_ZLIB: return QStringLiteral("zlib");
+    case CODEC_LZ4:  return QStringLiteral("lz4");
+    default:         return QStringLiteral("none");
+    }
+}
+
+CompressionCodec compressionCodecFromName(const QString& name)
+{
+    if (name == QLatin1String("zlib")) return CODEC_ZLIB;
+    if (name == QLatin1String("lz4")) return CODEC_LZ4;
+    return CODEC_NONE;
+}
+
+bool compressionCodecAvailable(CompressionCodec codec)
+{
+    switch (codec) {
+    case CODEC_ZLIB: return true;
+#ifdef REXP_HAVE_LZ4
+    case CODEC_LZ4:  return true;
+#endif
+    default:         return false;
+    }
+}
+
+QJsonArray compressionOffer()
+{
+    QJsonArray offer;
+    if (compressionCodecAvailable(CODEC_LZ4)) offer.append(compressionCodecName(CODEC_LZ4));
+    offer.append(compressionCodecName(CODEC_ZLIB));
+    return offer;
+}
+
+CompressionCodec negotiateCompression(const QJsonArray& offer, quint32* acceptedMask)
+{
+    CompressionCodec chosen = CODEC_NONE;
+    quint32 mask = 0;
+    for (const QJsonValue& v : offer) {
+        const CompressionCodec codec = compressionCodecFromName(v.toString());
+        if (!compressionCodecAvailable(codec)) continue;
+        mask |= codecBit(codec);
+        if (chosen == CODEC_NONE) chosen = codec;
+    }
+    if (acceptedMask) *acceptedMask = mask;
+    return chosen;
+}
+
+bool isCompressibleType(quint16 type)
+{
+    switch (type) {
+    case MSG_TEXT:
+    case MSG_DEVICE_DATA:
+    case MSG_DEVICE_STATUS:
+    case MSG_CONTROL_CMD:
+    case MSG_SERVER_EVENT:
+    case MSG_ROOM_STATE:
+        return true;
+    default:
+        return false; // video/audio payloads are already entropy coded
+    }
+}
+
+QByteArray compressFrame(const QByteArray& frame, CompressionCodec codec, int minBytes)
+{
+    if (codec == CODEC_NONE || frame.size() - HEADER_SIZE < qMax(1, minBytes)) return frame;
+    FrameHeader header;
+    memcpy(&header, frame.constData(), HEADER_SIZE);
+    const quint16 type = qFromBigEndian(header.msgType);
+    const quint16 flags = qFromBigEndian(header.flags);
+    if ((flags & FLAG_COMPRESSED) || !isCompressibleType(type)) return frame;
+
+    const char* body = frame.constData() + HEADER_SIZE;
+    const int bodySize = frame.size() - HEADER_SIZE;
+    const int dataOffset = HEADER_SIZE + COMPRESSED_PREFIX_SIZE;
+    QByteArray out;
+    switch (codec) {
+    case CODEC_ZLIB: {
+        const QByteArray z = qCompress(reinterpret_cast<const uchar*>(body), bodySize, ZLIB_LEVEL);
+        if (z.isEmpty()) return frame;
+        out.resize(dataOffset + z.size());
+        memcpy(out.data() + dataOffset, z.constData(), z.size());
+        break;
+    }
+#ifdef REXP_HAVE_LZ4
+    case CODEC_LZ4: {
+        const int bound = LZ4_compressBound(bodySize);
+        out.resize(dataOffset + bound);
+        const int n = LZ4_compress_default(body, out.data() + dataOffset, bodySize, bound);
+        if (n <= 0) return frame;
+        out.resize(dataOffset + n);
+        break;
+    }
+#endif
+    default:
+        return frame;
+    }
+    if (out.size() > frame.size() - frame.size() / 16) return frame;
+
+    memcpy(out.data(), frame.constData(), HEADER_SIZE);
+    out[HEADER_SIZE] = char(codec);
+    qToBigEndian<quint32>(quint32(bodySize), out.data() + HEADER_SIZE + 1);
+    FrameHeader* h = reinterpret_cast<FrameHeader*>(out.data());
+    h->flags = qToBigEndian(quint16(flags | FLAG_COMPRESSED));
+    h->length = qToBigEndian(quint32(out.size()));
+    return out;
+}
+
+CompressionCodec frameCodec(const QByteArray& frame)
+{
+    if (frame.size() < HEADER_SIZE + COMPRESSED_PREFIX_SIZE) return CODEC_NONE;
+    const FrameHeader* h = reinterpret_cast<const FrameHeader*>(frame.constData());
+    if (!(qFromBigEndian(h->flags) & FLAG_COMPRESSED)) return CODEC_NONE;
+    return CompressionCodec(quint8(frame.at(HEADER_SIZE)));
+}
+
+bool inflateFrameBody(const QByteArray& frame, QByteArray* body)
+{
+    if (frame.size() < HEADER_SIZE + COMPRESSED_PREFIX_SIZE) return false;
+    const char* prefix = frame.constData() + HEADER_SIZE;
+    const CompressionCodec codec = CompressionCodec(quint8(prefix[0]));
+    const quint32 plainSize = qFromBigEndian<quint32>(prefix + 1);
+    if (plainSize == 0 || plainSize > MAX_FRAME_SIZE) return false;
+    const char* src = prefix + COMPRESSED_PREFIX_SIZE;
+    const int srcSize = frame.size() - HEADER_SIZE - COMPRESSED_PREFIX_SIZE;
+
+    switch (codec) {
+    case CODEC_ZLIB: {
+        // qCompress format: its own 4-byte BE size, then a zlib stream. Never
+        // let that size drive an allocation; it must match the frame's plainSize
+        if (srcSize <= 4 || qFromBigEndian<quint32>(src) != plainSize) return false;
+#ifdef REXP_HAVE_ZLIB
+        // Inflate straight into a pooled slab, bounded by plainSize
+        BufferPool& pool = inflatePool();
+        QByteArray block = int(plainSize) <= pool.slabSize() ? pool.acquire()
+                                                             : QByteArray(int(plainSize), Qt::Uninitialized);
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit(&zs) != Z_OK) {
+            releaseInflated(block);
+            return false;
+        }
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(src + 4));
+        zs.avail_in = uInt(srcSize - 4);
+        zs.next_out = reinterpret_cast<Bytef*>(block.data());
+        zs.avail_out = uInt(plainSize);
+        const int rc = inflate(&zs, Z_FINISH);
+        const uLong n = zs.total_out;
+        inflateEnd(&zs);
+        if (rc != Z_STREAM_END || n != plainSize) {
+            releaseInflated(block);
+            return false;
+        }
+        block.resize(int(n)); // keeps the slab's capacity; releaseInflated() restores the size
+        body->swap(block);
+        return true;
+#else
+        // Without zlib headers qUncompress allocates its own result, but only
+        // the plainSize already checked against MAX_FRAME_SIZE
+        QByteArray plain = qUncompress(reinterpret_cast<const uchar*>(src), srcSize);
+        if (plain.size() != int(plainSize)) return false;
+        body->swap(plain);
+        return true;
+#endif
+    }
+#ifdef REXP_HAVE_LZ4
+    case CODEC_LZ4: {
+        BufferPool& pool = inflatePool();
+        QByteArray block = int(plainSize) <= pool.slabSize() ? pool.acquire()
+                                                             : QByteArray(int(plainSize), Qt::Uninitialized);
+        const int n = LZ4_decompress_safe(src, block.data(), srcSize, int(plainSize));
+        if (n != int(plainSize)) {
+            releaseInflated(block);
+            return false;
+        }
+        block.resize(n); // keeps the slab's capacity; releaseInflated() restores the size
+        body->swap(block);
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+void releaseInflated(QByteArray& body)
+{
+    // Still referenced by another Packet copy: the last one returns it
+    if (body.isNull() || !body.isDetached()) {
+        body = QByteArray();
+        return;
+    }
+    body.resize(body.capacity());
+    inflatePool().release(body); // blocks that are not slabs are simply freed
+}
+
+QByteArray decompressFrame(const QByteArray& frame)
+{
+    QByteArray body;
+    if (!inflateFrameBody(frame, &body)) return QByteArray();
+    QByteArray out;
+    out.reserve(HEADER_SIZE + body.size());
+    out.append(frame.constData(), HEADER_SIZE);
+    out.append(body);
+    releaseInflated(body);
+    FrameHeader* h = reinterpret_cast<FrameHeader*>(out.data());
+    h->flags = qToBigEndian(quint16(qFromBigEndian(h->flags) & ~FLAG_COMPRESSED));
+    h->length = qToBigEndian(quint32(out.size()));
+    return out;
+}
@@ -0,0 +1,62 @@
+#pragma once
+// ===============================================
+// common/compression.h
+// Per-frame payload compression (FLAG_COMPRESSED)
+// - wire layout: [FrameHeader][codec:u8][plainSize:u32 BE][compressed json+bin];
+//   header.jsonSize stays the uncompressed JSON size, header.length the wire size
+// - codecs: LZ4 for speed when built with liblz4 (REXP_HAVE_LZ4), zlib via
+//   qCompress as the always-available fallback
+// - negotiated at login: the client offers the codec names it can decode, the
+//   server answers with the one to use; nothing is compressed towards a peer
+//   that has not accepted a codec
+// - only text-like message types above COMPRESS_MIN_BYTES are compressed
+//   (JPEG video and PCM audio do not shrink), and a result that saves less
+//   than 1/16 of the frame is thrown away
+// - Packet inflates lazily on the first json()/bin(), so a relay that only
+//   routes on the header never pays for it; LZ4 and zlib (when built with
+//   the zlib headers, REXP_HAVE_ZLIB) inflate into pooled slabs, never past
+//   the frame's plainSize
+// ===============================================
+
+#include <QtCore>
+#include "protocol.h"
+
+enum CompressionCodec : quint8 {
+    CODEC_NONE = 0,
+    CODEC_ZLIB = 1,
+    CODEC_LZ4  = 2
+};
+
+static const int COMPRESS_MIN_BYTES = 256;     // smallest json+bin worth compressing
+static const int COMPRESSED_PREFIX_SIZE = 5;   // codec + plainSize
+
+inline quint32 codecBit(CompressionCodec codec) { return 1u << codec; }
+
+QString compressionCodecName(CompressionCodec codec);
+CompressionCodec compressionCodecFromName(const QString& name);
+bool compressionCodecAvailable(CompressionCodec codec);
+
+// Codec names this build can decode, preferred first (goes into MSG_LOGIN "compress")
+QJsonArray compressionOffer();
+// Server side: the first offered codec this build supports; acceptedMask gets
+// codecBit() of every offered codec it can also relay to that peer untouched
+CompressionCodec negotiateCompression(const QJsonArray& offer, quint32* acceptedMask = nullptr);
+
+bool isCompressibleType(quint16 type);
+
+// Compressed copy of a complete frame, or `frame` itself when the type, the
+// size or the achieved ratio make it not worth it
+QByteArray compressFrame(const QByteArray& frame, CompressionCodec codec,
+                         int minBytes = COMPRESS_MIN_BYTES);
+
+// Codec of a FLAG_COMPRESSED frame, CODEC_NONE for a plain one
+CompressionCodec frameCodec(const QByteArray& frame);
+
+// Uncompressed json+bin of a FLAG_COMPRESSED frame. Output may live in a
+// pooled slab: hand it back with releaseInflated(). False on corrupt input.
+bool inflateFrameBody(const QByteArray& frame, QByteArray* body);
+void releaseInflated(QByteArray& body);
+
+// The whole frame uncompressed (FLAG_COMPRESSED cleared), for a relay towards
+// a peer without the codec. Empty on corrupt input.
+QByteArray decompressFrame(const QByteArray& frame);
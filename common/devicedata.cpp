@@ -0,0 +1,256 @@
+#include "devicedata.h"
+#include <QtEndian>
+
+static const quint8 DEVICE_BATCH_VERSION = 1;
+static const quint8 DEVICE_BATCH_UNIFORM = 0x01;
+static const int DEVICE_BATCH_HEADER_SIZE = 20;
+static const int DEVICE_COLUMN_HEADER_SIZE = 4;
+static const int DEVICE_BATCH_MAX_SAMPLES = 1 << 20;
+
+static int sampleSize(DeviceSampleType type)
+{
+    switch (type) {
+    case DeviceSampleType::Float32: return 4;
+    case DeviceSampleType::Int32:   return 4;
+    case DeviceSampleType::Int16:   return 2;
+    }
+    return 0;
+}
+
+static QString typeName(DeviceSampleType type)
+{
+    switch (type) {
+    case DeviceSampleType::Float32: return QStringLiteral("f32");
+    case DeviceSampleType::Int32:   return QStringLiteral("i32");
+    case DeviceSampleType::Int16:   return QStringLiteral("i16");
+    }
+    return QString();
+}
+
+static bool typeFromName(const QString& name, DeviceSampleType* out)
+{
+    if (name == QLatin1String("f32")) *out = DeviceSampleType::Float32;
+    else if (name == QLatin1String("i32")) *out = DeviceSampleType::Int32;
+    else if (name == QLatin1String("i16")) *out = DeviceSampleType::Int16;
+    else return false;
+    return true;
+}
+
+/* ---------- schema ---------- */
+
+int DeviceSchema::indexOf(quint16 channelId) const
+{
+    for (int i = 0; i < channels.size(); ++i) {
+        if (channels.at(i).id == channelId) return i;
+    }
+    return -1;
+}
+
+QJsonObject DeviceSchema::toJson() const
+{
+    QJsonArray list;
+    for (const DeviceChannel& ch : channels) {
+        QJsonObject o{{"id", ch.id}, {"name", ch.name}, {"type", typeName(ch.type)}};
+        if (!ch.unit.isEmpty()) o["unit"] = ch.unit;
+        if (ch.type != DeviceSampleType::Float32) o["scale"] = ch.scale;
+        list.append(o);
+    }
+    return QJsonObject{{"id", qint64(schemaId)}, {"device", device}, {"channels", list}};
+}
+
+bool DeviceSchema::fromJson(const QJsonObject& json, DeviceSchema* out)
+{
+    DeviceSchema schema;
+    schema.schemaId = quint32(json.value("id").toDouble());
+    schema.device = json.value("device").toString();
+    for (const QJsonValue& v : json.value("channels").toArray()) {
+        const QJsonObject o = v.toObject();
+        DeviceChannel ch;
+        ch.id = quint16(o.value("id").toInt());
+        ch.name = o.value("name").toString();
+        ch.unit = o.value("unit").toString();
+        ch.scale = o.value("scale").toDouble(1.0);
+        if (!typeFromName(o.value("type").toString(), &ch.type)) return false;
+        schema.channels.append(ch);
+    }
+    if (schema.channels.isEmpty()) return false;
+    *out = schema;
+    return true;
+}
+
+/* ---------- batch codec ---------- */
+
+QByteArray encodeDeviceBatch(const DeviceBatch& batch)
+{
+    const int n = batch.sampleCount;
+    const bool uniform = batch.intervalUs > 0;
+    if (n <= 0 || (!uniform && batch.offsetsUs.size() != n)) return QByteArray();
+
+    int size = DEVICE_BATCH_HEADER_SIZE + (uniform ? 4 : 4 * n);
+    for (const DeviceColumn& col : batch.columns) {
+        size += DEVICE_COLUMN_HEADER_SIZE + sampleSize(col.type) * n;
+    }
+    QByteArray out(size, Qt::Uninitialized);
+    uchar* p = reinterpret_cast<uchar*>(out.data());
+
+    p[0] = DEVICE_BATCH_VERSION;
+    p[1] = uniform ? DEVICE_BATCH_UNIFORM : 0;
+    qToLittleEndian<quint16>(quint16(batch.columns.size()), p + 2);
+    qToLittleEndian<quint32>(batch.schemaId, p + 4);
+    qToLittleEndian<quint32>(quint32(n), p + 8);
+    qToLittleEndian<qint64>(batch.baseUs, p + 12);
+    p += DEVICE_BATCH_HEADER_SIZE;
+    if (uniform) {
+        qToLittleEndian<quint32>(batch.intervalUs, p);
+        p += 4;
+    } else {
+        qToLittleEndian<quint32>(batch.offsetsUs.constData(), n, p);
+        p += 4 * n;
+    }
+
+    for (const DeviceColumn& col : batch.columns) {
+        qToLittleEndian<quint16>(col.channel, p);
+        p[2] = quint8(col.type);
+        p[3] = 0;
+        p += DEVICE_COLUMN_HEADER_SIZE;
+        switch (col.type) {
+        case DeviceSampleType::Float32:
+            if (col.floats.size() != n) return QByteArray();
+            qToLittleEndian<quint32>(col.floats.constData(), n, p); // bit pattern, byte-swapped only on BE hosts
+            break;
+        case DeviceSampleType::Int32:
+            if (col.ints.size() != n) return QByteArray();
+            qToLittleEndian<qint32>(col.ints.constData(), n, p);
+            break;
+        case DeviceSampleType::Int16:
+            if (col.ints.size() != n) return QByteArray();
+            for (int i = 0; i < n; ++i) {
+                qToLittleEndian<qint16>(qint16(qBound(-32768, col.ints.at(i), 32767)), p + 2 * i);
+            }
+            break;
+        }
+        p += sampleSize(col.type) * n;
+    }
+    return out;
+}
+
+bool decodeDeviceBatch(const QByteArray& bin, DeviceBatch* out, QString* error)
+{
+    auto fail = [error](const char* why) {
+        if (error) *error = QString::fromLatin1(why);
+        return false;
+    };
+    if (bin.size() < DEVICE_BATCH_HEADER_SIZE) return fail("device batch too short");
+    const uchar* p = reinterpret_cast<const uchar*>(bin.constData());
+    const uchar* end = p + bin.size();
+    if (p[0] != DEVICE_BATCH_VERSION) return fail("unsupported device batch version");
+
+    DeviceBatch batch;
+    const bool uniform = p[1] & DEVICE_BATCH_UNIFORM;
+    const int channels = qFromLittleEndian<quint16>(p + 2);
+    batch.schemaId = qFromLittleEndian<quint32>(p + 4);
+    const quint32 n = qFromLittleEndian<quint32>(p + 8);
+    batch.baseUs = qFromLittleEndian<qint64>(p + 12);
+    if (n == 0 || n > quint32(DEVICE_BATCH_MAX_SAMPLES)) return fail("bad sample count");
+    batch.sampleCount = int(n);
+    p += DEVICE_BATCH_HEADER_SIZE;
+
+    const qint64 timeBytes = uniform ? 4 : qint64(4) * n;
+    if (end - p < timeBytes) return fail("truncated timestamps");
+    if (uniform) {
+        batch.intervalUs = qFromLittleEndian<quint32>(p);
+        if (batch.intervalUs == 0) return fail("zero sample interval");
+    } else {
+        batch.offsetsUs.resize(int(n));
+        qFromLittleEndian<quint32>(p, n, batch.offsetsUs.data());
+    }
+    p += timeBytes;
+
+    batch.columns.resize(channels);
+    for (DeviceColumn& col : batch.columns) {
+        if (end - p < DEVICE_COLUMN_HEADER_SIZE) return fail("truncated column header");
+        col.channel = qFromLittleEndian<quint16>(p);
+        col.type = DeviceSampleType(p[2]);
+        const int width = sampleSize(col.type);
+        if (width == 0) return fail("unknown sample type");
+        p += DEVICE_COLUMN_HEADER_SIZE;
+        if (end - p < qint64(width) * n) return fail("truncated column");
+        switch (col.type) {
+        case DeviceSampleType::Float32:
+            col.floats.resize(int(n));
+            qFromLittleEndian<quint32>(p, n, col.floats.data());
+            break;
+        case DeviceSampleType::Int32:
+            col.ints.resize(int(n));
+            qFromLittleEndian<qint32>(p, n, col.ints.data());
+            break;
+        case DeviceSampleType::Int16:
+            col.ints.resize(int(n));
+            for (quint32 i = 0; i < n; ++i) col.ints[int(i)] = qFromLittleEndian<qint16>(p + 2 * i);
+            break;
+        }
+        p += qint64(width) * n;
+    }
+    *out = std::move(batch);
+    return true;
+}
+
+/* ---------- builder ---------- */
+
+DeviceBatchBuilder::DeviceBatchBuilder(const DeviceSchema& schema, int reserveSamples)
+    : schema_(schema)
+    , reserve_(qMax(0, reserveSamples))
+{
+    reset();
+}
+
+void DeviceBatchBuilder::reset()
+{
+    batch_ = DeviceBatch();
+    batch_.schemaId = schema_.schemaId;
+    batch_.offsetsUs.reserve(reserve_);
+    batch_.columns.resize(schema_.channels.size());
+    for (int c = 0; c < schema_.channels.size(); ++c) {
+        DeviceColumn& col = batch_.columns[c];
+        col.channel = schema_.channels.at(c).id;
+        col.type = schema_.channels.at(c).type;
+        if (col.type == DeviceSampleType::Float32) col.floats.reserve(reserve_);
+        else col.ints.reserve(reserve_);
+    }
+    uniform_ = true;
+    lastUs_ = 0;
+}
+
+void DeviceBatchBuilder::append(qint64 timestampUs, const double* values)
+{
+    if (batch_.sampleCount == 0) {
+        batch_.baseUs = timestampUs;
+    } else if (batch_.sampleCount >= 2 &&
+               timestampUs - lastUs_ != qint64(batch_.offsetsUs.at(1))) {
+        uniform_ = false;
+    }
+    batch_.offsetsUs.append(quint32(qBound<qint64>(0, timestampUs - batch_.baseUs, 0xffffffffLL)));
+    lastUs_ = timestampUs;
+
+    for (int c = 0; c < batch_.columns.size(); ++c) {
+        DeviceColumn& col = batch_.columns[c];
+        if (col.type == DeviceSampleType::Float32) {
+            col.floats.append(float(values[c]));
+        } else {
+            const double scale = schema_.channels.at(c).scale;
+            col.ints.append(qint32(qRound64(values[c] / (scale != 0 ? scale : 1.0))));
+        }
+    }
+    batch_.sampleCount++;
+}
+
+DeviceBatch DeviceBatchBuilder::take()
+{
+    DeviceBatch out = std::move(batch_);
+    if (uniform_ && out.sampleCount >= 2 && out.offsetsUs.at(1) > 0) {
+        out.intervalUs = out.offsetsUs.at(1);
+        out.offsetsUs.clear();
+    }
+    reset();
+    return out;
+}
@@ -0,0 +1,93 @@
+#pragma once
+// ===============================================
+// common/devicedata.h
+// Compact binary encoding for MSG_DEVICE_DATA telemetry
+// - DeviceSchema describes the channels (id, name, unit, sample type, scale);
+//   it is sent once per session as MSG_DEVICE_DATA JSON {"schema": {...}}
+//   and re-sent when a receiver asks with {"cmd":"schema_request"}
+// - sample frames carry {"schemaId", "samples"} in JSON and a DeviceBatch in
+//   bin: a timestamp base plus either a fixed interval or per-sample deltas,
+//   then one packed little-endian column per channel (float32/int32/int16)
+// - columns decode with one memcpy on little-endian hosts; thousands of
+//   samples per frame cost no per-sample allocation or string handling
+//
+// bin layout (all little-endian):
+//   u8 version | u8 flags (bit0: uniform interval) | u16 channelCount
+//   u32 schemaId | u32 sampleCount | i64 baseUs
+//   uniform: u32 intervalUs            else: sampleCount x u32 offsetUs
+//   per channel: u16 channelId | u8 type | u8 0 | sampleCount x value
+// ===============================================
+
+#include <QtCore>
+
+enum class DeviceSampleType : quint8 {
+    Float32 = 1,
+    Int32   = 2,
+    Int16   = 3     // physical value = raw * channel scale
+};
+
+struct DeviceChannel {
+    quint16 id = 0;
+    QString name;
+    QString unit;
+    DeviceSampleType type = DeviceSampleType::Float32;
+    double scale = 1.0;     // integer types only
+};
+
+struct DeviceSchema {
+    quint32 schemaId = 0;   // changes whenever the channel set changes
+    QString device;
+    QVector<DeviceChannel> channels;
+
+    int indexOf(quint16 channelId) const;
+    QJsonObject toJson() const;
+    static bool fromJson(const QJsonObject& json, DeviceSchema* out);
+};
+
+// Column of one channel: `floats` for Float32, `ints` for the integer types
+struct DeviceColumn {
+    quint16 channel = 0;
+    DeviceSampleType type = DeviceSampleType::Float32;
+    QVector<float> floats;
+    QVector<qint32> ints;
+
+    double value(int sample, double scale = 1.0) const {
+        return type == DeviceSampleType::Float32 ? double(floats.at(sample)) : ints.at(sample) * scale;
+    }
+};
+
+struct DeviceBatch {
+    quint32 schemaId = 0;
+    qint64 baseUs = 0;            // timestamp of the first sample, microseconds since epoch
+    quint32 intervalUs = 0;       // > 0: uniform sampling and offsetsUs is empty
+    QVector<quint32> offsetsUs;   // irregular sampling: per-sample offset from baseUs
+    int sampleCount = 0;
+    QVector<DeviceColumn> columns;
+
+    qint64 timestampUs(int sample) const {
+        return baseUs + (intervalUs ? qint64(intervalUs) * sample : qint64(offsetsUs.at(sample)));
+    }
+};
+
+QByteArray encodeDeviceBatch(const DeviceBatch& batch);
+bool decodeDeviceBatch(const QByteArray& bin, DeviceBatch* out, QString* error = nullptr);
+
+// Row-wise producer: append() one value per schema channel (schema order);
+// take() returns the columnar batch, uniform if every interval was equal
+class DeviceBatchBuilder {
+public:
+    explicit DeviceBatchBuilder(const DeviceSchema& schema, int reserveSamples = 0);
+
+    void append(qint64 timestampUs, const double* values);
+    int sampleCount() const { return batch_.sampleCount; }
+    DeviceBatch take();
+
+private:
+    void reset();
+
+    DeviceSchema schema_;
+    DeviceBatch batch_;
+    int reserve_;
+    qint64 lastUs_ = 0;
+    bool uniform_ = true;
+};
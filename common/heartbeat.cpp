@@ -0,0 +1,48 @@
+#include "heartbeat.h"
+
+// Samples above this are a stalled connection, not a round trip worth averaging
+static const qint64 RTT_MAX_SAMPLE_US = 60 * 1000 * 1000;
+
+qint64 heartbeatClockUs()
+{
+    static const QElapsedTimer clock = []() {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return clock.nsecsElapsed() / 1000;
+}
+
+void RttEstimator::reset()
+{
+    *this = RttEstimator();
+}
+
+void RttEstimator::addSample(qint64 rttUs)
+{
+    if (rttUs < 0 || rttUs > RTT_MAX_SAMPLE_US) return;
+    if (samples_ == 0) {
+        srttUs_ = rttUs;
+        rttvarUs_ = rttUs / 2.0;
+        minUs_ = rttUs;
+    } else {
+        rttvarUs_ = 0.75 * rttvarUs_ + 0.25 * qAbs(srttUs_ - rttUs);
+        srttUs_ = 0.875 * srttUs_ + 0.125 * rttUs;
+        minUs_ = qMin(minUs_, rttUs);
+        jitterUs_ += (qAbs(rttUs - lastUs_) - jitterUs_) / 16.0;
+    }
+    lastUs_ = rttUs;
+    samples_++;
+}
+
+QJsonObject RttEstimator::toJson() const
+{
+    QJsonObject o;
+    o["rttSamples"] = qint64(samples_);
+    if (samples_ == 0) return o;
+    o["rttMs"] = qRound(srttMs() * 100) / 100.0;
+    o["rttMinMs"] = qRound(minMs() * 100) / 100.0;
+    o["rttVarMs"] = qRound(rttvarMs() * 100) / 100.0;
+    o["jitterMs"] = qRound(jitterMs() * 100) / 100.0;
+    return o;
+}
@@ -0,0 +1,45 @@
+#pragma once
+// ===============================================
+// common/heartbeat.h
+// Connection liveness and round-trip measurement (MSG_HEARTBEAT / MSG_ACK)
+// - the server pings every connection every HEARTBEAT_INTERVAL_MS with
+//   {"hb": <send time us>} plus its current estimate for that connection
+//   ({"rtt", "jitter"} in ms); the client answers at once with MSG_ACK {"hb": <echo>}
+// - both are control-class frames, so they bypass queued video on either side
+//   and the RTT includes socket-buffer delay, not the send queue
+// - a peer that sends nothing at all for HEARTBEAT_TIMEOUT_MS is treated as dead
+// - RttEstimator: smoothed RTT and variance as in RFC 6298, jitter as the
+//   RFC 3550 running mean of the change between consecutive samples
+// ===============================================
+
+#include <QtCore>
+
+static const qint64 HEARTBEAT_INTERVAL_MS = 2000;
+static const qint64 HEARTBEAT_TIMEOUT_MS = 10000;  // ~5 missed heartbeats
+
+// Monotonic microseconds shared by every thread in the process (heartbeat
+// timestamps may be echoed to a different shard after a hand-off)
+qint64 heartbeatClockUs();
+
+class RttEstimator {
+public:
+    void addSample(qint64 rttUs);
+    void reset();
+
+    bool hasSamples() const { return samples_ > 0; }
+    quint64 samples() const { return samples_; }
+    double lastMs() const { return lastUs_ / 1000.0; }
+    double srttMs() const { return srttUs_ / 1000.0; }
+    double rttvarMs() const { return rttvarUs_ / 1000.0; }
+    double minMs() const { return minUs_ / 1000.0; }
+    double jitterMs() const { return jitterUs_ / 1000.0; }
+    QJsonObject toJson() const;  // {"rttMs", "rttMinMs", "rttVarMs", "jitterMs", "rttSamples"}
+
+private:
+    quint64 samples_ = 0;
+    qint64 lastUs_ = 0;
+    double srttUs_ = 0;
+    double rttvarUs_ = 0;
+    qint64 minUs_ = 0;
+    double jitterUs_ = 0;
+};
@@ -0,0 +1,131 @@
+#include "logsink.h"
+#include <QTextEdit>
+#include <QTextCursor>
+#include <QScrollBar>
+#include <QStandardPaths>
+
+static const int LOG_FLUSH_INTERVAL_MS = 200;
+
+LogSink::LogSink(QTextEdit* view, const QString& filePath, int maxLines,
+                 qint64 maxFileBytes, int keepFiles, QObject* parent)
+    : QObject(parent)
+    , view_(view)
+    , flushTimer_(this)
+    , maxLines_(qMax(10, maxLines))
+    , maxFileBytes_(maxFileBytes)
+    , keepFiles_(qMax(0, keepFiles))
+{
+    if (view_) view_->document()->setMaximumBlockCount(maxLines_);
+    if (!filePath.isEmpty()) {
+        QDir().mkpath(QFileInfo(filePath).absolutePath());
+        file_.setFileName(filePath);
+        if (!file_.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+            qWarning() << "LogSink: cannot open" << filePath << file_.errorString();
+        } else {
+            fileEnabled_ = true;
+        }
+    }
+    connect(&flushTimer_, &QTimer::timeout, this, &LogSink::flush);
+    flushTimer_.start(LOG_FLUSH_INTERVAL_MS);
+}
+
+LogSink::~LogSink()
+{
+    flush();
+}
+
+QString LogSink::defaultLogPath(const QString& appName)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    if (dir.isEmpty()) dir = QDir::tempPath();
+    return QDir(dir).filePath(appName + ".log");
+}
+
+void LogSink::append(const QString& line)
+{
+    QMutexLocker lock(&mutex_);
+    if (line == lastLine_) {
+        repeat_++;
+        return;
+    }
+    flushRepeatLocked();
+    lastLine_ = line;
+    enqueueLocked(line);
+}
+
+void LogSink::enqueueLocked(const QString& line)
+{
+    if (fileEnabled_) {
+        fileQueue_ += QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz ").toUtf8();
+        fileQueue_ += line.toUtf8();
+        fileQueue_ += '\n';
+    }
+    if (pending_.size() >= maxLines_) {
+        pending_.removeFirst();
+        skipped_++;
+    }
+    pending_.append(line);
+}
+
+void LogSink::flushRepeatLocked()
+{
+    if (repeat_ > 0) {
+        enqueueLocked(QString("%1 (x%2)").arg(lastLine_).arg(repeat_));
+        repeat_ = 0;
+    }
+}
+
+void LogSink::flush()
+{
+    QStringList lines;
+    QByteArray fileLines;
+    qint64 skipped;
+    {
+        QMutexLocker lock(&mutex_);
+        // Keep lastLine_ so a repeat across the flush still coalesces
+        flushRepeatLocked();
+        fileLines.swap(fileQueue_);
+        lines.swap(pending_);
+        skipped = skipped_;
+        skipped_ = 0;
+    }
+    writeFile(fileLines);
+    if (lines.isEmpty() || !view_) return;
+    // Only the widget loses lines; the file already has them
+    if (skipped > 0) lines.prepend(QString("... %1 lines skipped (see log file)").arg(skipped));
+
+    // One plain-text insertion for the whole batch; keep following the tail
+    // only if the user has not scrolled up
+    QScrollBar* bar = view_->verticalScrollBar();
+    const bool atBottom = bar->value() >= bar->maximum() - 4;
+    QTextCursor cursor(view_->document());
+    cursor.movePosition(QTextCursor::End);
+    if (!view_->document()->isEmpty()) cursor.insertBlock();
+    cursor.insertText(lines.join(QChar('\n')));
+    if (atBottom) bar->setValue(bar->maximum());
+}
+
+void LogSink::writeFile(const QByteArray& out)
+{
+    if (out.isEmpty() || !file_.isOpen()) return;
+    file_.write(out);
+    file_.flush();
+    if (maxFileBytes_ > 0 && file_.size() >= maxFileBytes_) rotate();
+}
+
+// name.log -> name.log.1 -> ... -> name.log.<keepFiles>; the oldest is removed
+void LogSink::rotate()
+{
+    const QString path = file_.fileName();
+    file_.close();
+    QFile::remove(QString("%1.%2").arg(path).arg(keepFiles_));
+    for (int i = keepFiles_ - 1; i >= 1; --i) {
+        QFile::rename(QString("%1.%2").arg(path).arg(i), QString("%1.%2").arg(path).arg(i + 1));
+    }
+    if (keepFiles_ > 0) QFile::rename(path, path + ".1");
+    else QFile::remove(path);
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "LogSink: cannot reopen" << path << file_.errorString();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+// ===============================================
+// common/logsink.h
+// Client log view backend: bounded, coalesced, batched
+// - append() only queues the line; a timer flushes the batch into the
+//   QTextEdit with one cursor edit, so bursts cost one layout pass
+// - identical consecutive lines collapse into "line (xN)"
+// - the widget keeps at most maxLines blocks (QTextDocument::maximumBlockCount)
+//   and the pending batch is a ring of the same size; overflow is summarised
+// - every line also goes to a rotating log file (name.log, name.log.1, ...)
+//   with the time it was appended, for full history: the file queue is
+//   separate from the widget ring and never drops lines
+// ===============================================
+
+#include <QtCore>
+#include <QPointer>
+#include <QTextEdit>
+
+class LogSink : public QObject {
+    Q_OBJECT
+public:
+    // filePath empty = widget only. Rotation keeps `keepFiles` old files.
+    LogSink(QTextEdit* view, const QString& filePath, int maxLines = 2000,
+            qint64 maxFileBytes = 4 * 1024 * 1024, int keepFiles = 3, QObject* parent = nullptr);
+    ~LogSink() override;
+
+    void append(const QString& line);   // any thread
+    void flush();                       // owner thread
+
+    static QString defaultLogPath(const QString& appName); // <AppLocalDataLocation>/<appName>.log
+
+private:
+    void enqueueLocked(const QString& line);
+    void flushRepeatLocked();
+    void writeFile(const QByteArray& out);
+    void rotate();
+
+    QPointer<QTextEdit> view_;   // may be destroyed first during window teardown
+    QTimer flushTimer_;
+    QMutex mutex_;
+    QStringList pending_;     // widget ring: at most maxLines_
+    qint64 skipped_ = 0;      // lines that fell out of the ring before a flush
+    QByteArray fileQueue_;    // timestamped UTF-8 lines for the log file, unbounded
+    QString lastLine_;
+    int repeat_ = 0;          // extra occurrences of lastLine_ not yet written
+    int maxLines_;
+
+    QFile file_;              // owner thread only (rotate() reopens it)
+    bool fileEnabled_ = false; // set once in the constructor, read by append()
+    qint64 maxFileBytes_;
+    int keepFiles_;
+};
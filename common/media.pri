@@ -0,0 +1,14 @@
+# Client-side helpers (camera capture, video, log view); the server only needs common.pri
+INCLUDEPATH += $$PWD
+SOURCES += $$PWD/colorconvert.cpp \
+           $$PWD/adaptivevideo.cpp \
+           $$PWD/tilecodec.cpp \
+           $$PWD/videodecoder.cpp \
+           $$PWD/videopipeline.cpp \
+           $$PWD/logsink.cpp
+HEADERS += $$PWD/colorconvert.h \
+           $$PWD/adaptivevideo.h \
+           $$PWD/tilecodec.h \
+           $$PWD/videodecoder.h \
+           $$PWD/videopipeline.h \
+           $$PWD/logsink.h
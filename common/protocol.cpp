@@ -1,4 +1,5 @@
 #include "protocol.h"
+#include "compression.h"
 #include <QDateTime>
 #include <QDataStream>
 #include <QMutexLocker>
@@ -13,13 +14,23 @@ Q_LOGGING_CATEGORY(logRecording, "recording")
 // Global sequence counter for packet ordering
 static QAtomicInt g_sequenceCounter(0);
 
+// Copy an identifier into a fixed-size, null-terminated header field (truncate if necessary)
+static void writeHeaderId(char* field, quint32 fieldSize, const QString& id)
+{
+    QByteArray idBytes = id.toLatin1();
+    int idLen = qMin(idBytes.size(), static_cast<int>(fieldSize - 1));
+    memset(field, 0, fieldSize);
+    memcpy(field, idBytes.constData(), idLen);
+}
+
 QByteArray buildPacket(quint16 type,
                        const QJsonObject& json,
                        const QByteArray& bin,
                        const QString& roomId,
                        const QString& senderId,
                        quint16 flags,
-                       quint32 seq)
+                       quint32 seq,
+                       quint16 layer)
 {
     // Prepare JSON payload
     QByteArray jsonBytes = toJsonBytes(json);
@@ -41,22 +52,15 @@ QByteArray buildPacket(quint16 type,
     header.version = qToBigEndian(PROTOCOL_VERSION);
     header.msgType = qToBigEndian(type);
     header.flags = qToBigEndian(flags);
-    header.reserved = 0;
+    header.layer = qToBigEndian(layer);
     header.length = qToBigEndian(totalSize);
     header.timestampMs = qToBigEndian(static_cast<quint64>(QDateTime::currentMSecsSinceEpoch()));
     header.seq = qToBigEndian(seq == 0 ? g_sequenceCounter.fetchAndAddOrdered(1) : seq);
     header.jsonSize = qToBigEndian(static_cast<quint32>(jsonBytes.size()));
     
     // Copy room ID and sender ID (truncate if necessary)
-    QByteArray roomIdBytes = roomId.toLatin1();
-    int roomIdLen = qMin(roomIdBytes.size(), static_cast<int>(ROOM_ID_SIZE - 1));
-    memcpy(header.roomId, roomIdBytes.constData(), roomIdLen);
-    header.roomId[roomIdLen] = '\0';
-    
-    QByteArray senderIdBytes = senderId.toLatin1();
-    int senderIdLen = qMin(senderIdBytes.size(), static_cast<int>(SENDER_ID_SIZE - 1));
-    memcpy(header.senderId, senderIdBytes.constData(), senderIdLen);
-    header.senderId[senderIdLen] = '\0';
+    writeHeaderId(header.roomId, ROOM_ID_SIZE, roomId);
+    writeHeaderId(header.senderId, SENDER_ID_SIZE, senderId);
     
     // Build final packet
     QByteArray packet;
@@ -83,20 +87,21 @@ QByteArray buildPacket(quint16 type,
     return packet;
 }
 
-bool drainPackets(QByteArray& buffer, QVector<Packet>& out, QString* error)
+int decodeFrames(const char* data, int size, QVector<Packet>& out, QString* error)
 {
-    bool producedPackets = false;
+    int offset = 0;
     
-    while (buffer.size() >= static_cast<int>(sizeof(FrameHeader))) {
+    while (size - offset >= static_cast<int>(sizeof(FrameHeader))) {
         // Parse header (without consuming buffer yet)
         FrameHeader header;
-        memcpy(&header, buffer.constData(), sizeof(header));
+        memcpy(&header, data + offset, sizeof(header));
         
         // Convert from network byte order
         header.magic = qFromBigEndian(header.magic);
         header.version = qFromBigEndian(header.version);
         header.msgType = qFromBigEndian(header.msgType);
         header.flags = qFromBigEndian(header.flags);
+        header.layer = qFromBigEndian(header.layer);
         header.length = qFromBigEndian(header.length);
         header.timestampMs = qFromBigEndian(header.timestampMs);
         header.seq = qFromBigEndian(header.seq);
@@ -107,57 +112,142 @@ bool drainPackets(QByteArray& buffer, QVector<Packet>& out, QString* error)
         if (!validateFrameHeader(header, &validationError)) {
             if (error) *error = validationError;
             qCWarning(logProtocol) << "Invalid frame header:" << validationError;
-            buffer.clear(); // Discard buffer on validation error
-            return producedPackets;
+            return -1; // Caller discards the buffer on validation error
         }
         
         // Check if we have the complete frame
-        if (buffer.size() < static_cast<int>(header.length)) {
+        if (size - offset < static_cast<int>(header.length)) {
             // Incomplete frame, wait for more data
             break;
         }
         
-        // Extract complete frame
-        QByteArray frameData = buffer.left(header.length);
-        buffer.remove(0, header.length);
-        
-        // Parse JSON payload
-        QByteArray jsonBytes;
-        if (header.jsonSize > 0) {
-            if (sizeof(FrameHeader) + header.jsonSize > header.length) {
-                if (error) *error = "JSON size exceeds frame size";
-                continue; // Skip invalid frame
-            }
-            jsonBytes = frameData.mid(sizeof(FrameHeader), header.jsonSize);
-        }
-        
-        // Parse binary payload
-        QByteArray binData;
-        quint32 binSize = header.length - sizeof(FrameHeader) - header.jsonSize;
-        if (binSize > 0) {
-            binData = frameData.right(binSize);
-        }
-        
-        // Create packet
+        // Create packet: one copy of the frame out of the receive buffer; JSON and
+        // binary sections are views into it (JSON stays unparsed until json())
         Packet packet(header);
-        if (!jsonBytes.isEmpty()) {
-            packet.json = fromJsonBytes(jsonBytes);
-            if (packet.json.isEmpty() && !jsonBytes.isEmpty()) {
-                qCWarning(logProtocol) << "Failed to parse JSON payload";
-                continue; // Skip packet with invalid JSON
-            }
-        }
-        packet.bin = binData;
-        
-        out.push_back(std::move(packet));
-        producedPackets = true;
+        packet.raw = QByteArray(data + offset, header.length); // sole owner: relays can stamp it in place
+        offset += header.length;
         
         qCDebug(logProtocol) << "Parsed packet: type=" << packet.type
                             << "room=" << packet.roomId
                             << "sender=" << packet.senderId;
+        
+        out.push_back(std::move(packet));
     }
     
-    return producedPackets;
+    return offset;
+}
+
+bool drainPackets(QByteArray& buffer, QVector<Packet>& out, QString* error)
+{
+    const int before = out.size();
+    const int consumed = decodeFrames(buffer.constData(), buffer.size(), out, error);
+    if (consumed < 0) {
+        buffer.clear(); // Discard buffer on validation error
+    } else if (consumed > 0) {
+        buffer.remove(0, consumed); // Compact once per batch, not once per frame
+    }
+    return out.size() > before;
+}
+
+Packet::~Packet()
+{
+    if (inflated_) releaseInflated(plain_);
+}
+
+void Packet::payload(const char** data, int* size) const
+{
+    if (!(flags & FLAG_COMPRESSED)) {
+        *data = raw.constData() + sizeof(FrameHeader);
+        *size = qMax(0, raw.size() - static_cast<int>(sizeof(FrameHeader)));
+        return;
+    }
+    if (!inflated_) {
+        inflated_ = true;
+        if (!inflateFrameBody(raw, &plain_)) {
+            qCWarning(logProtocol) << "Failed to inflate compressed payload: type=" << type;
+            plain_.clear();
+        }
+    }
+    *data = plain_.constData();
+    *size = plain_.size();
+}
+
+QByteArray Packet::jsonBytes() const
+{
+    const char* data;
+    int size;
+    payload(&data, &size);
+    if (jsonSize_ == 0 || size < static_cast<int>(jsonSize_)) {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(data, jsonSize_);
+}
+
+QByteArray Packet::bin() const
+{
+    const char* data;
+    int size;
+    payload(&data, &size);
+    if (size <= static_cast<int>(jsonSize_)) {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(data + jsonSize_, size - jsonSize_);
+}
+
+const QJsonObject& Packet::json() const
+{
+    if (!jsonParsed_) {
+        jsonParsed_ = true;
+        const QByteArray jsonBytes = this->jsonBytes();
+        if (!jsonBytes.isEmpty()) {
+            json_ = fromJsonBytes(jsonBytes);
+            if (json_.isEmpty()) {
+                qCWarning(logProtocol) << "Failed to parse JSON payload: type=" << type;
+            }
+        }
+    }
+    return json_;
+}
+
+bool stampFrameHeader(QByteArray& frame, const QString& roomId, const QString& senderId)
+{
+    if (frame.size() < static_cast<int>(sizeof(FrameHeader))) {
+        return false;
+    }
+
+    // Only the fixed-size routing fields change; the rest of the frame is left untouched
+    FrameHeader* header = reinterpret_cast<FrameHeader*>(frame.data());
+    writeHeaderId(header->roomId, ROOM_ID_SIZE, roomId);
+    writeHeaderId(header->senderId, SENDER_ID_SIZE, senderId);
+    return true;
+}
+
+bool stampFrameSeq(QByteArray& frame, quint32 seq)
+{
+    if (frame.size() < static_cast<int>(sizeof(FrameHeader))) {
+        return false;
+    }
+    FrameHeader* header = reinterpret_cast<FrameHeader*>(frame.data());
+    header->seq = qToBigEndian(seq);
+    return true;
+}
+
+bool stampFrameFlags(QByteArray& frame, quint16 flags)
+{
+    if (frame.size() < static_cast<int>(sizeof(FrameHeader))) {
+        return false;
+    }
+    FrameHeader* header = reinterpret_cast<FrameHeader*>(frame.data());
+    header->flags = qToBigEndian(flags);
+    return true;
+}
+
+quint16 frameFlags(const QByteArray& frame)
+{
+    if (frame.size() < static_cast<int>(sizeof(FrameHeader))) {
+        return 0;
+    }
+    return qFromBigEndian(reinterpret_cast<const FrameHeader*>(frame.constData())->flags);
 }
 
 bool validateFrameHeader(const FrameHeader& header, QString* error)
@@ -186,6 +276,16 @@ bool validateFrameHeader(const FrameHeader& header, QString* error)
         return false;
     }
     
+    // A compressed frame carries the uncompressed JSON size; the inflated
+    // payload is checked against it on first access instead
+    if (header.flags & FLAG_COMPRESSED) {
+        if (header.length < sizeof(FrameHeader) + COMPRESSED_PREFIX_SIZE) {
+            if (error) *error = "Compressed frame too short";
+            return false;
+        }
+        return true;
+    }
+
     // Check that JSON size doesn't exceed frame size
     if (sizeof(FrameHeader) + header.jsonSize > header.length) {
         if (error) *error = "JSON size exceeds frame size";
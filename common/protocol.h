@@ -3,7 +3,7 @@
 // common/protocol.h
 // Enhanced protocol with binary frame header + JSON payload
 // Structure: [FrameHeader][jsonPayload][binaryPayload]
-// FrameHeader: magic('REXP') + version + msgType + flags + length + roomId + senderId + timestampMs + seq
+// FrameHeader: magic('REXP') + version + msgType + flags + layer + length + roomId + senderId + timestampMs + seq
 // - Provides versioning, extensibility, frame validation, and routing information
 // - Maximum frame size enforced for security and memory management
 // ===============================================
@@ -26,6 +26,7 @@ static const quint32 MAX_FRAME_SIZE = 16 * 1024 * 1024; // 16MB max frame size
 static const quint32 MAX_JSON_SIZE = 1 * 1024 * 1024;   // 1MB max JSON payload
 static const quint32 ROOM_ID_SIZE = 16;
 static const quint32 SENDER_ID_SIZE = 16;
+static const quint16 SIMULCAST_MAX_LAYERS = 3;          // video layers per publisher (1 = lowest quality)
 
 // Frame flags
 enum FrameFlags : quint16 {
@@ -34,7 +35,9 @@ enum FrameFlags : quint16 {
     FLAG_ENCRYPTED      = 0x0002,  // Payload is encrypted (future)
     FLAG_FRAGMENTED     = 0x0004,  // Multi-part message (future)
     FLAG_ACK_REQUIRED   = 0x0008,  // Requires acknowledgment
-    FLAG_PRIORITY       = 0x0010   // High priority message
+    FLAG_PRIORITY       = 0x0010,  // High priority message
+    FLAG_KEYFRAME       = 0x0020,  // Video: independently decodable frame
+    FLAG_DELTA_FRAME    = 0x0040   // Video: changed tiles against the previous frame (tilecodec.h)
 };
 
 // Enhanced message types with proper categorization and backward compatibility
@@ -46,6 +49,7 @@ enum MsgType : quint16 {
     MSG_CREATE_WORKORDER = 4,   // Create work order
     MSG_JOIN_WORKORDER   = 4,   // Join work order (room) - KEEPING OLD VALUE FOR COMPATIBILITY
     MSG_LEAVE_WORKORDER  = 6,   // Leave work order (room)
+    MSG_RESUME_SESSION   = 7,   // Reconnect: {"token", "roomId", "user", "compress", "ack"} restores the session
 
     // Communication (10-19) - keeping old numbers for compatibility
     MSG_TEXT             = 10,  // Text message - KEEPING OLD VALUE FOR COMPATIBILITY
@@ -92,7 +96,8 @@ struct FrameHeader {
     quint16 version;        // Protocol version (2 bytes)
     quint16 msgType;        // Message type (enum MsgType) (2 bytes)
     quint16 flags;          // Frame flags (enum FrameFlags) (2 bytes)
-    quint16 reserved;       // Reserved for future use (2 bytes)
+    quint16 layer;          // Simulcast layer of MSG_VIDEO_FRAME: 0 = single stream,
+                            // 1..SIMULCAST_MAX_LAYERS = lowest..highest quality (2 bytes)
     quint32 length;         // Total frame length (header + JSON + binary) (4 bytes)
     char roomId[ROOM_ID_SIZE];     // Room identifier (16 bytes, null-terminated)
     char senderId[SENDER_ID_SIZE]; // Sender identifier (16 bytes, null-terminated)
@@ -110,27 +115,57 @@ struct Packet {
     // Header information
     quint16 type = 0;
     quint16 flags = FLAG_NONE;
+    quint16 layer = 0;
     QString roomId;
     QString senderId;
     quint64 timestampMs = 0;
     quint32 seq = 0;
     
-    // Payload
-    QJsonObject json;
-    QByteArray bin;
+    // Original wire frame (header + JSON + binary): the only per-frame allocation.
+    // Relays forward this buffer as-is instead of rebuilding the frame.
+    QByteArray raw;
     
     // Default constructor
     Packet() = default;
+    Packet(const Packet&) = default;
+    Packet(Packet&&) = default;
+    Packet& operator=(const Packet&) = default;
+    Packet& operator=(Packet&&) = default;
+    ~Packet(); // returns a pooled inflate buffer (compression.h)
     
     // Constructor from header
     explicit Packet(const FrameHeader& header) 
         : type(header.msgType)
         , flags(header.flags)
+        , layer(header.layer)
         , roomId(QString::fromLatin1(header.roomId, strnlen(header.roomId, ROOM_ID_SIZE)))
         , senderId(QString::fromLatin1(header.senderId, strnlen(header.senderId, SENDER_ID_SIZE)))
         , timestampMs(header.timestampMs)
         , seq(header.seq)
+        , jsonSize_(header.jsonSize)
     {}
+
+    // Payload views into raw (QByteArray::fromRawData, no copy). They stay valid
+    // only while this Packet (or a copy sharing raw) is alive and raw is unchanged;
+    // keep the Packet, not the view, if the payload must outlive the call.
+    // A FLAG_COMPRESSED frame is inflated on first access and the views point
+    // into the inflated copy; raw always stays the wire frame.
+    QByteArray jsonBytes() const;
+    QByteArray bin() const;
+
+    // Lazily parsed JSON payload (empty object if absent or malformed);
+    // relayed frames never pay for a parse
+    const QJsonObject& json() const;
+
+private:
+    // [json][bin] without the header: a view of raw, or the inflated copy
+    void payload(const char** data, int* size) const;
+
+    quint32 jsonSize_ = 0;
+    mutable QJsonObject json_;
+    mutable bool jsonParsed_ = false;
+    mutable QByteArray plain_;   // inflated payload of a compressed frame
+    mutable bool inflated_ = false;
 };
 
 // Utility functions for JSON encoding/decoding (compact format for bandwidth efficiency)
@@ -150,11 +185,27 @@ QByteArray buildPacket(quint16 type,
                        const QString& roomId = QString(),
                        const QString& senderId = QString(),
                        quint16 flags = FLAG_NONE,
-                       quint32 seq = 0);
+                       quint32 seq = 0,
+                       quint16 layer = 0);
 
 // Enhanced packet parsing with frame validation and error handling
 bool drainPackets(QByteArray& buffer, QVector<Packet>& out, QString* error = nullptr);
 
+// Decode every complete frame in [data, data+size) without touching the buffer.
+// Returns the number of bytes consumed, or -1 if a header is invalid.
+int decodeFrames(const char* data, int size, QVector<Packet>& out, QString* error = nullptr);
+
+// Rewrite roomId/senderId of an already framed packet in place (no JSON re-encode,
+// no payload copy as long as the frame buffer is not shared)
+bool stampFrameHeader(QByteArray& frame, const QString& roomId, const QString& senderId);
+
+// Rewrite the seq / flags fields of an already framed packet in place
+// (reliable streams renumber on a new session; the server restamps relayed
+// control/text frames with each receiver's own downlink seq)
+bool stampFrameSeq(QByteArray& frame, quint32 seq);
+bool stampFrameFlags(QByteArray& frame, quint16 flags);
+quint16 frameFlags(const QByteArray& frame); // 0 for a frame shorter than the header
+
 // Helper functions for protocol validation
 bool validateFrameHeader(const FrameHeader& header, QString* error = nullptr);
 QString errorCodeToString(ErrorCode code);
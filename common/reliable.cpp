@@ -0,0 +1,180 @@
+#include "reliable.h"
+#include "protocol.h"
+#include <limits>
+
+// A hole younger than this is most likely a frame the sender's queue reordered
+static const qint64 NACK_DELAY_MS = 200;
+static const qint64 NACK_REPEAT_MS = 1000;
+static const int NACK_MAX_SEQS = 64;
+static const int NACK_MAX_ATTEMPTS = 3;
+// Out-of-order frames remembered per stream; beyond it the oldest hole is given up
+static const quint32 REORDER_WINDOW = 1024;
+
+bool isReliableType(quint16 type)
+{
+    return type == MSG_CONTROL_CMD || type == MSG_TEXT;
+}
+
+/* ---------- sender ---------- */
+
+ReliableSender::ReliableSender(int maxFrames, qint64 maxBytes)
+    : maxFrames_(qMax(1, maxFrames))
+    , maxBytes_(maxBytes)
+{
+}
+
+quint32 ReliableSender::nextSeq(quint16 type)
+{
+    return ++lastSeq_[type];
+}
+
+void ReliableSender::store(const ReliableFrame& f)
+{
+    frames_.append(f);
+    bytes_ += f.frame.size();
+    stats_.sent++;
+    evictOverflow();
+}
+
+void ReliableSender::evictOverflow()
+{
+    // Bounded: the oldest frame goes first; the receiver will give up on that hole
+    while (frames_.size() > maxFrames_ || (bytes_ > maxBytes_ && frames_.size() > 1)) {
+        bytes_ -= frames_.first().frame.size();
+        frames_.removeFirst();
+        stats_.overflow++;
+    }
+}
+
+void ReliableSender::onAck(const QJsonObject& json)
+{
+    const QJsonObject acks = json.value("ack").toObject();
+    if (acks.isEmpty()) return;
+    QHash<quint16, quint32> upTo;
+    for (auto it = acks.constBegin(); it != acks.constEnd(); ++it) {
+        upTo.insert(quint16(it.key().toUInt()), quint32(it.value().toDouble()));
+    }
+    for (auto it = frames_.begin(); it != frames_.end(); ) {
+        const auto ack = upTo.constFind(it->type);
+        if (ack != upTo.constEnd() && it->seq <= ack.value()) {
+            bytes_ -= it->frame.size();
+            stats_.acked++;
+            it = frames_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QVector<ReliableFrame> ReliableSender::onNack(const QJsonObject& json)
+{
+    QVector<ReliableFrame> out;
+    const QJsonObject nacks = json.value("nack").toObject();
+    for (auto it = nacks.constBegin(); it != nacks.constEnd(); ++it) {
+        const quint16 type = quint16(it.key().toUInt());
+        QSet<quint32> wanted;
+        for (const QJsonValue& v : it.value().toArray()) wanted.insert(quint32(v.toDouble()));
+        for (const ReliableFrame& f : qAsConst(frames_)) {
+            if (f.type == type && wanted.contains(f.seq)) out.append(f);
+        }
+    }
+    stats_.retransmitted += out.size();
+    return out;
+}
+
+void ReliableSender::renumber()
+{
+    lastSeq_.clear();
+    for (ReliableFrame& f : frames_) {
+        f.seq = nextSeq(f.type);
+        stampFrameSeq(f.frame, f.seq);
+    }
+}
+
+void ReliableSender::clear()
+{
+    frames_.clear();
+    lastSeq_.clear();
+    bytes_ = 0;
+}
+
+/* ---------- receiver ---------- */
+
+bool ReliableReceiver::accept(quint16 type, quint32 seq, qint64 nowMs)
+{
+    Stream& s = streams_[type];
+    if (seq < s.next || s.above.contains(seq)) {
+        stats_.duplicates++;
+        return false;
+    }
+    stats_.received++;
+    if (seq == s.next) {
+        s.next++;
+        while (s.above.remove(s.next)) s.next++;
+        s.nackAttempts = 0;
+    } else {
+        s.above.insert(seq);
+        if (s.gapSinceMs < 0) s.gapSinceMs = nowMs;
+        if (seq - s.next >= REORDER_WINDOW) skipOldestHole(s); // too far ahead to keep waiting
+    }
+    if (s.above.isEmpty()) s.gapSinceMs = -1;
+    return true;
+}
+
+void ReliableReceiver::skipOldestHole(Stream& s)
+{
+    if (s.above.isEmpty()) return;
+    quint32 oldest = std::numeric_limits<quint32>::max();
+    for (quint32 held : qAsConst(s.above)) oldest = qMin(oldest, held);
+    stats_.skipped += oldest - s.next;
+    s.next = oldest;
+    while (s.above.remove(s.next)) s.next++;
+    s.nackAttempts = 0;
+    s.lastNackMs = -1;
+    s.gapSinceMs = s.above.isEmpty() ? -1 : s.gapSinceMs;
+}
+
+bool ReliableReceiver::hasGaps() const
+{
+    for (const Stream& s : streams_) {
+        if (!s.above.isEmpty()) return true;
+    }
+    return false;
+}
+
+QJsonObject ReliableReceiver::takeAck(bool full)
+{
+    QJsonObject acks;
+    for (auto it = streams_.begin(); it != streams_.end(); ++it) {
+        const quint32 upTo = it->next - 1;
+        if (upTo == it->acked && !full) continue;
+        it->acked = upTo;
+        acks.insert(QString::number(it.key()), qint64(upTo));
+    }
+    return acks.isEmpty() && !full ? QJsonObject() : QJsonObject{{"ack", acks}};
+}
+
+QJsonObject ReliableReceiver::takeNack(qint64 nowMs)
+{
+    QJsonObject nacks;
+    for (auto it = streams_.begin(); it != streams_.end(); ++it) {
+        Stream& s = it.value();
+        if (s.above.isEmpty() || nowMs - s.gapSinceMs < NACK_DELAY_MS) continue;
+        if (s.lastNackMs >= 0 && nowMs - s.lastNackMs < NACK_REPEAT_MS) continue;
+        if (s.nackAttempts >= NACK_MAX_ATTEMPTS) {
+            skipOldestHole(s);
+            if (s.above.isEmpty()) continue;
+        }
+        quint32 highest = 0;
+        for (quint32 held : qAsConst(s.above)) highest = qMax(highest, held);
+        QJsonArray missing;
+        for (quint32 seq = s.next; seq < highest && missing.size() < NACK_MAX_SEQS; ++seq) {
+            if (!s.above.contains(seq)) missing.append(qint64(seq));
+        }
+        s.lastNackMs = nowMs;
+        s.nackAttempts++;
+        stats_.nacked += missing.size();
+        nacks.insert(QString::number(it.key()), missing);
+    }
+    return nacks.isEmpty() ? QJsonObject() : QJsonObject{{"nack", nacks}};
+}
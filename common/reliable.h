@@ -0,0 +1,102 @@
+#pragma once
+// ===============================================
+// common/reliable.h
+// Reliable delivery for control and text traffic (FLAG_ACK_REQUIRED)
+// - one stream per message type (MSG_CONTROL_CMD, MSG_TEXT), each numbered
+//   1, 2, 3... in FrameHeader::seq; media never enters this path
+// - each direction is its own set of streams: client -> server numbered by
+//   the client, server -> client numbered per receiving connection by the
+//   server (relayed frames are restamped), so delivery is end to end
+// - ReliableSender: bounded retransmit buffer of the wire frames
+//   still unacknowledged; an ACK drops everything up to its cumulative seq,
+//   a NACK names frames to send again
+// - ReliableReceiver: drops duplicates, tolerates the reordering
+//   the send queue introduces (FLAG_PRIORITY jumps the queue), and owes one
+//   batched ACK per stream; holes that persist past NACK_DELAY_MS are NACKed,
+//   and given up after a few unanswered NACKs (the sender's buffer is bounded)
+// - wire format: MSG_ACK {"ack": {"<type>": seq}} (cumulative),
+//   MSG_NACK {"nack": {"<type>": [seq, ...]}}
+// ===============================================
+
+#include <QtCore>
+
+bool isReliableType(quint16 type);
+
+struct ReliableFrame {
+    quint16 type = 0;
+    quint32 seq = 0;
+    quint16 flags = 0;
+    QByteArray frame;   // full wire frame, possibly compressed
+};
+
+class ReliableSender {
+public:
+    struct Stats {
+        quint64 sent = 0;
+        quint64 acked = 0;
+        quint64 retransmitted = 0;
+        quint64 overflow = 0;   // evicted unacknowledged because the buffer was full
+    };
+
+    explicit ReliableSender(int maxFrames = 256, qint64 maxBytes = 1024 * 1024);
+
+    quint32 nextSeq(quint16 type);
+    void store(const ReliableFrame& f);
+
+    void onAck(const QJsonObject& json);
+    QVector<ReliableFrame> onNack(const QJsonObject& json); // frames to send again
+
+    // Everything still unacknowledged, oldest first (resend after a reconnect)
+    QVector<ReliableFrame> unacked() const { return frames_.toVector(); }
+    // New session on the receiving side: keep the frames but number them 1, 2, ...
+    // again per stream (their wire headers are rewritten)
+    void renumber();
+    void clear();
+
+    int size() const { return frames_.size(); }
+    const Stats& stats() const { return stats_; }
+
+private:
+    void evictOverflow();
+
+    int maxFrames_;
+    qint64 maxBytes_;
+    qint64 bytes_ = 0;
+    QList<ReliableFrame> frames_;       // send order
+    QHash<quint16, quint32> lastSeq_;   // stream -> last assigned seq
+    Stats stats_;
+};
+
+class ReliableReceiver {
+public:
+    struct Stats {
+        quint64 received = 0;
+        quint64 duplicates = 0;
+        quint64 nacked = 0;
+        quint64 skipped = 0;    // seqs given up on (evicted by the sender, or the window overflowed)
+    };
+
+    // Returns false for a duplicate the caller must drop
+    bool accept(quint16 type, quint32 seq, qint64 nowMs);
+
+    bool hasGaps() const;
+    QJsonObject takeAck(bool full = false); // empty when nothing new; full = every stream (session resume)
+    QJsonObject takeNack(qint64 nowMs);     // empty when no hole is due
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Stream {
+        quint32 next = 1;        // lowest seq not yet received
+        QSet<quint32> above;     // received out of order beyond next
+        quint32 acked = 0;       // cumulative seq last acknowledged
+        qint64 gapSinceMs = -1;
+        qint64 lastNackMs = -1;
+        int nackAttempts = 0;    // for the current oldest hole
+    };
+
+    void skipOldestHole(Stream& s);
+
+    QHash<quint16, Stream> streams_;
+    Stats stats_;
+};
@@ -0,0 +1,129 @@
+#include "sendqueue.h"
+
+SendQueue::SendQueue(qint64 socketBudget, qint64 queueBudget)
+    : socketBudget_(socketBudget), queueBudget_(queueBudget)
+{
+}
+
+SendClass SendQueue::classify(quint16 type, quint16 flags)
+{
+    if (flags & FLAG_PRIORITY) {
+        return CLASS_CONTROL;
+    }
+    switch (type) {
+        case MSG_CONTROL_CMD:
+        case MSG_HEARTBEAT:
+        case MSG_ACK:
+        case MSG_NACK:
+            return CLASS_CONTROL;
+        case MSG_AUDIO_FRAME:
+            return CLASS_AUDIO;
+        case MSG_VIDEO_FRAME:
+            return CLASS_VIDEO;
+        default:
+            return CLASS_TEXT;
+    }
+}
+
+bool SendQueue::isDroppable(quint16 type)
+{
+    return type == MSG_VIDEO_FRAME || type == MSG_AUDIO_FRAME;
+}
+
+void SendQueue::enqueue(quint16 type, const QByteArray& frame, quint16 flags)
+{
+    if (frame.isEmpty()) {
+        return;
+    }
+
+    Entry entry;
+    entry.type = type;
+    entry.frame = frame; // implicitly shared: relays queue the same buffer for every member
+    queues_[classify(type, flags)].append(entry);
+    stats_.queuedBytes += frame.size();
+    stats_.queuedFrames++;
+
+    if (stats_.queuedBytes > queueBudget_) {
+        enforceBudget();
+    }
+}
+
+qint64 SendQueue::pump(QIODevice* device, qint64 maxBytes)
+{
+    qint64 written = 0;
+    int cls = 0;
+    while (cls < CLASS_COUNT && canWrite(device)) {
+        if (queues_[cls].isEmpty()) {
+            ++cls;
+            continue;
+        }
+        if (maxBytes >= 0 && written > 0 && written >= maxBytes) {
+            break;
+        }
+
+        Entry entry = queues_[cls].takeFirst();
+        stats_.queuedBytes -= entry.frame.size();
+        stats_.queuedFrames--;
+
+        if (device->write(entry.frame) != entry.frame.size()) {
+            qCWarning(logNetwork) << "Short write on outbound frame, type=" << entry.type;
+        }
+        stats_.sentFrames++;
+        stats_.sentBytes += entry.frame.size();
+        written += entry.frame.size();
+    }
+    return written;
+}
+
+void SendQueue::clear()
+{
+    for (int cls = 0; cls < CLASS_COUNT; ++cls) {
+        queues_[cls].clear();
+    }
+    stats_.queuedBytes = 0;
+    stats_.queuedFrames = 0;
+}
+
+void SendQueue::enforceBudget()
+{
+    // Stale video goes first, then audio; everything else is kept even over budget
+    while (stats_.queuedBytes > queueBudget_ && dropOldest(CLASS_VIDEO, MSG_VIDEO_FRAME)) {}
+    while (stats_.queuedBytes > queueBudget_ && dropOldest(CLASS_AUDIO, MSG_AUDIO_FRAME)) {}
+}
+
+bool SendQueue::dropOldest(SendClass cls, quint16 type)
+{
+    // A FLAG_PRIORITY media frame lives in CLASS_CONTROL and is never dropped
+    QList<Entry>& queue = queues_[cls];
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        if (it->type != type) continue;
+
+        stats_.queuedBytes -= it->frame.size();
+        stats_.queuedFrames--;
+        stats_.droppedBytes += it->frame.size();
+        if (type == MSG_VIDEO_FRAME) stats_.droppedVideo++;
+        else stats_.droppedAudio++;
+
+        queue.erase(it);
+        return true;
+    }
+    return false;
+}
+
+QJsonObject SendQueue::statsJson() const
+{
+    QJsonArray perClass;
+    for (int cls = 0; cls < CLASS_COUNT; ++cls) {
+        perClass.append(queues_[cls].size());
+    }
+    return QJsonObject{
+        {"queuedBytes",  stats_.queuedBytes},
+        {"queuedFrames", stats_.queuedFrames},
+        {"queuedByClass", perClass},
+        {"sentFrames",   static_cast<qint64>(stats_.sentFrames)},
+        {"sentBytes",    static_cast<qint64>(stats_.sentBytes)},
+        {"droppedVideo", static_cast<qint64>(stats_.droppedVideo)},
+        {"droppedAudio", static_cast<qint64>(stats_.droppedAudio)},
+        {"droppedBytes", static_cast<qint64>(stats_.droppedBytes)}
+    };
+}
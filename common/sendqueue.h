@@ -0,0 +1,77 @@
+#pragma once
+// ===============================================
+// common/sendqueue.h
+// Per-connection outbound queue with a byte budget and strict priority classes
+// - Frames are handed to the socket only while its bytesToWrite() stays under
+//   socketBudget; the rest waits here and is pumped again on bytesWritten
+// - Dequeue order: control (MSG_CONTROL_CMD, protocol management or
+//   FLAG_PRIORITY) > audio > text/other > video, so a stop command never sits
+//   behind queued JPEG frames
+// - When queued bytes exceed queueBudget, the oldest MSG_VIDEO_FRAME entries are
+//   dropped first, then MSG_AUDIO_FRAME; text, control and every other type are
+//   never dropped
+// ===============================================
+
+#include <QtCore>
+#include "protocol.h"
+
+static const qint64 DEFAULT_SOCKET_BUDGET = 256 * 1024;      // bytes allowed inside QTcpSocket
+static const qint64 DEFAULT_QUEUE_BUDGET  = 4 * 1024 * 1024; // bytes allowed in our own queue
+
+// Egress priority classes, highest first
+enum SendClass {
+    CLASS_CONTROL = 0,
+    CLASS_AUDIO   = 1,
+    CLASS_TEXT    = 2,
+    CLASS_VIDEO   = 3,
+    CLASS_COUNT   = 4
+};
+
+class SendQueue {
+public:
+    struct Stats {
+        qint64 queuedBytes = 0;
+        int queuedFrames = 0;
+        quint64 sentFrames = 0;
+        quint64 sentBytes = 0;
+        quint64 droppedVideo = 0;
+        quint64 droppedAudio = 0;
+        quint64 droppedBytes = 0;
+    };
+
+    explicit SendQueue(qint64 socketBudget = DEFAULT_SOCKET_BUDGET,
+                       qint64 queueBudget = DEFAULT_QUEUE_BUDGET);
+
+    // Queue a complete frame; applies the drop policy if over budget
+    void enqueue(quint16 type, const QByteArray& frame, quint16 flags = FLAG_NONE);
+
+    // Move queued frames into the device, highest class first, while it is under
+    // socketBudget. maxBytes >= 0 stops once that many bytes were written (at
+    // least one frame is always written if the socket has room).
+    // Returns the number of bytes written.
+    qint64 pump(QIODevice* device, qint64 maxBytes = -1);
+
+    void clear();
+    bool isEmpty() const { return stats_.queuedFrames == 0; }
+    bool canWrite(const QIODevice* device) const { return device->bytesToWrite() < socketBudget_; }
+    qint64 queuedBytes() const { return stats_.queuedBytes; }
+    const Stats& stats() const { return stats_; }
+    QJsonObject statsJson() const;
+
+    static SendClass classify(quint16 type, quint16 flags = FLAG_NONE);
+    static bool isDroppable(quint16 type);
+
+private:
+    struct Entry {
+        quint16 type;
+        QByteArray frame;
+    };
+
+    QList<Entry> queues_[CLASS_COUNT];
+    Stats stats_;
+    qint64 socketBudget_;
+    qint64 queueBudget_;
+
+    void enforceBudget();
+    bool dropOldest(SendClass cls, quint16 type);
+};
@@ -0,0 +1,185 @@
+#include "tilecodec.h"
+#include "protocol.h"
+#include <QBuffer>
+
+// A tile counts as changed when its mean absolute difference exceeds ~3 levels
+// per colour channel; this absorbs sensor noise on a static scene
+static const int TILE_SAD_THRESHOLD = TILE_SIZE * TILE_SIZE * 3 * 3;
+
+// Above this share of changed tiles a full JPEG is smaller than bitmap + atlas
+static const double TILE_KEYFRAME_RATIO = 0.6;
+
+static bool encodeJpeg(const QImage& img, int quality, QByteArray* out)
+{
+    QBuffer buffer(out);
+    buffer.open(QIODevice::WriteOnly);
+    return img.save(&buffer, "JPEG", quality);
+}
+
+static void copyTile(const QImage& src, int sx, int sy, QImage& dst, int dx, int dy)
+{
+    const int w = qMin(TILE_SIZE, qMin(src.width() - sx, dst.width() - dx));
+    const int h = qMin(TILE_SIZE, qMin(src.height() - sy, dst.height() - dy));
+    for (int row = 0; row < h; ++row) {
+        const uchar* s = src.constScanLine(sy + row) + sx * 4;
+        uchar* d = dst.scanLine(dy + row) + dx * 4;
+        memcpy(d, s, size_t(w) * 4);
+    }
+}
+
+/* ---------- encoder ---------- */
+
+TileEncoder::TileEncoder(int keyframeInterval)
+    : keyframeInterval_(qMax(1, keyframeInterval))
+{
+}
+
+void TileEncoder::reset()
+{
+    reference_ = QImage();
+    sinceKeyframe_ = 0;
+    forceKeyframe_ = true;
+}
+
+bool TileEncoder::tileChanged(const QImage& img, int tx, int ty) const
+{
+    const int x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+    const int w = qMin(TILE_SIZE, img.width() - x0);
+    const int h = qMin(TILE_SIZE, img.height() - y0);
+    int sad = 0;
+    for (int row = 0; row < h; ++row) {
+        const uchar* a = img.constScanLine(y0 + row) + x0 * 4;
+        const uchar* b = reference_.constScanLine(y0 + row) + x0 * 4;
+        if (memcmp(a, b, size_t(w) * 4) == 0) continue;
+        for (int i = 0; i < w * 4; ++i) {
+            if ((i & 3) == 3) continue; // alpha
+            sad += qAbs(int(a[i]) - int(b[i]));
+        }
+        if (sad > TILE_SAD_THRESHOLD) return true;
+    }
+    return false;
+}
+
+bool TileEncoder::encodeKeyframe(const QImage& img, int jpegQuality, EncodedVideoFrame* out)
+{
+    QByteArray jpeg;
+    if (!encodeJpeg(img, jpegQuality, &jpeg)) return false;
+    reference_ = img;
+    sinceKeyframe_ = 0;
+    forceKeyframe_ = false;
+    out->payload = jpeg;
+    out->flags = FLAG_KEYFRAME;
+    out->meta = QJsonObject{{"codec", TILE_CODEC_NAME},
+                            {"fid", qint64(++frameId_)},
+                            {"w", img.width()},
+                            {"h", img.height()}};
+    return true;
+}
+
+bool TileEncoder::encode(const QImage& frame, int jpegQuality, EncodedVideoFrame* out)
+{
+    const QImage img = frame.convertToFormat(QImage::Format_RGB32);
+    if (img.isNull()) return false;
+    if (forceKeyframe_ || reference_.size() != img.size() || ++sinceKeyframe_ >= keyframeInterval_) {
+        return encodeKeyframe(img, jpegQuality, out);
+    }
+
+    const int tilesX = (img.width() + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (img.height() + TILE_SIZE - 1) / TILE_SIZE;
+    const int tileCount = tilesX * tilesY;
+    QByteArray bitmap((tileCount + 7) / 8, '\0');
+    QVector<int> changed;
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            if (tileChanged(img, tx, ty)) {
+                const int index = ty * tilesX + tx;
+                bitmap[index / 8] = char(uchar(bitmap[index / 8]) | (1u << (index % 8)));
+                changed.append(index);
+            }
+        }
+    }
+    if (changed.isEmpty()) return false;
+    if (changed.size() > tileCount * TILE_KEYFRAME_RATIO) {
+        return encodeKeyframe(img, jpegQuality, out);
+    }
+
+    // Tiles are 16x16 like the JPEG 4:2:0 MCU, so neighbouring atlas tiles never bleed
+    const int cols = qMin(changed.size(), TILE_ATLAS_MAX_COLS);
+    const int rows = (changed.size() + cols - 1) / cols;
+    QImage atlas(cols * TILE_SIZE, rows * TILE_SIZE, QImage::Format_RGB32);
+    atlas.fill(Qt::black);
+    for (int k = 0; k < changed.size(); ++k) {
+        const int tx = changed[k] % tilesX, ty = changed[k] / tilesX;
+        copyTile(img, tx * TILE_SIZE, ty * TILE_SIZE, atlas, (k % cols) * TILE_SIZE, (k / cols) * TILE_SIZE);
+    }
+    QByteArray jpeg;
+    if (!encodeJpeg(atlas, jpegQuality, &jpeg)) return false;
+
+    for (int index : changed) {
+        const int x = (index % tilesX) * TILE_SIZE, y = (index / tilesX) * TILE_SIZE;
+        copyTile(img, x, y, reference_, x, y);
+    }
+
+    const quint32 ref = frameId_;
+    out->payload = bitmap + jpeg;
+    out->flags = FLAG_DELTA_FRAME;
+    out->meta = QJsonObject{{"codec", TILE_CODEC_NAME},
+                            {"fid", qint64(++frameId_)},
+                            {"ref", qint64(ref)},
+                            {"w", img.width()},
+                            {"h", img.height()},
+                            {"tiles", changed.size()},
+                            {"cols", cols}};
+    return true;
+}
+
+/* ---------- decoder ---------- */
+
+void TileDecoder::reset()
+{
+    canvas_ = QImage();
+    lastFid_ = -1;
+}
+
+TileDecoder::Result TileDecoder::decode(quint16 flags, const QJsonObject& json, const QByteArray& payload)
+{
+    if (!(flags & FLAG_DELTA_FRAME)) {
+        // Keyframe or legacy full JPEG
+        QImage img;
+        if (!img.loadFromData(payload, "JPEG")) return Invalid;
+        canvas_ = img.convertToFormat(QImage::Format_RGB32);
+        lastFid_ = json.contains("fid") ? qint64(json.value("fid").toDouble()) : -1;
+        return Updated;
+    }
+
+    const QSize size(json.value("w").toInt(), json.value("h").toInt());
+    const qint64 ref = qint64(json.value("ref").toDouble(-1));
+    if (canvas_.isNull() || canvas_.size() != size || lastFid_ < 0 || ref != lastFid_) {
+        lastFid_ = -1; // stay stale until a keyframe arrives
+        return NeedKeyframe;
+    }
+
+    const int tilesX = (size.width() + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (size.height() + TILE_SIZE - 1) / TILE_SIZE;
+    const int bitmapSize = (tilesX * tilesY + 7) / 8;
+    const int tiles = json.value("tiles").toInt();
+    const int cols = json.value("cols").toInt();
+    if (payload.size() <= bitmapSize || tiles <= 0 || cols <= 0) return Invalid;
+
+    QImage atlas;
+    const uchar* bits = reinterpret_cast<const uchar*>(payload.constData());
+    if (!atlas.loadFromData(bits + bitmapSize, payload.size() - bitmapSize, "JPEG")) return Invalid;
+    atlas = atlas.convertToFormat(QImage::Format_RGB32);
+    const int rows = (tiles + cols - 1) / cols;
+    if (atlas.width() < cols * TILE_SIZE || atlas.height() < rows * TILE_SIZE) return Invalid;
+
+    int k = 0;
+    for (int index = 0; index < tilesX * tilesY && k < tiles; ++index) {
+        if (!(bits[index / 8] & (1u << (index % 8)))) continue;
+        copyTile(atlas, (k % cols) * TILE_SIZE, (k / cols) * TILE_SIZE,
+                 canvas_, (index % tilesX) * TILE_SIZE, (index / tilesX) * TILE_SIZE);
+        ++k;
+    }
+    lastFid_ = qint64(json.value("fid").toDouble());
+    return Updated;
+}
@@ -0,0 +1,68 @@
+#pragma once
+// ===============================================
+// common/tilecodec.h
+// Block-based delta mode for MSG_VIDEO_FRAME ("tile16")
+// - keyframe (FLAG_KEYFRAME): the whole frame as one JPEG, exactly like the
+//   legacy payload, so older receivers still show it
+// - delta (FLAG_DELTA_FRAME): only 16x16 tiles that changed since they were
+//   last sent. Binary section = tile bitmap (1 bit per tile, row-major, LSB
+//   first) followed by one JPEG "atlas" holding the changed tiles in bitmap
+//   order, `cols` tiles per atlas row
+// - JSON fields: codec, fid (frame id), ref (fid the delta applies to), w, h,
+//   and for deltas tiles / cols
+// - the encoder compares against the tile contents it last sent, so slow
+//   drifts accumulate until they cross the threshold instead of being lost
+// - a receiver that misses a frame (ref != last fid) drops deltas until the
+//   next keyframe and asks the sender for one
+// ===============================================
+
+#include <QtCore>
+#include <QImage>
+
+static const int TILE_SIZE = 16;
+static const int TILE_ATLAS_MAX_COLS = 40;           // 640 px wide atlas
+static const char TILE_CODEC_NAME[] = "tile16";
+
+struct EncodedVideoFrame {
+    QByteArray payload;
+    quint16 flags = 0;
+    QJsonObject meta;    // merged into the MSG_VIDEO_FRAME JSON
+};
+
+class TileEncoder {
+public:
+    // keyframeInterval: frames between forced keyframes
+    explicit TileEncoder(int keyframeInterval = 60);
+
+    // Returns false when nothing needs to be sent (no tile changed)
+    bool encode(const QImage& frame, int jpegQuality, EncodedVideoFrame* out);
+    void requestKeyframe() { forceKeyframe_ = true; }
+    void reset();
+
+private:
+    bool encodeKeyframe(const QImage& img, int jpegQuality, EncodedVideoFrame* out);
+    bool tileChanged(const QImage& img, int tx, int ty) const;
+
+    QImage reference_;          // RGB32: every tile as the receivers last got it
+    int keyframeInterval_;
+    int sinceKeyframe_ = 0;
+    quint32 frameId_ = 0;
+    bool forceKeyframe_ = true;
+};
+
+class TileDecoder {
+public:
+    enum Result {
+        Updated,        // canvas() holds the new picture
+        NeedKeyframe,   // delta without a matching reference; ask the sender
+        Invalid         // undecodable payload
+    };
+
+    Result decode(quint16 flags, const QJsonObject& json, const QByteArray& payload);
+    const QImage& canvas() const { return canvas_; }
+    void reset();
+
+private:
+    QImage canvas_;
+    qint64 lastFid_ = -1;
+};
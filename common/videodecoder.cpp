@@ -0,0 +1,167 @@
+#include "videodecoder.h"
+#include <QBuffer>
+#include <QImageReader>
+
+// Deltas waiting behind a slow decoder; past this a keyframe is cheaper than catching up
+static const int MAX_PENDING_DELTAS = 8;
+
+RemoteVideoDecoder::RemoteVideoDecoder(QObject* parent)
+    : QObject(parent)
+{
+    thread_ = QThread::create([this]() { run(); });
+    thread_->setObjectName("video-decode");
+    thread_->start();
+}
+
+RemoteVideoDecoder::~RemoteVideoDecoder()
+{
+    {
+        QMutexLocker lock(&mutex_);
+        stopping_ = true;
+        cond_.wakeAll();
+    }
+    thread_->wait();
+    delete thread_;
+}
+
+void RemoteVideoDecoder::submit(const QString& sender, const Packet& packet)
+{
+    bool requestKeyframe = false;
+    {
+        QMutexLocker lock(&mutex_);
+        stats_.submitted++;
+        QList<Packet>& queue = pending_[sender];
+        if (!(packet.flags & FLAG_DELTA_FRAME)) {
+            // Self-contained frame: anything older for this sender is stale
+            stats_.discarded += queue.size();
+            queue.clear();
+        } else if (queue.size() >= MAX_PENDING_DELTAS) {
+            // The chain is broken once deltas are dropped; the worker will
+            // answer NeedKeyframe on the next one
+            stats_.discarded += queue.size();
+            queue.clear();
+            requestKeyframe = true;
+        }
+        queue.append(packet);
+        if (!ready_.contains(sender)) ready_.append(sender);
+        cond_.wakeOne();
+    }
+    if (requestKeyframe) emit keyframeNeeded(sender);
+}
+
+void RemoteVideoDecoder::setDisplaySize(const QSize& size)
+{
+    QMutexLocker lock(&mutex_);
+    displaySize_ = size;
+}
+
+void RemoteVideoDecoder::reset()
+{
+    QMutexLocker lock(&mutex_);
+    for (const QList<Packet>& queue : qAsConst(pending_)) stats_.discarded += queue.size();
+    pending_.clear();
+    ready_.clear();
+    results_.clear();
+    resetPending_ = true;
+    cond_.wakeOne();
+}
+
+RemoteVideoDecoder::Stats RemoteVideoDecoder::stats() const
+{
+    QMutexLocker lock(&mutex_);
+    return stats_;
+}
+
+void RemoteVideoDecoder::run()
+{
+    for (;;) {
+        QString sender;
+        QList<Packet> jobs;
+        QSize displaySize;
+        {
+            QMutexLocker lock(&mutex_);
+            while (ready_.isEmpty() && !stopping_ && !resetPending_) cond_.wait(&mutex_);
+            if (stopping_) return;
+            if (resetPending_) {
+                decoders_.clear();
+                resetPending_ = false;
+            }
+            if (ready_.isEmpty()) continue;
+            sender = ready_.takeFirst();
+            jobs = pending_.take(sender);
+            displaySize = displaySize_;
+        }
+        decodeJobs(sender, jobs, displaySize);
+    }
+}
+
+void RemoteVideoDecoder::decodeJobs(const QString& sender, const QList<Packet>& jobs, const QSize& displaySize)
+{
+    TileDecoder& decoder = decoders_[sender];
+    bool canvasUpdated = false;
+    for (const Packet& p : jobs) {
+        const QJsonObject json = p.json();
+        const bool tileStream = json.value("codec").toString() == QLatin1String(TILE_CODEC_NAME);
+        if (!tileStream) {
+            // Legacy full JPEG: no reference to keep, decode at display size
+            decoder.reset();
+            canvasUpdated = false;
+            const QImage img = decodeScaled(p.bin(), displaySize);
+            if (!img.isNull()) {
+                publish(sender, img);
+            }
+            continue;
+        }
+        switch (decoder.decode(p.flags, json, p.bin())) {
+        case TileDecoder::Updated:
+            canvasUpdated = true;
+            break;
+        case TileDecoder::NeedKeyframe:
+            QMetaObject::invokeMethod(this, [this, sender]() { emit keyframeNeeded(sender); },
+                                      Qt::QueuedConnection);
+            break;
+        case TileDecoder::Invalid:
+            break;
+        }
+    }
+    if (canvasUpdated) {
+        const QImage& canvas = decoder.canvas();
+        publish(sender, displaySize.isValid() ? canvas.scaled(displaySize, Qt::KeepAspectRatio) : canvas);
+    }
+}
+
+QImage RemoteVideoDecoder::decodeScaled(const QByteArray& jpeg, const QSize& displaySize)
+{
+    QBuffer buffer;
+    buffer.setData(jpeg);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer, "JPEG");
+    const QSize full = reader.size();
+    if (full.isValid() && displaySize.isValid() &&
+        (full.width() > displaySize.width() || full.height() > displaySize.height())) {
+        reader.setScaledSize(full.scaled(displaySize, Qt::KeepAspectRatio));
+    }
+    return reader.read();
+}
+
+void RemoteVideoDecoder::publish(const QString& sender, const QImage& image)
+{
+    {
+        QMutexLocker lock(&mutex_);
+        stats_.decoded++;
+        results_[sender] = image;   // replaces a result the GUI has not picked up yet
+        if (publishScheduled_) return;
+        publishScheduled_ = true;
+    }
+    QMetaObject::invokeMethod(this, [this]() {
+        QHash<QString, QImage> results;
+        {
+            QMutexLocker lock(&mutex_);
+            results.swap(results_);
+            publishScheduled_ = false;
+        }
+        for (auto it = results.constBegin(); it != results.constEnd(); ++it) {
+            emit frameDecoded(it.key(), it.value());
+        }
+    }, Qt::QueuedConnection);
+}
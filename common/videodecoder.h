@@ -0,0 +1,61 @@
+#pragma once
+// ===============================================
+// common/videodecoder.h
+// Receiver-side decode worker for remote MSG_VIDEO_FRAME streams
+// - submit() on the GUI thread only queues the packet; decoding, tile
+//   compositing and scaling to the display size run on one worker thread
+// - per sender only the newest frame is kept: a keyframe or legacy JPEG
+//   discards everything still pending for that sender, undecoded.
+//   tile16 deltas since the last keyframe must all be applied, so they queue
+//   up to a small bound, and past it they are dropped and a keyframe is requested
+// - legacy full-JPEG streams are decoded straight to the display size
+//   (QImageReader::setScaledSize lets libjpeg skip DCT work)
+// - the GUI thread gets at most one pending result per sender
+// ===============================================
+
+#include <QtCore>
+#include <QImage>
+#include "protocol.h"
+#include "tilecodec.h"
+
+class RemoteVideoDecoder : public QObject {
+    Q_OBJECT
+public:
+    struct Stats {
+        quint64 submitted = 0;
+        quint64 decoded = 0;
+        quint64 discarded = 0;   // superseded before the worker got to them
+    };
+
+    explicit RemoteVideoDecoder(QObject* parent = nullptr);
+    ~RemoteVideoDecoder() override;
+
+    void submit(const QString& sender, const Packet& packet);
+    void setDisplaySize(const QSize& size);
+    void reset();           // drop pending frames and every sender's canvas (disconnect / leave)
+    Stats stats() const;
+
+signals:
+    void frameDecoded(const QString& sender, const QImage& image);  // already at display size
+    void keyframeNeeded(const QString& sender);
+
+private:
+    void run();
+    void decodeJobs(const QString& sender, const QList<Packet>& jobs, const QSize& displaySize);
+    void publish(const QString& sender, const QImage& image);
+    static QImage decodeScaled(const QByteArray& jpeg, const QSize& displaySize);
+
+    mutable QMutex mutex_;
+    QWaitCondition cond_;
+    QHash<QString, QList<Packet>> pending_;
+    QList<QString> ready_;          // senders with pending work, oldest first
+    QHash<QString, QImage> results_;
+    bool publishScheduled_ = false;
+    bool resetPending_ = false;
+    bool stopping_ = false;
+    QSize displaySize_;
+    Stats stats_;
+
+    QHash<QString, TileDecoder> decoders_;   // worker thread only
+    QThread* thread_ = nullptr;
+};
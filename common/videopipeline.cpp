@@ -0,0 +1,310 @@
+#include "videopipeline.h"
+#include "colorconvert.h"
+#include <QBuffer>
+
+static const int CONVERT_QUEUE_DEPTH = 2;  // camera -> convert
+static const int ENCODE_QUEUE_DEPTH = 1;   // convert -> encode: always encode the newest frame
+static const int SEND_MAX_IN_FLIGHT = 2;   // encode -> owner thread
+
+// Camera YUV formats handled by colorconvert (YV12 is I420 with U/V swapped)
+static bool yuvFormatFor(QVideoFrame::PixelFormat pf, YuvFormat* out)
+{
+    switch (pf) {
+    case QVideoFrame::Format_YUYV:    *out = YuvFormat::YUYV; return true;
+    case QVideoFrame::Format_UYVY:    *out = YuvFormat::UYVY; return true;
+    case QVideoFrame::Format_NV12:    *out = YuvFormat::NV12; return true;
+    case QVideoFrame::Format_YUV420P:
+    case QVideoFrame::Format_YV12:    *out = YuvFormat::I420; return true;
+    default:                          return false;
+    }
+}
+
+VideoPipeline::VideoPipeline(QObject* parent)
+    : QObject(parent)
+    , convertQueue_(CONVERT_QUEUE_DEPTH)
+    , encodeQueue_(ENCODE_QUEUE_DEPTH)
+    , encodingEnabled_(1)
+    , deltaEnabled_(1)
+{
+}
+
+VideoPipeline::~VideoPipeline()
+{
+    stop();
+}
+
+void VideoPipeline::start()
+{
+    if (convertThread_) return;
+    convertQueue_.reopen();
+    encodeQueue_.reopen();
+    lastPixelFormat_ = -1;
+    nextEncodeMs_ = 0;
+    for (TileEncoder& encoder : tileEncoders_) encoder.reset();
+    convertThread_ = QThread::create([this]() { convertLoop(); });
+    encodeThread_ = QThread::create([this]() { encodeLoop(); });
+    convertThread_->setObjectName("video-convert");
+    encodeThread_->setObjectName("video-encode");
+    convertThread_->start();
+    encodeThread_->start();
+}
+
+void VideoPipeline::stop()
+{
+    if (!convertThread_) return;
+    convertQueue_.close();
+    encodeQueue_.close();
+    convertThread_->wait();
+    encodeThread_->wait();
+    delete convertThread_;
+    delete encodeThread_;
+    convertThread_ = nullptr;
+    encodeThread_ = nullptr;
+}
+
+void VideoPipeline::push(const QVideoFrame& frame)
+{
+    if (!convertThread_ || !frame.isValid()) return;
+    captured_.fetchAndAddRelaxed(1);
+    {
+        QMutexLocker lock(&settingsMutex_);
+        frameSize_ = frame.size();
+    }
+    CapturedFrame item;
+    item.frame = frame; // implicitly shared, no pixel copy on the capture thread
+    item.captureMs = QDateTime::currentMSecsSinceEpoch();
+    convertQueue_.push(item);
+}
+
+void VideoPipeline::setPreviewSize(const QSize& size)
+{
+    QMutexLocker lock(&settingsMutex_);
+    previewSize_ = size;
+}
+
+void VideoPipeline::setJpegQuality(int quality)
+{
+    QMutexLocker lock(&settingsMutex_);
+    jpegQuality_ = qBound(1, quality, 100);
+}
+
+void VideoPipeline::setEncodeScale(double scale)
+{
+    QMutexLocker lock(&settingsMutex_);
+    encodeScale_ = qBound(0.1, scale, 1.0);
+}
+
+void VideoPipeline::setMaxFps(int fps)
+{
+    QMutexLocker lock(&settingsMutex_);
+    maxFps_ = qMax(0, fps);
+}
+
+void VideoPipeline::setSimulcastLayers(int layers)
+{
+    QMutexLocker lock(&settingsMutex_);
+    simulcastLayers_ = qBound(1, layers, int(SIMULCAST_MAX_LAYERS));
+}
+
+QSize VideoPipeline::frameSize() const
+{
+    QMutexLocker lock(&settingsMutex_);
+    return frameSize_;
+}
+
+void VideoPipeline::setEncodingEnabled(bool enabled)
+{
+    encodingEnabled_.storeRelease(enabled ? 1 : 0);
+}
+
+void VideoPipeline::setDeltaEnabled(bool enabled)
+{
+    deltaEnabled_.storeRelease(enabled ? 1 : 0);
+}
+
+void VideoPipeline::requestKeyframe()
+{
+    keyframeRequested_.storeRelease(1);
+}
+
+VideoPipeline::Stats VideoPipeline::stats() const
+{
+    Stats s;
+    s.captured = captured_.loadAcquire();
+    s.converted = converted_.loadAcquire();
+    s.encoded = encoded_.loadAcquire();
+    s.droppedConvert = convertQueue_.dropped();
+    s.droppedEncode = encodeQueue_.dropped();
+    s.droppedSend = droppedSend_.loadAcquire();
+    s.throttled = throttled_.loadAcquire();
+    return s;
+}
+
+// Maps the frame and returns an image that owns its pixels (valid after unmap)
+QImage VideoPipeline::toImage(QVideoFrame& frame)
+{
+    if (!frame.map(QAbstractVideoBuffer::ReadOnly)) return QImage();
+
+    QImage img;
+    YuvFormat yuvFormat;
+    const QVideoFrame::PixelFormat pf = frame.pixelFormat();
+    const int w = frame.width(), h = frame.height();
+    switch (pf) {
+    case QVideoFrame::Format_ARGB32:
+    case QVideoFrame::Format_ARGB32_Premultiplied:
+        img = QImage(frame.bits(), w, h, frame.bytesPerLine(), QImage::Format_ARGB32).copy();
+        break;
+    case QVideoFrame::Format_RGB32:
+        img = QImage(frame.bits(), w, h, frame.bytesPerLine(), QImage::Format_RGB32).copy();
+        break;
+    case QVideoFrame::Format_BGR32:
+        img = QImage(frame.bits(), w, h, frame.bytesPerLine(), QImage::Format_RGB32).rgbSwapped();
+        break;
+    case QVideoFrame::Format_RGB24:
+        img = QImage(frame.bits(), w, h, frame.bytesPerLine(), QImage::Format_RGB888).copy();
+        break;
+    case QVideoFrame::Format_BGR24:
+        img = QImage(frame.bits(), w, h, frame.bytesPerLine(), QImage::Format_RGB888).rgbSwapped();
+        break;
+    default:
+        if (yuvFormatFor(pf, &yuvFormat)) {
+            YuvPlanes planes;
+            for (int i = 0; i < qMin(frame.planeCount(), 3); ++i) {
+                planes.data[i] = frame.bits(i);
+                planes.stride[i] = frame.bytesPerLine(i);
+            }
+            if (pf == QVideoFrame::Format_YV12) {
+                qSwap(planes.data[1], planes.data[2]);
+                qSwap(planes.stride[1], planes.stride[2]);
+            }
+            img = QImage(w, h, QImage::Format_RGB32);
+            if (!convertYuvToRgb32(yuvFormat, planes, w, h, img.bits(), img.bytesPerLine())) {
+                img = QImage();
+            }
+        }
+        break;
+    }
+    frame.unmap();
+    return img;
+}
+
+void VideoPipeline::convertLoop()
+{
+    CapturedFrame in;
+    while (convertQueue_.pop(&in)) {
+        const int pf = in.frame.pixelFormat();
+        QImage img = toImage(in.frame);
+        in.frame = QVideoFrame(); // release the camera buffer as early as possible
+        if (pf != lastPixelFormat_) {
+            lastPixelFormat_ = pf;
+            emit formatChanged(pf, !img.isNull());
+        }
+        if (img.isNull()) continue;
+        converted_.fetchAndAddRelaxed(1);
+
+        int maxFps;
+        {
+            QMutexLocker lock(&settingsMutex_);
+            maxFps = maxFps_;
+        }
+        // fps cap: a quarter-interval tolerance keeps a 30 fps camera at 30 fps
+        // despite capture jitter; the preview always runs at camera rate
+        bool due = true;
+        if (maxFps > 0) {
+            const qint64 interval = 1000 / maxFps;
+            due = in.captureMs + interval / 4 >= nextEncodeMs_;
+            if (due) nextEncodeMs_ = qMax(nextEncodeMs_, in.captureMs - interval) + interval;
+            else throttled_.fetchAndAddRelaxed(1);
+        }
+
+        if (due && encodingEnabled_.loadAcquire()) {
+            ConvertedFrame out;
+            out.image = img;
+            out.captureMs = in.captureMs;
+            encodeQueue_.push(out);
+        }
+
+        // Preview: skip while the GUI still has one queued, so a busy GUI
+        // thread never accumulates stale images
+        if (previewInFlight_.testAndSetAcquire(0, 1)) {
+            QSize size;
+            {
+                QMutexLocker lock(&settingsMutex_);
+                size = previewSize_;
+            }
+            QImage preview = size.isValid() ? img.scaled(size, Qt::KeepAspectRatio) : img;
+            QMetaObject::invokeMethod(this, [this, preview]() {
+                previewInFlight_.storeRelease(0);
+                emit previewReady(preview);
+            }, Qt::QueuedConnection);
+        }
+    }
+}
+
+bool VideoPipeline::encodeLayer(TileEncoder& encoder, const QImage& image, int quality, EncodedVideoFrame* out)
+{
+    if (deltaEnabled_.loadAcquire()) {
+        return encoder.encode(image, quality, out); // false: error, or no tile changed
+    }
+    QBuffer buffer(&out->payload);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "JPEG", quality)) return false;
+    encoder.reset(); // delta mode restarts from a keyframe
+    return true;
+}
+
+void VideoPipeline::encodeLoop()
+{
+    ConvertedFrame in;
+    while (encodeQueue_.pop(&in)) {
+        if (!encodingEnabled_.loadAcquire()) continue;
+        int quality;
+        double scale;
+        int layers;
+        {
+            QMutexLocker lock(&settingsMutex_);
+            quality = jpegQuality_;
+            scale = encodeScale_;
+            layers = simulcastLayers_;
+        }
+        if (keyframeRequested_.fetchAndStoreAcquire(0)) {
+            for (TileEncoder& encoder : tileEncoders_) encoder.requestKeyframe();
+        }
+
+        // Top layer at the adaptive settings; each lower layer halves the
+        // previous one, so the cascade never rescales the full camera frame twice
+        QImage image = (scale < 0.99)
+            ? in.image.scaled(in.image.size() * scale, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+            : in.image;
+        QVector<EncodedLayer> bundle;
+        for (int i = 0; i < layers; ++i) {
+            if (i > 0) {
+                const QSize half = (image.size() / 2).expandedTo(QSize(TILE_SIZE, TILE_SIZE));
+                image = image.scaled(half, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+            EncodedLayer out;
+            out.layer = layers > 1 ? quint16(layers - i) : 0;
+            if (!encodeLayer(tileEncoders_[i], image, quality, &out.frame)) continue;
+            bundle.append(out);
+        }
+        if (bundle.isEmpty()) continue;
+        encoded_.fetchAndAddRelaxed(1);
+
+        // One capture = one bundle in flight, whatever the layer count
+        if (sendInFlight_.fetchAndAddAcquire(1) >= SEND_MAX_IN_FLIGHT) {
+            sendInFlight_.fetchAndAddRelease(-1);
+            droppedSend_.fetchAndAddRelaxed(1);
+            for (TileEncoder& encoder : tileEncoders_) encoder.requestKeyframe(); // receivers never see this frame
+            continue;
+        }
+        const qint64 captureMs = in.captureMs;
+        QMetaObject::invokeMethod(this, [this, bundle, captureMs]() {
+            sendInFlight_.fetchAndAddRelease(-1);
+            // Lowest layer first: it is the one slow subscribers are waiting on
+            for (int i = bundle.size() - 1; i >= 0; --i) {
+                const EncodedLayer& out = bundle.at(i);
+                emit frameEncoded(out.frame.payload, out.frame.flags, out.frame.meta, captureMs, out.layer);
+            }
+        }, Qt::QueuedConnection);
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+// ===============================================
+// common/videopipeline.h
+// Camera capture pipeline: capture -> convert -> encode -> send
+// - capture: push() on the GUI thread only hands the QVideoFrame over
+// - convert: worker maps the frame, YUV/RGB -> QImage, scales the preview
+// - encode:  worker scales and encodes at the current quality / fps cap, either
+//            as full JPEGs or in the tile16 delta mode (tilecodec.h).
+//            With simulcast on, each frame is also encoded at 1/2 and 1/4 of that
+//            resolution, one independent encoder per layer; the server picks one
+//            layer per subscriber (server/src/simulcast.h)
+// - send:    frameEncoded() is delivered to the owner's thread, where
+//            ClientConn queues it (its SendQueue drops stale video on backlog)
+// Stages are joined by bounded queues that drop the oldest frame when the
+// next stage falls behind; the GUI thread receives at most one pending preview.
+// ===============================================
+
+#include <QtCore>
+#include <QImage>
+#include <QVideoFrame>
+#include "protocol.h"
+#include "tilecodec.h"
+
+// Bounded FIFO that never blocks the producer: a push into a full queue
+// discards the oldest item. pop() blocks until an item arrives or close().
+template <typename T>
+class DropOldestQueue {
+public:
+    explicit DropOldestQueue(int capacity) : capacity_(qMax(1, capacity)) {}
+
+    // Returns false when an older item had to be dropped to make room
+    bool push(const T& item) {
+        QMutexLocker lock(&mutex_);
+        bool kept = true;
+        while (items_.size() >= capacity_) {
+            items_.dequeue();
+            dropped_++;
+            kept = false;
+        }
+        items_.enqueue(item);
+        cond_.wakeOne();
+        return kept;
+    }
+
+    bool pop(T* out) {
+        QMutexLocker lock(&mutex_);
+        while (items_.isEmpty() && !closed_) cond_.wait(&mutex_);
+        if (items_.isEmpty()) return false; // closed and drained
+        *out = items_.dequeue();
+        return true;
+    }
+
+    void close() {
+        QMutexLocker lock(&mutex_);
+        closed_ = true;
+        items_.clear();
+        cond_.wakeAll();
+    }
+
+    void reopen() {
+        QMutexLocker lock(&mutex_);
+        closed_ = false;
+    }
+
+    quint64 dropped() const {
+        QMutexLocker lock(&mutex_);
+        return dropped_;
+    }
+
+private:
+    mutable QMutex mutex_;
+    QWaitCondition cond_;
+    QQueue<T> items_;
+    int capacity_;
+    quint64 dropped_ = 0;
+    bool closed_ = false;
+};
+
+class VideoPipeline : public QObject {
+    Q_OBJECT
+public:
+    struct Stats {
+        quint64 captured = 0;
+        quint64 converted = 0;
+        quint64 encoded = 0;
+        quint64 droppedConvert = 0; // capture outran conversion
+        quint64 droppedEncode = 0;  // conversion outran the JPEG encoder
+        quint64 droppedSend = 0;    // owner thread had not taken the previous frames yet
+        quint64 throttled = 0;      // skipped by the fps cap
+    };
+
+    explicit VideoPipeline(QObject* parent = nullptr);
+    ~VideoPipeline() override;
+
+    void start();
+    void stop();    // joins the worker threads; queued frames are discarded
+
+    // Capture stage (owner thread). Never blocks.
+    void push(const QVideoFrame& frame);
+
+    void setPreviewSize(const QSize& size);   // preview is scaled on the worker
+    void setJpegQuality(int quality);
+    void setEncodeScale(double scale);        // encode resolution relative to the camera frame
+    void setMaxFps(int fps);                  // encoded frame rate cap (0 = every frame)
+    void setEncodingEnabled(bool enabled);    // skip JPEG work while nothing is sent
+    void setDeltaEnabled(bool enabled);       // tile16 keyframe + delta mode (default on)
+    void setSimulcastLayers(int layers);      // 1 = single stream (default), up to SIMULCAST_MAX_LAYERS
+    void requestKeyframe();                   // next encoded frame is a full keyframe, on every layer
+
+    Stats stats() const;
+    QSize frameSize() const;                  // size of the last captured camera frame
+
+signals:
+    void previewReady(const QImage& image);                  // owner thread, at most one in flight
+    // owner thread; flags/layer/meta go into the MSG_VIDEO_FRAME header and JSON.
+    // layer is 0 for a single stream, else 1 (lowest) .. simulcastLayers
+    void frameEncoded(const QByteArray& payload, quint16 flags, const QJsonObject& meta,
+                      qint64 captureMs, quint16 layer);
+    void formatChanged(int pixelFormat, bool supported);     // once per camera format change
+
+private:
+    struct CapturedFrame {
+        QVideoFrame frame;
+        qint64 captureMs = 0;
+    };
+    struct ConvertedFrame {
+        QImage image;
+        qint64 captureMs = 0;
+    };
+    struct EncodedLayer {
+        EncodedVideoFrame frame;
+        quint16 layer = 0;
+    };
+
+    void convertLoop();
+    void encodeLoop();
+    bool encodeLayer(TileEncoder& encoder, const QImage& image, int quality, EncodedVideoFrame* out);
+    static QImage toImage(QVideoFrame& frame);
+
+    DropOldestQueue<CapturedFrame> convertQueue_;
+    DropOldestQueue<ConvertedFrame> encodeQueue_;
+    QThread* convertThread_ = nullptr;
+    QThread* encodeThread_ = nullptr;
+
+    mutable QMutex settingsMutex_;
+    QSize previewSize_;
+    int jpegQuality_ = 60;
+    double encodeScale_ = 1.0;
+    int maxFps_ = 0;
+    int simulcastLayers_ = 1;
+    QSize frameSize_;
+    QAtomicInt encodingEnabled_;
+    QAtomicInt deltaEnabled_;
+    QAtomicInt keyframeRequested_;
+    TileEncoder tileEncoders_[SIMULCAST_MAX_LAYERS];  // encode thread only; [0] = top layer
+    QAtomicInt previewInFlight_;
+    QAtomicInt sendInFlight_;
+    int lastPixelFormat_ = -1;  // convert thread only
+    qint64 nextEncodeMs_ = 0;   // convert thread only
+
+    QAtomicInteger<quint64> captured_;
+    QAtomicInteger<quint64> converted_;
+    QAtomicInteger<quint64> encoded_;
+    QAtomicInteger<quint64> droppedSend_;
+    QAtomicInteger<quint64> throttled_;
+};
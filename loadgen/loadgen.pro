@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = loadgen
+QT += core network
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+SOURCES += src/main.cpp \
+           src/simclient.cpp \
+           src/latencystats.cpp \
+           ../client-factory/src/clientconn.cpp
+HEADERS += src/simclient.h \
+           src/latencystats.h \
+           ../client-factory/src/clientconn.h
+include(../common/common.pri)
@@ -0,0 +1,77 @@
+#include "latencystats.h"
+#include "protocol.h"
+
+LatencyHistogram::LatencyHistogram() : buckets_(FINE_BUCKETS + COARSE_BUCKETS + 1, 0) {
+}
+
+int LatencyHistogram::bucketFor(qint64 ms) {
+    if (ms < 0) ms = 0; // 时钟抖动：按 0 计
+    if (ms < FINE_BUCKETS) return static_cast<int>(ms);
+    const qint64 coarse = (ms - FINE_BUCKETS) / 100;
+    return FINE_BUCKETS + static_cast<int>(qMin<qint64>(coarse, COARSE_BUCKETS));
+}
+
+qint64 LatencyHistogram::bucketUpperMs(int bucket) {
+    if (bucket < FINE_BUCKETS) return bucket;
+    return FINE_BUCKETS + static_cast<qint64>(bucket - FINE_BUCKETS + 1) * 100;
+}
+
+void LatencyHistogram::record(qint64 latencyMs) {
+    buckets_[bucketFor(latencyMs)]++;
+    count_++;
+    max_ = qMax(max_, latencyMs);
+}
+
+qint64 LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) return 0;
+    const quint64 rank = qMax<quint64>(1, static_cast<quint64>(p * count_ + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < buckets_.size(); ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) return qMin(bucketUpperMs(i), max_);
+    }
+    return max_;
+}
+
+void LatencyHistogram::reset() {
+    buckets_.fill(0);
+    count_ = 0;
+    max_ = 0;
+}
+
+void LatencyStats::record(const QString& roomId, quint16 type, qint64 latencyMs, int bytes) {
+    Series& s = rooms_[roomId][type];
+    s.hist.record(latencyMs);
+    s.frames++;
+    s.bytes += bytes;
+}
+
+static const char* typeName(quint16 type) {
+    switch (type) {
+        case MSG_VIDEO_FRAME: return "video";
+        case MSG_AUDIO_FRAME: return "audio";
+        case MSG_DEVICE_DATA: return "device";
+        case MSG_TEXT:        return "text";
+        case MSG_CONTROL_CMD: return "control";
+        default:              return "other";
+    }
+}
+
+void LatencyStats::report(qint64 elapsedMs) const {
+    const double secs = qMax<qint64>(1, elapsedMs) / 1000.0;
+    for (auto room = rooms_.constBegin(); room != rooms_.constEnd(); ++room) {
+        for (auto it = room.value().constBegin(); it != room.value().constEnd(); ++it) {
+            const Series& s = it.value();
+            qInfo().noquote() << QString("room %1 %2: %3 frames/s %4 MB/s  p50 %5ms p99 %6ms p999 %7ms max %8ms (n=%9)")
+                                 .arg(room.key(), -8)
+                                 .arg(QString::fromLatin1(typeName(it.key())), -7)
+                                 .arg(s.frames / secs, 0, 'f', 1)
+                                 .arg(s.bytes / secs / 1e6, 0, 'f', 2)
+                                 .arg(s.hist.percentile(0.50))
+                                 .arg(s.hist.percentile(0.99))
+                                 .arg(s.hist.percentile(0.999))
+                                 .arg(s.hist.maxMs())
+                                 .arg(s.hist.count());
+        }
+    }
+}
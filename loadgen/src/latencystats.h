@@ -0,0 +1,42 @@
+#pragma once
+// ===============================================
+// loadgen/src/latencystats.h
+// 端到端延迟直方图 + 吞吐计数（按房间、按媒体类型汇总）
+// 延迟 = 接收时刻 - 帧头 timestampMs（服务器转发保留原时间戳；本机时钟一致）
+// ===============================================
+#include <QtCore>
+
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+    void record(qint64 latencyMs);
+    qint64 percentile(double p) const; // p ∈ [0,1]，返回毫秒（桶上界）
+    quint64 count() const { return count_; }
+    qint64 maxMs() const { return max_; }
+    void reset();
+
+private:
+    // 0..999ms 每 1ms 一桶，1s..60s 每 100ms 一桶，之后全进最后一桶
+    static const int FINE_BUCKETS = 1000;
+    static const int COARSE_BUCKETS = 590;
+    QVector<quint64> buckets_;
+    quint64 count_ = 0;
+    qint64 max_ = 0;
+
+    static int bucketFor(qint64 ms);
+    static qint64 bucketUpperMs(int bucket);
+};
+
+class LatencyStats {
+public:
+    void record(const QString& roomId, quint16 type, qint64 latencyMs, int bytes);
+    void report(qint64 elapsedMs) const; // 打印每个房间每种类型的 p50/p99/p999 与吞吐
+
+private:
+    struct Series {
+        LatencyHistogram hist;
+        quint64 frames = 0;
+        quint64 bytes = 0;
+    };
+    QMap<QString, QMap<quint16, Series>> rooms_; // 有序，报告稳定
+};
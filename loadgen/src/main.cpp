@@ -0,0 +1,113 @@
+// ===============================================
+// loadgen/src/main.cpp
+// 无界面压测工具：单进程模拟 N 个工厂/专家客户端（仅连接本机服务器）
+// 用法：./loadgen -n 200 --rooms 20 --publishers 2 --fps 15 --duration 60
+// ===============================================
+#include <QtCore>
+#include "simclient.h"
+#include "latencystats.h"
+
+// 合成视频帧：JPEG SOI/EOI 包裹的伪随机数据（接收端不解码，只统计延迟）
+static QByteArray syntheticJpeg(int size) {
+    QByteArray blob(qMax(4, size), '\0');
+    quint32 x = 0x12345678u;
+    for (int i = 0; i < blob.size(); ++i) {
+        x = x * 1664525u + 1013904223u;
+        blob[i] = static_cast<char>(x >> 24);
+    }
+    blob[0] = char(0xFF); blob[1] = char(0xD8);
+    blob[blob.size() - 2] = char(0xFF); blob[blob.size() - 1] = char(0xD9);
+    return blob;
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser; parser.addHelpOption();
+    QCommandLineOption portOpt(QStringList() << "p" << "port", "Server port on 127.0.0.1", "port", "9000");
+    QCommandLineOption clientsOpt(QStringList() << "n" << "clients", "Simulated clients", "n", "100");
+    QCommandLineOption roomsOpt("rooms", "Work order rooms (clients are spread round-robin)", "n", "10");
+    QCommandLineOption publishersOpt("publishers", "Video publishers per room", "n", "1");
+    QCommandLineOption fpsOpt("fps", "Video frames per second per publisher", "fps", "15");
+    QCommandLineOption jpegOpt("jpeg", "JPEG file used as the video payload", "file");
+    QCommandLineOption videoSizeOpt("video-size", "Synthetic video frame size in bytes", "bytes", "30000");
+    QCommandLineOption audioOpt("audio-ms", "Audio frame interval (0 = off)", "ms", "20");
+    QCommandLineOption deviceOpt("device-ms", "Device data interval (0 = off)", "ms", "100");
+    QCommandLineOption deviceSamplesOpt("device-samples", "Device samples per frame (binary batch)", "n", "100");
+    QCommandLineOption durationOpt("duration", "Run time in seconds (0 = until Ctrl+C)", "s", "60");
+    QCommandLineOption reportOpt("report", "Report interval in seconds", "s", "10");
+    QCommandLineOption prefixOpt("user-prefix", "Username prefix", "prefix", "lg");
+    for (const auto& opt : {portOpt, clientsOpt, roomsOpt, publishersOpt, fpsOpt, jpegOpt, videoSizeOpt,
+                            audioOpt, deviceOpt, deviceSamplesOpt, durationOpt, reportOpt, prefixOpt}) {
+        parser.addOption(opt);
+    }
+    parser.process(app);
+
+    // 全部流量只走回环地址，避免误压测生产服务器
+    SimConfig cfg;
+    cfg.host = "127.0.0.1";
+    cfg.port = parser.value(portOpt).toUShort();
+    cfg.videoFps = parser.value(fpsOpt).toInt();
+    cfg.audioIntervalMs = parser.value(audioOpt).toInt();
+    cfg.deviceIntervalMs = parser.value(deviceOpt).toInt();
+    cfg.deviceSamples = parser.value(deviceSamplesOpt).toInt();
+    if (parser.isSet(jpegOpt)) {
+        QFile f(parser.value(jpegOpt));
+        if (!f.open(QIODevice::ReadOnly)) {
+            qCritical() << "cannot open" << f.fileName();
+            return 1;
+        }
+        cfg.videoBlob = f.readAll();
+    } else {
+        cfg.videoBlob = syntheticJpeg(parser.value(videoSizeOpt).toInt());
+    }
+
+    const int clients = qMax(1, parser.value(clientsOpt).toInt());
+    const int rooms = qMax(1, parser.value(roomsOpt).toInt());
+    const int publishers = qMax(0, parser.value(publishersOpt).toInt());
+    const QString prefix = parser.value(prefixOpt);
+
+    LatencyStats stats;
+    QVector<SimClient*> sims;
+    int joinedCount = 0;
+    for (int i = 0; i < clients; ++i) {
+        SimConfig c = cfg;
+        c.sendVideo = (i / rooms) < publishers; // 每个房间的前 publishers 个成员
+        auto* sim = new SimClient(i, QString("%1%2").arg(prefix).arg(i), QString("LG-%1").arg(i % rooms),
+                                  c, &stats, &app);
+        QObject::connect(sim, &SimClient::joined, &app, [&joinedCount, clients]() {
+            if (++joinedCount == clients) qInfo() << "loadgen: all" << clients << "clients joined";
+        });
+        sims.append(sim);
+    }
+
+    // 分批建连：每 50ms 启动 20 个，避免登录请求瞬间打满认证线程池
+    const int batch = 20;
+    for (int i = 0; i < sims.size(); i += batch) {
+        QTimer::singleShot((i / batch) * 50, &app, [&sims, i, batch]() {
+            for (int k = i; k < qMin(i + batch, sims.size()); ++k) sims[k]->start();
+        });
+    }
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QTimer reportTimer;
+    QObject::connect(&reportTimer, &QTimer::timeout, &app, [&]() {
+        qInfo().noquote() << QString("---- %1s, %2/%3 clients joined ----")
+                             .arg(elapsed.elapsed() / 1000).arg(joinedCount).arg(clients);
+        stats.report(elapsed.elapsed());
+    });
+    reportTimer.start(qMax(1, parser.value(reportOpt).toInt()) * 1000);
+
+    const int duration = parser.value(durationOpt).toInt();
+    if (duration > 0) {
+        QTimer::singleShot(duration * 1000, &app, [&]() {
+            qInfo().noquote() << QString("==== final (%1s) ====").arg(elapsed.elapsed() / 1000);
+            stats.report(elapsed.elapsed());
+            app.quit();
+        });
+    }
+
+    qInfo() << "loadgen:" << clients << "clients," << rooms << "rooms," << publishers
+            << "video publishers/room ->" << cfg.host << cfg.port;
+    return app.exec();
+}
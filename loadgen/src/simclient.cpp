@@ -0,0 +1,194 @@
+#include "simclient.h"
+#include "latencystats.h"
+
+static const char* SIM_PASSWORD = "loadgen";
+
+// 模拟的传感器：温度/压力用 float，振动是 int16 原始值（0.001g/LSB）
+static DeviceSchema makeDeviceSchema(int index) {
+    DeviceSchema schema;
+    schema.schemaId = 1;
+    schema.device = QString("press-%1").arg(index);
+    DeviceChannel temperature;
+    temperature.id = 1;
+    temperature.name = "temperature";
+    temperature.unit = "C";
+    DeviceChannel pressure;
+    pressure.id = 2;
+    pressure.name = "pressure";
+    pressure.unit = "MPa";
+    DeviceChannel vibration;
+    vibration.id = 3;
+    vibration.name = "vibration";
+    vibration.unit = "g";
+    vibration.type = DeviceSampleType::Int16;
+    vibration.scale = 0.001;
+    schema.channels = {temperature, pressure, vibration};
+    return schema;
+}
+
+SimClient::SimClient(int index, const QString& user, const QString& roomId,
+                     const SimConfig& cfg, LatencyStats* stats, QObject* parent)
+    : QObject(parent), index_(index), user_(user), roomId_(roomId), cfg_(cfg), stats_(stats),
+      conn_(this), videoTimer_(this), audioTimer_(this), deviceTimer_(this),
+      audioBlob_(640, '\0'), deviceSchema_(makeDeviceSchema(index)),
+      deviceBatch_(deviceSchema_, cfg.deviceSamples) {
+    connect(&conn_, &ClientConn::connected, this, &SimClient::onConnected);
+    connect(&conn_, &ClientConn::disconnected, this, &SimClient::onDisconnected);
+    connect(&conn_, &ClientConn::packetArrived, this, &SimClient::onPacket);
+    connect(&videoTimer_, &QTimer::timeout, this, &SimClient::sendVideo);
+    connect(&audioTimer_, &QTimer::timeout, this, &SimClient::sendAudio);
+    connect(&deviceTimer_, &QTimer::timeout, this, &SimClient::sendDevice);
+    videoTimer_.setTimerType(Qt::PreciseTimer);
+    audioTimer_.setTimerType(Qt::PreciseTimer);
+}
+
+void SimClient::start() {
+    conn_.connectTo(cfg_.host, cfg_.port);
+}
+
+// 已连接：先注册，收到回复（成功或已存在 409）后再登录
+// 两个请求不能背靠背发：注册还没落库时登录会得到 401
+void SimClient::onConnected() {
+    registering_ = true;
+    conn_.send(MSG_REGISTER, QJsonObject{{"username", user_}, {"password", SIM_PASSWORD}});
+}
+
+void SimClient::login() {
+    conn_.send(MSG_LOGIN, QJsonObject{{"username", user_},
+                                      {"password", SIM_PASSWORD},
+                                      {"compress", compressionOffer()}});
+}
+
+void SimClient::onDisconnected() {
+    if (joined_) qWarning() << "loadgen:" << user_ << "disconnected";
+    registering_ = false;
+    joined_ = false;
+    videoTimer_.stop();
+    audioTimer_.stop();
+    deviceTimer_.stop();
+}
+
+void SimClient::onPacket(Packet p) {
+    switch (p.type) {
+    case MSG_SERVER_EVENT: {
+        const int code = p.json().value("code").toInt();
+        const QString message = p.json().value("message").toString();
+        if (registering_) {
+            // 连接上的第一个服务器事件就是注册结果
+            registering_ = false;
+            if (code == 0 || code == 409) login();
+            else qWarning() << "loadgen:" << user_ << "register failed" << code << message;
+        } else if (code == 0 && message == "login successful") {
+            conn_.send(MSG_JOIN_WORKORDER, QJsonObject{{"roomId", roomId_}, {"user", user_}});
+        } else if (code == 0 && message == "joined") {
+            joined_ = true;
+            sendDeviceSchema();
+            startTraffic();
+            emit joined();
+        } else if (code != 0) {
+            qWarning() << "loadgen:" << user_ << "server error" << code << message;
+        }
+        break;
+    }
+    case MSG_CONTROL_CMD:
+        if (p.json().value("cmd").toString() == "schema_request" &&
+            p.json().value("target").toString() == user_) {
+            sendDeviceSchema();
+        }
+        break;
+    case MSG_DEVICE_DATA:
+        onDeviceData(p);
+        Q_FALLTHROUGH(); // 延迟与其他媒体帧一样统计
+    case MSG_VIDEO_FRAME:
+    case MSG_AUDIO_FRAME:
+    case MSG_TEXT: {
+        // 服务器转发保留原始时间戳，所有模拟客户端同机运行，时钟一致
+        const qint64 latency = QDateTime::currentMSecsSinceEpoch() - static_cast<qint64>(p.timestampMs);
+        stats_->record(roomId_, p.type, latency, p.raw.size());
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// 错开各客户端的首次发送，避免所有定时器在同一毫秒触发
+void SimClient::startTraffic() {
+    const int phase = index_ % 20;
+    if (cfg_.sendVideo && cfg_.videoFps > 0 && !cfg_.videoBlob.isEmpty()) {
+        QTimer::singleShot(phase, this, [this]() { videoTimer_.start(1000 / cfg_.videoFps); });
+    }
+    if (cfg_.audioIntervalMs > 0) {
+        QTimer::singleShot(phase, this, [this]() { audioTimer_.start(cfg_.audioIntervalMs); });
+    }
+    if (cfg_.deviceIntervalMs > 0) {
+        QTimer::singleShot(phase, this, [this]() { deviceTimer_.start(cfg_.deviceIntervalMs); });
+    }
+}
+
+QJsonObject SimClient::mediaJson() const {
+    return QJsonObject{{"roomId", roomId_},
+                       {"sender", user_},
+                       {"ts", QDateTime::currentMSecsSinceEpoch()}};
+}
+
+void SimClient::sendVideo() {
+    if (!joined_) return;
+    conn_.send(MSG_VIDEO_FRAME, mediaJson(), cfg_.videoBlob);
+}
+
+void SimClient::sendAudio() {
+    if (!joined_) return;
+    conn_.send(MSG_AUDIO_FRAME, mediaJson(), audioBlob_);
+}
+
+// schema 每个会话发一次（JSON），收到 schema_request 时重发
+void SimClient::sendDeviceSchema() {
+    QJsonObject j = mediaJson();
+    j["schema"] = deviceSchema_.toJson();
+    conn_.send(MSG_DEVICE_DATA, j);
+}
+
+// 合成的设备遥测：一个间隔内均匀采样 deviceSamples 次，二进制批量编码放在 bin
+void SimClient::sendDevice() {
+    if (!joined_ || cfg_.deviceSamples <= 0) return;
+    const qint64 nowUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    const qint64 stepUs = qMax<qint64>(1, qint64(cfg_.deviceIntervalMs) * 1000 / cfg_.deviceSamples);
+    if (nextSampleUs_ == 0 || nowUs - nextSampleUs_ > 1000000) nextSampleUs_ = nowUs - stepUs * cfg_.deviceSamples;
+    for (int i = 0; i < cfg_.deviceSamples; ++i, nextSampleUs_ += stepUs) {
+        const double t = nextSampleUs_ / 1e6;
+        const double values[] = {60.0 + 5.0 * qSin(t + index_),
+                                 1.2 + 0.1 * qCos(t + index_),
+                                 0.05 * qSin(2 * M_PI * 50 * t)};
+        deviceBatch_.append(nextSampleUs_, values);
+    }
+    QJsonObject j = mediaJson();
+    j["schemaId"] = qint64(deviceSchema_.schemaId);
+    j["samples"] = deviceBatch_.sampleCount();
+    conn_.send(MSG_DEVICE_DATA, j, encodeDeviceBatch(deviceBatch_.take()));
+}
+
+// 解码对端的设备帧（计入接收端 CPU）；缺 schema 时请求一次
+void SimClient::onDeviceData(const Packet& p) {
+    const QString sender = p.json().value("sender").toString();
+    if (p.json().contains("schema")) {
+        DeviceSchema schema;
+        if (DeviceSchema::fromJson(p.json().value("schema").toObject(), &schema)) {
+            peerSchemas_.insert(sender, schema.schemaId);
+        }
+        return;
+    }
+    DeviceBatch batch;
+    QString error;
+    if (!decodeDeviceBatch(p.bin(), &batch, &error)) {
+        qWarning() << "loadgen:" << user_ << "bad device batch from" << sender << error;
+        return;
+    }
+    if (peerSchemas_.value(sender, 0) != batch.schemaId && !schemaRequested_.contains(sender)) {
+        schemaRequested_.insert(sender);
+        QJsonObject j = mediaJson();
+        j["cmd"] = "schema_request";
+        j["target"] = sender;
+        conn_.send(MSG_CONTROL_CMD, j);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+// ===============================================
+// loadgen/src/simclient.h
+// 模拟客户端：注册 -> 登录 -> 加入工单 -> 按节奏发送视频/音频/设备数据
+// 收到的媒体帧按帧头 timestampMs 计算端到端延迟，写入共享的 LatencyStats
+// 设备数据用二进制批量编码（common/devicedata.h）：加入后先发一次 schema，
+// 之后每帧带 deviceSamples 个 1kHz 量级的样本；收到未知 schemaId 时请求对方重发
+// ===============================================
+#include <QtCore>
+#include "../../client-factory/src/clientconn.h"
+#include "../../common/devicedata.h"
+
+class LatencyStats;
+
+struct SimConfig {
+    QString host = "127.0.0.1";
+    quint16 port = 9000;
+    int videoFps = 15;
+    bool sendVideo = false;   // 每个房间前 K 个成员发视频，其余只收
+    QByteArray videoBlob;     // 固定 JPEG（或合成数据）
+    int audioIntervalMs = 20; // 640B PCM / 20ms
+    int deviceIntervalMs = 100;
+    int deviceSamples = 100;  // 每个设备帧的样本数（100 样本 / 100ms = 1kHz）
+};
+
+class SimClient : public QObject {
+    Q_OBJECT
+public:
+    SimClient(int index, const QString& user, const QString& roomId,
+              const SimConfig& cfg, LatencyStats* stats, QObject* parent = nullptr);
+    void start();
+    bool isJoined() const { return joined_; }
+
+signals:
+    void joined();
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onPacket(Packet p);
+    void sendVideo();
+    void sendAudio();
+    void sendDevice();
+
+private:
+    void startTraffic();
+    QJsonObject mediaJson() const;
+    void sendDeviceSchema();
+    void onDeviceData(const Packet& p);
+    void login();
+
+    int index_;
+    QString user_;
+    QString roomId_;
+    SimConfig cfg_;
+    LatencyStats* stats_;
+    ClientConn conn_;
+    bool registering_ = false; // 等 REGISTER 的回复，之后才登录
+    bool joined_ = false;
+    QTimer videoTimer_;
+    QTimer audioTimer_;
+    QTimer deviceTimer_;
+    QByteArray audioBlob_;
+    DeviceSchema deviceSchema_;
+    DeviceBatchBuilder deviceBatch_;
+    qint64 nextSampleUs_ = 0;
+    QHash<QString, quint32> peerSchemas_;    // 发送者 -> 已收到的 schemaId
+    QSet<QString> schemaRequested_;          // 已请求过 schema 的发送者（每个只请求一次）
+};
@@ -4,6 +4,25 @@ QT += core network sql
 CONFIG += c++11 console
 CONFIG -= app_bundle
 SOURCES += src/main.cpp \
+           src/hubserver.cpp \
+           src/authservice.cpp \
+           src/sessionstore.cpp \
+           src/egressscheduler.cpp \
+           src/timerwheel.cpp \
+           src/simulcast.cpp \
+           src/roomrecorder.cpp \
+           src/segmentreader.cpp \
+           src/roomreplayer.cpp \
            src/roomhub.cpp
-HEADERS += src/roomhub.h
+HEADERS += src/roomhub.h \
+           src/hubserver.h \
+           src/authservice.h \
+           src/sessionstore.h \
+           src/egressscheduler.h \
+           src/timerwheel.h \
+           src/simulcast.h \
+           src/segmentformat.h \
+           src/roomrecorder.h \
+           src/segmentreader.h \
+           src/roomreplayer.h
 include(../common/common.pri)
@@ -0,0 +1,220 @@
+#include "authservice.h"
+#include <QCryptographicHash>
+#include <QSqlQuery>
+#include <QSqlError>
+
+AuthService::AuthService(int workers, QObject* parent) : QObject(parent), flushTimer_(this) {
+    pool_.setMaxThreadCount(qMax(1, workers));
+    pool_.setExpiryTimeout(-1); // 线程常驻，线程专属的数据库连接才能一直复用
+
+    flushTimer_.setInterval(1000);
+    connect(&flushTimer_, &QTimer::timeout, this, &AuthService::onFlushTimer);
+}
+
+AuthService::~AuthService() {
+    // 退出前把尚未落库的会话写回
+    flushTimer_.stop();
+    onFlushTimer();
+    pool_.waitForDone();
+}
+
+void AuthService::onFlushTimer() {
+    // 时间轮推进和写库都放在工作线程，定时器所在线程只负责投递
+    pool_.start(QRunnable::create([this]() {
+        sessions_.sweepExpired(QDateTime::currentMSecsSinceEpoch());
+        sessions_.flush(threadDatabase());
+    }));
+}
+
+bool AuthService::initDatabase() {
+    // 建表只做一次，用临时连接，完成后释放
+    const QString connName = "auth-init";
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connName);
+        db.setDatabaseName(dbName_);
+
+        if (!db.open()) {
+            qCritical() << "Cannot open database:" << db.lastError().text();
+        } else {
+            // 创建用户表
+            QSqlQuery query(db);
+            QString createUsersTable = R"(
+                CREATE TABLE IF NOT EXISTS users (
+                    id INTEGER PRIMARY KEY AUTOINCREMENT,
+                    username TEXT UNIQUE NOT NULL,
+                    password_hash TEXT NOT NULL,
+                    created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+                )
+            )";
+
+            // 创建会话表
+            QString createSessionsTable = R"(
+                CREATE TABLE IF NOT EXISTS sessions (
+                    token TEXT PRIMARY KEY,
+                    username TEXT NOT NULL,
+                    created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
+                    expires_at DATETIME NOT NULL,
+                    FOREIGN KEY (username) REFERENCES users (username)
+                )
+            )";
+
+            if (!query.exec(createUsersTable)) {
+                qCritical() << "Failed to create users table:" << query.lastError().text();
+            } else if (!query.exec(createSessionsTable)) {
+                qCritical() << "Failed to create sessions table:" << query.lastError().text();
+            } else {
+                ok = true;
+                // 恢复未过期会话到内存
+                int loaded = sessions_.load(db);
+                qInfo() << "Restored" << loaded << "sessions";
+            }
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connName);
+
+    if (ok) {
+        qInfo() << "Database initialized successfully," << pool_.maxThreadCount() << "auth workers";
+        flushTimer_.start();
+    }
+    return ok;
+}
+
+void AuthService::submit(QObject* context, const void* queueKey, std::function<Result()> job, Callback callback) {
+    Job j;
+    j.target = context;
+    j.work = std::move(job);
+    j.callback = std::move(callback);
+    {
+        QMutexLocker lock(&queueMutex_);
+        auto it = queues_.find(queueKey);
+        if (it != queues_.end()) {
+            // 同一连接已有任务在执行：排队，保证结果按请求顺序返回
+            it->enqueue(std::move(j));
+            return;
+        }
+        queues_.insert(queueKey, QQueue<Job>()); // 空队列表示"有任务在执行"
+    }
+    runJob(queueKey, std::move(j));
+}
+
+void AuthService::runJob(const void* queueKey, Job job) {
+    pool_.start(QRunnable::create([this, queueKey, job]() {
+        const Result r = job.work();
+        if (job.target) {
+            const Callback callback = job.callback;
+            QMetaObject::invokeMethod(job.target.data(), [callback, r]() {
+                callback(r);
+            }, Qt::QueuedConnection);
+        }
+
+        // 结果已按序投递，再放出同一连接的下一个任务（回到线程池，不独占本线程）
+        Job next;
+        {
+            QMutexLocker lock(&queueMutex_);
+            auto it = queues_.find(queueKey);
+            if (it->isEmpty()) {
+                queues_.erase(it);
+                return;
+            }
+            next = it->dequeue();
+        }
+        runJob(queueKey, std::move(next));
+    }));
+}
+
+QSqlDatabase AuthService::threadDatabase() {
+    // 连接只能在创建它的线程里使用：按线程命名，首次使用时创建
+    const QString connName = QString("auth-%1")
+        .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    if (QSqlDatabase::contains(connName)) {
+        return QSqlDatabase::database(connName);
+    }
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connName);
+    db.setDatabaseName(dbName_);
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000"); // 多个工作线程并发写同一个库
+    if (!db.open()) {
+        qCritical() << "Cannot open database:" << db.lastError().text();
+    }
+    return db;
+}
+
+QString AuthService::hashPassword(const QString& password) {
+    // 简单的密码哈希（实际项目中应使用更安全的方法）
+    return QString(QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha256).toHex());
+}
+
+void AuthService::registerUser(const QString& username, const QString& password,
+                               QObject* context, const void* queueKey, Callback callback) {
+    submit(context, queueKey, [this, username, password]() {
+        Result r;
+        r.username = username;
+
+        QSqlQuery query(threadDatabase());
+        query.prepare("INSERT INTO users (username, password_hash) VALUES (?, ?)");
+        query.addBindValue(username);
+        query.addBindValue(hashPassword(password));
+
+        if (!query.exec()) {
+            qWarning() << "Failed to register user:" << query.lastError().text();
+            r.code = 409;
+            r.message = "username already exists or registration failed";
+            return r;
+        }
+
+        qInfo() << "User registered successfully:" << username;
+        r.ok = true;
+        r.message = "registration successful";
+        return r;
+    }, callback);
+}
+
+void AuthService::loginUser(const QString& username, const QString& password,
+                            QObject* context, const void* queueKey, Callback callback) {
+    submit(context, queueKey, [this, username, password]() {
+        Result r;
+        r.username = username;
+        r.code = 401;
+        r.message = "invalid username or password";
+
+        QSqlQuery query(threadDatabase());
+        query.prepare("SELECT username FROM users WHERE username = ? AND password_hash = ?");
+        query.addBindValue(username);
+        query.addBindValue(hashPassword(password));
+
+        if (!query.exec() || !query.next()) {
+            qWarning() << "Login failed for user:" << username;
+            return r;
+        }
+
+        // 生成会话令牌（24小时有效期），先进内存，由 onFlushTimer 批量写回
+        QString token = sessions_.create(username);
+
+        qInfo() << "User logged in successfully:" << username;
+        r.ok = true;
+        r.code = 0;
+        r.message = "login successful";
+        r.token = token;
+        return r;
+    }, callback);
+}
+
+AuthService::Result AuthService::validateSessionToken(const QString& token) const {
+    Result r;
+    r.code = 401;
+    r.message = "invalid or expired session";
+    r.token = token;
+
+    SessionStore::Session session;
+    if (!sessions_.lookup(token, &session)) {
+        return r;
+    }
+
+    r.ok = true;
+    r.code = 0;
+    r.message = "session valid";
+    r.username = session.username;
+    return r;
+}
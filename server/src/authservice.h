@@ -0,0 +1,64 @@
+#pragma once
+// ===============================================
+// server/src/authservice.h
+// 异步认证服务：注册/登录/令牌校验的 SQLite 操作全部在独立线程池中执行，
+// 每个工作线程持有自己的数据库连接，结果投递回调用方（context）所在线程
+// 同一连接的请求按提交顺序串行执行（先 REGISTER 后 LOGIN 不会乱序），不同连接之间并行
+// 网络事件循环里不再有任何同步 QSqlQuery
+// 会话令牌由内存 SessionStore 管理，定时批量写回数据库
+// ===============================================
+#include <QtCore>
+#include <QtSql>
+#include <functional>
+#include "sessionstore.h"
+
+class AuthService : public QObject {
+    Q_OBJECT
+public:
+    struct Result {
+        bool ok = false;
+        int code = 0;        // 与 MSG_SERVER_EVENT 的 code 一致：0 成功，400/401/409 失败
+        QString message;
+        QString username;
+        QString token;       // 登录成功时的会话令牌
+    };
+    using Callback = std::function<void(const Result&)>;
+
+    explicit AuthService(int workers = 2, QObject* parent=nullptr);
+    ~AuthService() override;
+
+    bool initDatabase(); // 建表，启动时在调用线程执行一次
+
+    // 以下接口立即返回；callback 在 context 所在线程执行（context 已销毁则丢弃）
+    // queueKey 标识一个请求队列（通常是连接的 socket）：同一 key 的任务先进先出、逐个执行
+    void registerUser(const QString& username, const QString& password,
+                      QObject* context, const void* queueKey, Callback callback);
+    void loginUser(const QString& username, const QString& password,
+                   QObject* context, const void* queueKey, Callback callback);
+
+    // 令牌校验只查内存会话表，可在任意线程同步调用
+    Result validateSessionToken(const QString& token) const;
+
+private slots:
+    void onFlushTimer();
+
+private:
+    QThreadPool pool_;
+    QString dbName_ = "industrial_remote_expert.db";
+    SessionStore sessions_;
+    QTimer flushTimer_;  // 周期性把新会话/过期清理批量写回数据库
+
+    struct Job {
+        QPointer<QObject> target;
+        std::function<Result()> work;
+        Callback callback;
+    };
+    // 每个 queueKey 最多一个任务在线程池里；其余排在这里，前一个完成后再投递
+    QMutex queueMutex_;
+    QHash<const void*, QQueue<Job>> queues_;
+
+    void submit(QObject* context, const void* queueKey, std::function<Result()> job, Callback callback);
+    void runJob(const void* queueKey, Job job);
+    QSqlDatabase threadDatabase(); // 当前工作线程专属连接（按需创建）
+    static QString hashPassword(const QString& password);
+};
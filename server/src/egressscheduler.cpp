@@ -0,0 +1,73 @@
+#include "egressscheduler.h"
+#include "roomhub.h"
+
+EgressScheduler::EgressScheduler(QObject* parent) : QObject(parent) {
+}
+
+void EgressScheduler::setRoomWeight(const QString& roomId, int weight) {
+    rooms_[roomId].weight = qMax(1, weight);
+}
+
+void EgressScheduler::markReady(ClientCtx* c) {
+    if (readySet_.contains(c)) return;
+
+    RoomState& room = rooms_[c->roomId]; // 未加入房间的连接共用 "" 这一组
+    if (room.ready.isEmpty() && !active_.contains(c->roomId)) {
+        active_.append(c->roomId);
+    }
+    room.ready.append(c);
+    readySet_.insert(c);
+    readyRoom_.insert(c, c->roomId);
+    schedulePass();
+}
+
+void EgressScheduler::forget(ClientCtx* c) {
+    if (!readySet_.remove(c)) return;
+    const QString roomId = readyRoom_.take(c);
+    auto it = rooms_.find(roomId);
+    if (it != rooms_.end()) {
+        it->ready.removeAll(c);
+    }
+}
+
+void EgressScheduler::schedulePass() {
+    if (passScheduled_) return;
+    passScheduled_ = true;
+    QMetaObject::invokeMethod(this, "runPass", Qt::QueuedConnection);
+}
+
+void EgressScheduler::runPass() {
+    passScheduled_ = false;
+
+    const QList<QString> rooms = active_;
+    for (const QString& roomId : rooms) {
+        RoomState& room = rooms_[roomId];
+        room.deficit += QUANTUM * room.weight;
+
+        // 房间内成员轮询：每人分到剩余额度的一份，直到额度用完或没人能写
+        while (room.deficit > 0 && !room.ready.isEmpty()) {
+            ClientCtx* c = room.ready.takeFirst();
+            const qint64 share = qMax<qint64>(1, room.deficit / (room.ready.size() + 1));
+            room.deficit -= c->txq.pump(c->sock, share); // 整帧写出，可能超发，下一轮扣回
+
+            if (!c->txq.isEmpty() && c->txq.canWrite(c->sock)) {
+                // 被本轮额度截断：排到队尾
+                room.ready.append(c);
+            } else {
+                // 队列空了，或 socket 缓冲满了（等 bytesWritten 再标记）
+                readySet_.remove(c);
+                readyRoom_.remove(c);
+            }
+        }
+
+        if (room.ready.isEmpty()) {
+            room.deficit = 0; // 空闲房间不累积额度
+            active_.removeAll(roomId);
+            if (room.weight == 1) rooms_.remove(roomId);
+        }
+    }
+
+    if (!active_.isEmpty()) {
+        schedulePass();
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+// ===============================================
+// server/src/egressscheduler.h
+// 分片内的出口调度：同一线程上的多个房间按权重做差额轮询（DRR），
+// 每轮每个房间最多写出 quantum*weight 字节，大房间的视频洪流不会饿死小房间
+// 连接内部的先后顺序由 SendQueue 的严格优先级决定（控制 > 音频 > 文本 > 视频）
+// ===============================================
+#include <QtCore>
+
+struct ClientCtx;
+
+class EgressScheduler : public QObject {
+    Q_OBJECT
+public:
+    explicit EgressScheduler(QObject* parent=nullptr);
+
+    void setRoomWeight(const QString& roomId, int weight); // 默认 1，服务器 --room-weight 设置
+    void markReady(ClientCtx* c); // c 有待发帧；本轮事件循环结束前调度
+    void forget(ClientCtx* c);    // 断开/离开房间/迁移前调用
+
+private slots:
+    void runPass();
+
+private:
+    static const qint64 QUANTUM = 64 * 1024; // 每轮每单位权重的字节数
+
+    struct RoomState {
+        int weight = 1;
+        qint64 deficit = 0;
+        QList<ClientCtx*> ready; // 成员轮询顺序
+    };
+
+    QHash<QString, RoomState> rooms_;
+    QList<QString> active_;      // 有待发数据的房间
+    QSet<ClientCtx*> readySet_;  // 去重
+    QHash<ClientCtx*, QString> readyRoom_; // 入队时所在房间
+    bool passScheduled_ = false;
+
+    void schedulePass();
+};
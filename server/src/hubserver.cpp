@@ -0,0 +1,79 @@
+#include "hubserver.h"
+
+HubServer::HubServer(int threads, AuthService* auth, RoomRecorder* recorder, QObject* parent)
+    : QTcpServer(parent) {
+    for (int i = 0; i < threads; ++i) {
+        auto* thread = new QThread(this);
+        thread->setObjectName(QString("shard-%1").arg(i));
+        auto* hub = new RoomHub;
+        hub->setAuthService(auth);
+        hub->setRecorder(recorder);
+        hub->moveToThread(thread);
+        connect(thread, &QThread::finished, hub, &QObject::deleteLater);
+        threads_.append(thread);
+        hubs_.append(hub);
+    }
+
+    // 线程启动前把分片表发给每个 hub，之后只读
+    for (int i = 0; i < hubs_.size(); ++i) {
+        hubs_[i]->setShards(i, hubs_);
+    }
+
+    for (QThread* thread : threads_) {
+        thread->start();
+    }
+}
+
+HubServer::~HubServer() {
+    close();
+    for (QThread* thread : threads_) {
+        thread->quit();
+        thread->wait();
+    }
+}
+
+bool HubServer::start(quint16 port) {
+    if (!listen(QHostAddress::Any, port)) {
+        qWarning() << "Listen failed on port" << port << ":" << errorString();
+        return false;
+    }
+    qInfo() << "Server listening on" << serverAddress().toString() << ":" << port
+            << "with" << hubs_.size() << "shard threads";
+    return true;
+}
+
+void HubServer::startReplay(const QString& path, const QString& roomId, double speed) {
+    // 由任一分片转交给房间所属分片
+    RoomHub* hub = hubs_.first();
+    QMetaObject::invokeMethod(hub, [hub, path, roomId, speed]() {
+        hub->startReplay(path, roomId, speed);
+    }, Qt::QueuedConnection);
+}
+
+void HubServer::setStatsFile(const QString& path) {
+    // stats.json -> stats-0.json, stats-1.json ...
+    const QFileInfo info(path);
+    const QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+    for (int i = 0; i < hubs_.size(); ++i) {
+        RoomHub* hub = hubs_[i];
+        const QString shardPath = info.dir().filePath(QString("%1-%2%3").arg(info.completeBaseName()).arg(i).arg(suffix));
+        QMetaObject::invokeMethod(hub, [hub, shardPath]() { hub->setStatsFile(shardPath); }, Qt::QueuedConnection);
+    }
+}
+
+void HubServer::setRoomWeight(const QString& roomId, int weight) {
+    // 每个分片都记下：调度器按连接当前所在分片排队，迁移中的成员也能用上权重
+    for (RoomHub* hub : qAsConst(hubs_)) {
+        QMetaObject::invokeMethod(hub, [hub, roomId, weight]() { hub->setRoomWeight(roomId, weight); },
+                                  Qt::QueuedConnection);
+    }
+}
+
+void HubServer::incomingConnection(qintptr socketDescriptor) {
+    // socket 在分片线程里创建，避免跨线程迁移刚接受的连接
+    RoomHub* hub = hubs_.at(nextShard_);
+    nextShard_ = (nextShard_ + 1) % hubs_.size();
+    QMetaObject::invokeMethod(hub, [hub, socketDescriptor]() {
+        hub->adoptSocket(socketDescriptor);
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,28 @@
+#pragma once
+// ===============================================
+// server/src/hubserver.h
+// 多线程服务器：一个监听线程 + N 个分片线程（每个分片一个 RoomHub 和独立事件循环）
+// 新连接轮询分配给分片；加入房间时由 RoomHub 迁移到房间所属的分片
+// ===============================================
+#include <QtCore>
+#include <QtNetwork>
+#include "roomhub.h"
+
+class HubServer : public QTcpServer {
+    Q_OBJECT
+public:
+    HubServer(int threads, AuthService* auth, RoomRecorder* recorder = nullptr, QObject* parent=nullptr);
+    ~HubServer() override;
+    bool start(quint16 port);
+    void startReplay(const QString& path, const QString& roomId, double speed); // 见 RoomHub::startReplay
+    void setStatsFile(const QString& path); // 每个分片写 <path> 加分片号后缀，见 RoomHub::setStatsFile
+    void setRoomWeight(const QString& roomId, int weight); // 见 RoomHub::setRoomWeight
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    QVector<QThread*> threads_;
+    QVector<RoomHub*> hubs_;
+    int nextShard_ = 0; // 轮询分配新连接
+};
@@ -1,17 +1,89 @@
 #include <QtCore>
 #include <QtNetwork>
 #include "roomhub.h"
+#include "hubserver.h"
+#include "authservice.h"
+#include "roomrecorder.h"
+#include "segmentreader.h"
 
 int main(int argc, char** argv) {
     QCoreApplication app(argc, argv);
     QCommandLineParser parser; parser.addHelpOption();
     QCommandLineOption portOpt(QStringList() << "p" << "port", "Listen port", "port", "9000");
+    QCommandLineOption threadsOpt(QStringList() << "t" << "threads",
+                                  "Shard threads (1 = single event loop)", "threads", "1");
+    QCommandLineOption authOpt("auth-workers", "Auth/database worker threads", "n", "2");
+    QCommandLineOption recordOpt("record", "Record relayed room frames to segment files under <dir>", "dir");
+    QCommandLineOption statsOpt("stats", "Write per-client queue/RTT stats as JSON to <file> every 10 s", "file");
+    QCommandLineOption roomWeightOpt("room-weight",
+                                     "Egress share of a room relative to others (default 1, repeatable)", "roomId=n");
+    QCommandLineOption replayOpt("replay", "Replay a recording (room directory or .rec file) into a room", "path");
+    QCommandLineOption replayRoomOpt("replay-room", "Room to replay into (default: the recorded room)", "roomId");
+    QCommandLineOption replaySpeedOpt("replay-speed", "Replay speed factor, 0 = as fast as possible", "x", "1");
     parser.addOption(portOpt);
+    parser.addOption(threadsOpt);
+    parser.addOption(authOpt);
+    parser.addOption(recordOpt);
+    parser.addOption(statsOpt);
+    parser.addOption(roomWeightOpt);
+    parser.addOption(replayOpt);
+    parser.addOption(replayRoomOpt);
+    parser.addOption(replaySpeedOpt);
     parser.process(app);
 
     quint16 port = parser.value(portOpt).toUShort();
-    RoomHub hub;
-    if (!hub.start(port)) return 1;
+    int threads = qMax(1, parser.value(threadsOpt).toInt());
+
+    AuthService auth(parser.value(authOpt).toInt());
+    if (!auth.initDatabase()) {
+        qCritical() << "Failed to initialize database";
+    }
+
+    // 先于 hub 创建、后于 hub 析构：析构时写完队列并 fdatasync
+    QScopedPointer<RoomRecorder> recorder;
+    if (parser.isSet(recordOpt)) {
+        recorder.reset(new RoomRecorder(parser.value(recordOpt)));
+        if (!recorder->start()) return 1;
+    }
+
+    QScopedPointer<RoomHub> hub;
+    QScopedPointer<HubServer> sharded;
+    if (threads == 1) {
+        hub.reset(new RoomHub);
+        hub->setAuthService(&auth);
+        hub->setRecorder(recorder.data());
+        hub->setStatsFile(parser.value(statsOpt));
+        if (!hub->start(port)) return 1;
+    } else {
+        sharded.reset(new HubServer(threads, &auth, recorder.data()));
+        if (!sharded->start(port)) return 1;
+        if (parser.isSet(statsOpt)) sharded->setStatsFile(parser.value(statsOpt));
+    }
+
+    // 房间出口权重：roomId=n，拥塞时按权重分配每轮写出的字节
+    for (const QString& spec : parser.values(roomWeightOpt)) {
+        const int eq = spec.lastIndexOf('=');
+        bool ok = false;
+        const int weight = eq > 0 ? spec.mid(eq + 1).toInt(&ok) : 0;
+        if (!ok || weight < 1) {
+            qWarning() << "Ignoring --room-weight" << spec << "(expected roomId=n, n >= 1)";
+            continue;
+        }
+        const QString roomId = spec.left(eq);
+        if (hub) hub->setRoomWeight(roomId, weight);
+        else sharded->setRoomWeight(roomId, weight);
+        qInfo() << "Room" << roomId << "egress weight" << weight;
+    }
+
+    if (parser.isSet(replayOpt)) {
+        const QString path = parser.value(replayOpt);
+        QString roomId = parser.value(replayRoomOpt);
+        // 默认回到录制时的房间（录制目录里的 room.id）
+        if (roomId.isEmpty()) roomId = recordedRoomId(path);
+        const double speed = qMax(0.0, parser.value(replaySpeedOpt).toDouble());
+        if (hub) hub->startReplay(path, roomId, speed);
+        else sharded->startReplay(path, roomId, speed);
+    }
 
     qInfo() << "Usage: clients connect to server_ip:" << port;
     return app.exec();
@@ -1,13 +1,25 @@
 #include "roomhub.h"
-#include <QCryptographicHash>
-#include <QUuid>
-#include <QSqlQuery>
-#include <QSqlError>
+#include <algorithm>
 
-RoomHub::RoomHub(QObject* parent) : QObject(parent) {
-    if (!initDatabase()) {
-        qCritical() << "Failed to initialize database";
-    }
+// 心跳时间轮：250ms 一格，一圈 4 秒，覆盖 HEARTBEAT_INTERVAL_MS
+static const qint64 LIVENESS_TICK_MS = 250;
+static const int LIVENESS_WHEEL_SLOTS = 16;
+// 可靠流的 ACK 最多攒这么久：一批控制/文本只回一个累计确认
+static const int ACK_BATCH_MS = 20;
+// 断线后会话上下文保留多久等待客户端恢复
+static const qint64 RESUME_GRACE_MS = 60 * 1000;
+
+RoomHub::RoomHub(QObject* parent)
+    : QObject(parent), server_(this), statsTimer_(this), egress_(this), livenessTimer_(this),
+      liveness_(LIVENESS_WHEEL_SLOTS, LIVENESS_TICK_MS) {
+    // server_/statsTimer_/egress_ 挂在 hub 下，分片模式 moveToThread 时随 hub 一起迁移
+    statsTimer_.setInterval(10000);
+    connect(&statsTimer_, &QTimer::timeout, this, &RoomHub::onStatsTimer);
+    statsTimer_.start();
+    // 整个分片只有这一个心跳定时器，连接再多也不增加定时器
+    livenessTimer_.setInterval(int(LIVENESS_TICK_MS));
+    connect(&livenessTimer_, &QTimer::timeout, this, &RoomHub::onLivenessTick);
+    livenessTimer_.start();
 }
 
 bool RoomHub::start(quint16 port) {
@@ -20,41 +32,220 @@ bool RoomHub::start(quint16 port) {
     return true;
 }
 
+/* ---------- 分片模式（多线程） ---------- */
+
+void RoomHub::setShards(int index, const QVector<RoomHub*>& shards) {
+    shardIndex_ = index;
+    shards_ = shards;
+}
+
+void RoomHub::adoptSocket(qintptr socketDescriptor) {
+    auto* sock = new QTcpSocket;
+    if (!sock->setSocketDescriptor(socketDescriptor)) {
+        qWarning() << "Shard" << shardIndex_ << "cannot adopt socket:" << sock->errorString();
+        delete sock;
+        return;
+    }
+    addClient(sock);
+}
+
+RoomHub* RoomHub::shardForRoom(const QString& roomId) const {
+    if (shards_.isEmpty()) return const_cast<RoomHub*>(this);
+    // 固定种子，保证所有分片对同一房间算出同一个归属
+    return shards_.at(static_cast<int>(qHash(roomId, 0) % static_cast<uint>(shards_.size())));
+}
+
+void RoomHub::handOff(ClientCtx* c, const QVector<Packet>& pending) {
+    RoomHub* target = shardForRoom(c->pendingJoin);
+    QTcpSocket* sock = c->sock;
+
+    // 先在本分片彻底摘除：房间索引、连接索引、信号
+    leaveRoom(c);
+    liveness_.cancel(c);
+    feedbackPending_.remove(c); // 欠的 ACK 由目标分片补回
+    clients_.remove(sock);
+    disconnect(sock, nullptr, this, nullptr);
+
+    // socket 必须在当前所属线程里迁出，且不能有父对象
+    sock->setParent(nullptr);
+    sock->moveToThread(target->thread());
+
+    qInfo() << "Hand off" << c->user << "to shard" << target->shardIndex_ << "for room" << c->pendingJoin;
+    QMetaObject::invokeMethod(target, [target, c, pending]() {
+        target->adoptClient(c, pending);
+    }, Qt::QueuedConnection);
+}
+
+void RoomHub::adoptClient(ClientCtx* c, QVector<Packet> pending) {
+    QTcpSocket* sock = c->sock;
+    if (sock->state() != QAbstractSocket::ConnectedState) {
+        // 迁移途中对端已断开：已登录的照样暂存，客户端重连后可直接恢复到目标房间
+        qInfo() << "Client disconnected during hand-off" << c->user;
+        sock->deleteLater();
+        if (c->authenticated && !c->sessionToken.isEmpty()) parkClient(c);
+        else delete c;
+        return;
+    }
+
+    clients_.insert(sock, c);
+    watchSocket(sock);
+    liveness_.schedule(c, heartbeatClockUs() / 1000 + HEARTBEAT_INTERVAL_MS);
+    markFeedback(c);
+
+    const QString roomId = c->pendingJoin;
+    c->pendingJoin.clear();
+    if (!c->pendingResume.isEmpty()) {
+        const QJsonObject req = c->pendingResume;
+        c->pendingResume = QJsonObject();
+        completeResume(c, req);
+    } else {
+        completeJoin(c, roomId);
+    }
+
+    // 迁移前已拆出但未处理的帧 + 迁移期间到达的数据
+    c->rx.readFrom(sock);
+    processIncoming(c, pending);
+}
+
+/* ---------- 连接管理 ---------- */
+
+void RoomHub::watchSocket(QTcpSocket* sock) {
+    connect(sock, &QTcpSocket::readyRead, this, &RoomHub::onReadyRead);
+    connect(sock, &QTcpSocket::bytesWritten, this, &RoomHub::onBytesWritten);
+    connect(sock, &QTcpSocket::disconnected, this, &RoomHub::onDisconnected);
+}
+
 void RoomHub::onNewConnection() {
     while (server_.hasPendingConnections()) {
-        QTcpSocket* sock = server_.nextPendingConnection();
-        auto* ctx = new ClientCtx;
-        ctx->sock = sock;
-        clients_.insert(sock, ctx);
+        addClient(server_.nextPendingConnection());
+    }
+}
 
-        qInfo() << "New client from" << sock->peerAddress().toString() << sock->peerPort();
+void RoomHub::addClient(QTcpSocket* sock) {
+    auto* ctx = new ClientCtx;
+    ctx->sock = sock;
+    ctx->lastRxMs = heartbeatClockUs() / 1000;
+    clients_.insert(sock, ctx);
+    liveness_.schedule(ctx, ctx->lastRxMs + HEARTBEAT_INTERVAL_MS);
 
-        connect(sock, &QTcpSocket::readyRead, this, &RoomHub::onReadyRead);
-        connect(sock, &QTcpSocket::disconnected, this, &RoomHub::onDisconnected);
-    }
+    qInfo() << "New client from" << sock->peerAddress().toString() << sock->peerPort()
+            << "shard" << shardIndex_;
+
+    watchSocket(sock);
 }
 
 void RoomHub::onDisconnected() {
     auto* sock = qobject_cast<QTcpSocket*>(sender());
     if (!sock) return;
+    removeClient(sock);
+}
+
+void RoomHub::removeClient(QTcpSocket* sock) {
     auto it = clients_.find(sock);
     if (it == clients_.end()) return;
     ClientCtx* c = it.value();
 
-    if (!c->roomId.isEmpty()) {
-        // 从房间索引里移除
-        auto range = rooms_.equal_range(c->roomId);
-        for (auto i = range.first; i != range.second; ) {
-            if (i.value() == sock) i = rooms_.erase(i);
-            else ++i;
-        }
-    }
     qInfo() << "Client disconnected" << c->user << c->roomId;
     clients_.erase(it);
     sock->deleteLater();
+    liveness_.cancel(c);
+    if (c->authenticated && !c->sessionToken.isEmpty()) {
+        parkClient(c);
+        return;
+    }
+    // 从房间索引里移除
+    leaveRoom(c);
+    feedbackPending_.remove(c);
     delete c;
 }
 
+// 断线的已认证连接先不销毁：离开房间（不再给它写帧），保留身份、双向可靠流状态和 RTT，
+// 宽限期内凭会话令牌恢复；过期由时间轮清理。
+// 发送队列里的视频/音频随之丢弃；控制/文本帧在 reliableTx 里一直保留到客户端确认，
+// 恢复时从客户端报告的确认位置之后补发
+void RoomHub::parkClient(ClientCtx* c) {
+    c->resumeRoom = c->roomId.isEmpty() ? c->pendingJoin : c->roomId; // 迁移途中断开：目标房间
+    leaveRoom(c);
+    feedbackPending_.remove(c);
+    c->sock = nullptr;
+    c->txq.clear();
+    c->rx.release();
+    c->pendingJoin.clear();
+    c->pendingResume = QJsonObject();
+    if (ClientCtx* old = parked_.take(c->sessionToken)) {
+        liveness_.cancel(old);
+        delete old;
+    }
+    parked_.insert(c->sessionToken, c);
+    liveness_.schedule(c, heartbeatClockUs() / 1000 + RESUME_GRACE_MS);
+}
+
+// 时间轮到期的连接：静默超时的断开（释放房间位置，不再给死连接写视频），其余发下一个心跳
+void RoomHub::onLivenessTick() {
+    const qint64 now = heartbeatClockUs() / 1000;
+    for (ClientCtx* c : liveness_.expire(now)) {
+        if (!c->sock) {
+            // 暂存的会话过了宽限期
+            qInfo() << "Session expired" << c->user << c->resumeRoom;
+            if (parked_.value(c->sessionToken) == c) parked_.remove(c->sessionToken);
+            delete c;
+            continue;
+        }
+        const qint64 silentMs = now - c->lastRxMs;
+        if (silentMs >= HEARTBEAT_TIMEOUT_MS) {
+            qCInfo(logRoomHub) << "Evicting silent client" << c->user << c->roomId
+                               << "after" << silentMs << "ms";
+            QTcpSocket* sock = c->sock;
+            sock->abort();
+            removeClient(sock); // abort 已触发 disconnected 时这里什么也不做
+            continue;
+        }
+        sendHeartbeat(c);
+        liveness_.schedule(c, now + HEARTBEAT_INTERVAL_MS);
+    }
+}
+
+void RoomHub::markFeedback(ClientCtx* c) {
+    feedbackPending_.insert(c);
+    if (feedbackScheduled_) return;
+    feedbackScheduled_ = true;
+    QTimer::singleShot(ACK_BATCH_MS, this, &RoomHub::flushFeedback);
+}
+
+void RoomHub::flushFeedback() {
+    feedbackScheduled_ = false;
+    const qint64 now = heartbeatClockUs() / 1000;
+    QSet<ClientCtx*> pending;
+    pending.swap(feedbackPending_);
+    for (ClientCtx* c : qAsConst(pending)) {
+        const QJsonObject ack = c->reliableRx.takeAck();
+        if (!ack.isEmpty()) sendTo(c, MSG_ACK, buildPacket(MSG_ACK, ack));
+        const QJsonObject nack = c->reliableRx.takeNack(now);
+        if (!nack.isEmpty()) sendTo(c, MSG_NACK, buildPacket(MSG_NACK, nack));
+        // 还有洞（可能只是发送端队列里的乱序）：下一轮再决定要不要 NACK
+        if (c->reliableRx.hasGaps()) markFeedback(c);
+    }
+}
+
+void RoomHub::sendHeartbeat(ClientCtx* c) {
+    QJsonObject j{{"hb", double(heartbeatClockUs())}};
+    if (c->rtt.hasSamples()) {
+        // 把测量结果告诉客户端，供它的码率控制使用（客户端不必自己再发心跳）
+        j["rtt"] = c->rtt.lastMs();
+        j["jitter"] = c->rtt.jitterMs();
+    }
+    sendTo(c, MSG_HEARTBEAT, buildPacket(MSG_HEARTBEAT, j));
+}
+
+void RoomHub::onBytesWritten() {
+    auto* sock = qobject_cast<QTcpSocket*>(sender());
+    if (!sock) return;
+    ClientCtx* c = clients_.value(sock, nullptr);
+    if (!c) return;
+    // socket 内部缓冲降下来了：交给出口调度继续补帧
+    if (!c->txq.isEmpty()) egress_.markReady(c);
+}
+
 void RoomHub::onReadyRead() {
     auto* sock = qobject_cast<QTcpSocket*>(sender());
     if (!sock) return;
@@ -62,19 +253,63 @@ void RoomHub::onReadyRead() {
     if (it == clients_.end()) return;
     ClientCtx* c = it.value();
 
-    static QHash<QTcpSocket*, QByteArray> buffers; // 简易 per-socket 缓冲
-    QByteArray& buf = buffers[sock];
-    buf.append(sock->readAll());
+    c->lastRxMs = heartbeatClockUs() / 1000; // 任何数据都算存活，不必等心跳应答
+    c->rx.readFrom(sock);
+    processIncoming(c, QVector<Packet>());
+}
 
-    QVector<Packet> pkts;
-    if (drainPackets(buf, pkts)) {
-        for (const Packet& p : pkts) {
-            handlePacket(c, p);
+void RoomHub::processIncoming(ClientCtx* c, QVector<Packet> pkts) {
+    QString error;
+    if (!c->rx.decode(pkts, &error)) {
+        qWarning() << "Dropping unparsable input from" << c->user << ":" << error;
+    }
+    for (int i = 0; i < pkts.size(); ++i) {
+        handlePacket(c, pkts[i]);
+        if (!c->pendingJoin.isEmpty()) {
+            // 目标房间属于其他分片：连同剩余帧一起迁移，之后不能再访问 c
+            handOff(c, pkts.mid(i + 1));
+            return;
         }
     }
 }
 
-void RoomHub::handlePacket(ClientCtx* c, const Packet& p) {
+void RoomHub::handlePacket(ClientCtx* c, Packet& p) {
+    // 心跳与认证无关：应答回显的是本服务器发出的时间戳
+    if (p.type == MSG_ACK && p.json().contains("hb")) {
+        c->rtt.addSample(heartbeatClockUs() - qint64(p.json().value("hb").toDouble()));
+        return;
+    }
+    if (p.type == MSG_HEARTBEAT) {
+        sendTo(c, MSG_ACK, buildPacket(MSG_ACK, QJsonObject{{"hb", p.json().value("hb")}}));
+        return;
+    }
+    // 下行可靠流的确认/重传请求
+    if (p.type == MSG_ACK) {
+        c->reliableTx.onAck(p.json());
+        return;
+    }
+    if (p.type == MSG_NACK) {
+        resendReliable(c, c->reliableTx.onNack(p.json()));
+        return;
+    }
+
+    // 断线重连：凭会话令牌恢复，不走数据库登录
+    if (p.type == MSG_RESUME_SESSION) {
+        handleResume(c, p);
+        return;
+    }
+
+    // 可靠流：收到即确认（之后的 401/403 等拒绝走事件通知，不靠重传）；
+    // 重传或重连后重发的重复帧只补 ACK，不再转发
+    if ((p.flags & FLAG_ACK_REQUIRED) && isReliableType(p.type)) {
+        const bool fresh = c->reliableRx.accept(p.type, p.seq, heartbeatClockUs() / 1000);
+        markFeedback(c);
+        if (!fresh) return;
+        // 上行到此确认完毕，先去掉标志；转发时 sendTo 按每个接收端的下行流重新编号并置标志
+        p.flags &= ~FLAG_ACK_REQUIRED;
+        stampFrameFlags(p.raw, p.flags);
+    }
+
     // 处理注册请求
     if (p.type == MSG_REGISTER) {
         handleRegister(c, p);
@@ -91,240 +326,441 @@ void RoomHub::handlePacket(ClientCtx* c, const Packet& p) {
     if (p.type == MSG_JOIN_WORKORDER) {
         if (!c->authenticated) {
             QJsonObject j{{"code",401},{"message","authentication required"}};
-            c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+            sendEvent(c, j);
             return;
         }
         
-        const QString roomId = p.json.value("roomId").toString();
-        const QString user   = p.json.value("user").toString();
+        const QString roomId = p.json().value("roomId").toString();
+        const QString user   = p.json().value("user").toString();
         if (roomId.isEmpty()) {
             QJsonObject j{{"code",400},{"message","roomId required"}};
-            c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+            sendEvent(c, j);
             return;
         }
         c->user = user;
-        joinRoom(c, roomId);
-        QJsonObject j{{"code",0},{"message","joined"},{"roomId",roomId}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
-        qInfo() << "Join" << roomId << "user" << (user.isEmpty() ? "(anonymous)" : user);
+        if (shardForRoom(roomId) != this) {
+            // 房间归其他分片所有：由 processIncoming 负责迁移连接，目标分片完成加入
+            c->pendingJoin = roomId;
+            return;
+        }
+        completeJoin(c, roomId);
         return;
     }
 
     // 其他操作也需要认证且加入房间
     if (!c->authenticated) {
         QJsonObject j{{"code",401},{"message","authentication required"}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+        sendEvent(c, j);
         return;
     }
 
     if (c->roomId.isEmpty()) {
         QJsonObject j{{"code",403},{"message","join a room first"}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+        sendEvent(c, j);
         return;
     }
 
     // 简单转发（同房间广播，排除发送者）
+    // 路由只依赖帧头（类型 + 连接所在房间），转发帧从不解析 JSON
     if (p.type == MSG_TEXT || p.type == MSG_DEVICE_DATA ||
         p.type == MSG_VIDEO_FRAME || p.type == MSG_AUDIO_FRAME ||
         p.type == MSG_CONTROL_CMD) {
-        // 保持原包结构，服务端不改内容
-        QByteArray raw = buildPacket(p.type, p.json, p.bin);
-        broadcastToRoom(c->roomId, raw, c->sock);
+        // 零拷贝转发：复用解码得到的原始帧，只改写头部的房间/发送者字段，
+        // 不重新编码 JSON、不复制负载；同一个缓冲区写给房间内所有成员
+        stampFrameHeader(p.raw, c->roomId, c->user);
+        if (p.type == MSG_VIDEO_FRAME && p.layer > 0) {
+            forwardLayeredVideo(c, p);
+            return;
+        }
+        if (recorder_) recorder_->record(c->roomId, p.raw); // 录制的就是转发出去的帧
+        broadcastToRoom(c->roomId, p.type, p.raw, c, p.flags);
         return;
     }
 
     // 未识别类型：回一个提示
     QJsonObject j{{"code",404},{"message",QString("unknown type %1").arg(p.type)}};
-    c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+    sendEvent(c, j);
+}
+
+void RoomHub::completeJoin(ClientCtx* c, const QString& roomId) {
+    joinRoom(c, roomId);
+    QJsonObject j{{"code",0},{"message","joined"},{"roomId",roomId}};
+    sendEvent(c, j);
+    if (!replays_.isEmpty()) startWaitingReplays(roomId);
+    qInfo() << "Join" << roomId << "user" << (c->user.isEmpty() ? "(anonymous)" : c->user)
+            << "shard" << shardIndex_;
 }
 
 void RoomHub::joinRoom(ClientCtx* c, const QString& roomId) {
     // 先从原房间移除
-    if (!c->roomId.isEmpty()) {
-        auto range = rooms_.equal_range(c->roomId);
-        for (auto i = range.first; i != range.second; ) {
-            if (i.value() == c->sock) i = rooms_.erase(i);
-            else ++i;
+    leaveRoom(c);
+    c->roomId = roomId;
+    rooms_.insert(roomId, c);
+    if (!c->txq.isEmpty()) egress_.markReady(c); // 积压的帧按新房间参与调度
+}
+
+void RoomHub::leaveRoom(ClientCtx* c) {
+    egress_.forget(c);
+    c->layerSel.clear();
+    if (c->roomId.isEmpty()) return;
+    auto range = rooms_.equal_range(c->roomId);
+    for (auto i = range.first; i != range.second; ) {
+        if (i.value() == c) {
+            i = rooms_.erase(i);
+        } else {
+            // 发布者离开：其他成员对它的选层状态作废，重新加入时从头选
+            i.value()->layerSel.remove(c->user);
+            ++i;
         }
     }
-    c->roomId = roomId;
-    rooms_.insert(roomId, c->sock);
+    c->roomId.clear();
 }
 
-void RoomHub::broadcastToRoom(const QString& roomId, const QByteArray& packet, QTcpSocket* except) {
+void RoomHub::broadcastToRoom(const QString& roomId, quint16 type,
+                              const QByteArray& packet, ClientCtx* except, quint16 flags) {
+    // 压缩帧原样转发给能解该编码的成员；其余成员收解压后的帧（整房间只解一次）
+    const quint32 codec = (flags & FLAG_COMPRESSED) ? codecBit(frameCodec(packet)) : 0;
+    QByteArray plain;
     auto range = rooms_.equal_range(roomId);
     for (auto i = range.first; i != range.second; ++i) {
-        QTcpSocket* s = i.value();
-        if (s == except) continue;
-        s->write(packet);
+        ClientCtx* member = i.value();
+        if (member == except) continue;
+        if (codec && !(member->acceptCodecs & codec)) {
+            if (plain.isNull()) plain = decompressFrame(packet);
+            if (plain.isEmpty()) continue; // 损坏的压缩帧
+            sendTo(member, type, plain, quint16(flags & ~FLAG_COMPRESSED));
+            continue;
+        }
+        sendTo(member, type, packet, flags);
     }
 }
 
-/* ---------- 用户认证系统 ---------- */
+// 分层视频不做整房间广播：每个订阅者按自己发送队列的积压选一层，
+// 同一个已改写头部的缓冲区只写给选中这一层的成员
+void RoomHub::forwardLayeredVideo(ClientCtx* publisher, const Packet& p) {
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const int layer = qMin<int>(p.layer, SIMULCAST_MAX_LAYERS);
+    publisher->videoLayers.onFrame(layer, now);
+    const quint32 active = publisher->videoLayers.activeLayers(now);
+    const bool switchPoint = !(p.flags & FLAG_DELTA_FRAME);
+    // 录制只留发布者当前最高的一层，回放时足够且不重复占空间
+    if (recorder_ && layer == 32 - qCountLeadingZeroBits(active)) {
+        recorder_->record(publisher->roomId, p.raw);
+    }
 
-bool RoomHub::initDatabase() {
-    db_ = QSqlDatabase::addDatabase("QSQLITE");
-    db_.setDatabaseName("industrial_remote_expert.db");
-    
-    if (!db_.open()) {
-        qCritical() << "Cannot open database:" << db_.lastError().text();
-        return false;
+    bool needKeyframe = false;
+    auto range = rooms_.equal_range(publisher->roomId);
+    for (auto i = range.first; i != range.second; ++i) {
+        ClientCtx* member = i.value();
+        if (member == publisher) continue;
+        SimulcastSelector& sel = member->layerSel[publisher->user];
+        const SimulcastSelector::Decision d =
+            sel.onFrame(layer, switchPoint, active, member->txq.queuedBytes(),
+                        member->txq.stats().droppedVideo, now);
+        if (d.forward) sendTo(member, MSG_VIDEO_FRAME, p.raw, p.flags);
+        needKeyframe = needKeyframe || d.needKeyframe;
     }
-    
-    // 创建用户表
-    QSqlQuery query(db_);
-    QString createUsersTable = R"(
-        CREATE TABLE IF NOT EXISTS users (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            username TEXT UNIQUE NOT NULL,
-            password_hash TEXT NOT NULL,
-            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
-        )
-    )";
-    
-    if (!query.exec(createUsersTable)) {
-        qCritical() << "Failed to create users table:" << query.lastError().text();
-        return false;
+
+    // 有订阅者在等目标层的关键帧：代为向发布者请求（与客户端的 keyframe_request 同格式）
+    if (needKeyframe && publisher->videoLayers.keyframeRequestDue(now)) {
+        QJsonObject j{{"cmd", "keyframe_request"}, {"target", publisher->user}, {"layer", layer}};
+        sendTo(publisher, MSG_CONTROL_CMD,
+               buildPacket(MSG_CONTROL_CMD, j, QByteArray(), publisher->roomId, QStringLiteral("server")));
     }
-    
-    // 创建会话表
-    QString createSessionsTable = R"(
-        CREATE TABLE IF NOT EXISTS sessions (
-            token TEXT PRIMARY KEY,
-            username TEXT NOT NULL,
-            created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
-            expires_at DATETIME NOT NULL,
-            FOREIGN KEY (username) REFERENCES users (username)
-        )
-    )";
-    
-    if (!query.exec(createSessionsTable)) {
-        qCritical() << "Failed to create sessions table:" << query.lastError().text();
-        return false;
+}
+
+/* ---------- 录制回放 ---------- */
+
+void RoomHub::startReplay(const QString& path, const QString& roomId, double speed) {
+    RoomHub* owner = shardForRoom(roomId);
+    if (owner != this) {
+        QMetaObject::invokeMethod(owner, [owner, path, roomId, speed]() {
+            owner->startReplay(path, roomId, speed);
+        }, Qt::QueuedConnection);
+        return;
     }
-    
-    qInfo() << "Database initialized successfully";
-    return true;
+    auto* replayer = new RoomReplayer(roomId, speed, this);
+    QString error;
+    if (!replayer->open(path, &error)) {
+        qCWarning(logRecording) << "replay failed:" << error;
+        delete replayer;
+        return;
+    }
+    replays_.append(replayer);
+    qCInfo(logRecording) << "replay" << path << "queued for room" << roomId << "shard" << shardIndex_;
+    // 房间里还没人时等第一个成员加入，否则开头的帧白白丢掉
+    if (rooms_.contains(roomId)) startWaitingReplays(roomId);
 }
 
-bool RoomHub::registerUser(const QString& username, const QString& password) {
-    if (username.isEmpty() || password.isEmpty()) {
-        return false;
+void RoomHub::startWaitingReplays(const QString& roomId) {
+    for (RoomReplayer* r : qAsConst(replays_)) {
+        if (r->roomId() != roomId || r->state() != RoomReplayer::Waiting) continue;
+        // 走普通广播路径：压缩帧按成员能力转发，背压和丢帧策略与实时转发一致
+        r->start([this, roomId](quint16 type, const QByteArray& frame, quint16 flags) {
+            broadcastToRoom(roomId, type, frame, nullptr, flags);
+        });
     }
-    
-    // 简单的密码哈希（实际项目中应使用更安全的方法）
-    QString passwordHash = QString(QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha256).toHex());
-    
-    QSqlQuery query(db_);
-    query.prepare("INSERT INTO users (username, password_hash) VALUES (?, ?)");
-    query.addBindValue(username);
-    query.addBindValue(passwordHash);
-    
-    if (!query.exec()) {
-        qWarning() << "Failed to register user:" << query.lastError().text();
-        return false;
+}
+
+/* ---------- 发送队列（背压） ---------- */
+
+void RoomHub::sendTo(ClientCtx* c, quint16 type, const QByteArray& packet, quint16 flags) {
+    if (isReliableType(type)) {
+        // 控制/文本下行也可靠：每个接收端一条流，帧保留到它确认（共享的转发缓冲在这里分离，只拷小帧）
+        ReliableFrame f;
+        f.type = type;
+        f.seq = c->reliableTx.nextSeq(type);
+        f.flags = flags | FLAG_ACK_REQUIRED;
+        f.frame = packet;
+        stampFrameSeq(f.frame, f.seq);
+        stampFrameFlags(f.frame, frameFlags(f.frame) | FLAG_ACK_REQUIRED);
+        c->reliableTx.store(f);
+        resendReliable(c, QVector<ReliableFrame>{f});
+        return;
     }
-    
-    qInfo() << "User registered successfully:" << username;
-    return true;
+    // 不直接 write：socket 缓冲超出预算时帧留在队列里，慢连接优先丢旧视频/音频
+    c->txq.enqueue(type, packet, flags);
+    if (SendQueue::classify(type, flags) == CLASS_CONTROL) {
+        // 控制类不等调度轮次，立即写到队首（只受 socket 缓冲预算限制）
+        c->txq.pump(c->sock, packet.size());
+    }
+    if (!c->txq.isEmpty()) egress_.markReady(c);
 }
 
-QString RoomHub::loginUser(const QString& username, const QString& password) {
-    if (username.isEmpty() || password.isEmpty()) {
-        return QString();
+void RoomHub::resendReliable(ClientCtx* c, const QVector<ReliableFrame>& frames) {
+    for (const ReliableFrame& f : frames) {
+        c->txq.enqueue(f.type, f.frame, f.flags);
+        if (SendQueue::classify(f.type, f.flags) == CLASS_CONTROL) c->txq.pump(c->sock, f.frame.size());
     }
-    
-    QString passwordHash = QString(QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha256).toHex());
-    
-    QSqlQuery query(db_);
-    query.prepare("SELECT username FROM users WHERE username = ? AND password_hash = ?");
-    query.addBindValue(username);
-    query.addBindValue(passwordHash);
-    
-    if (!query.exec() || !query.next()) {
-        qWarning() << "Login failed for user:" << username;
-        return QString();
+    if (!c->txq.isEmpty()) egress_.markReady(c);
+}
+
+void RoomHub::sendEvent(ClientCtx* c, const QJsonObject& j) {
+    sendTo(c, MSG_SERVER_EVENT, compressFrame(buildPacket(MSG_SERVER_EVENT, j), c->compression));
+}
+
+QJsonArray RoomHub::clientStats() const {
+    QJsonArray out;
+    for (ClientCtx* c : clients_) {
+        QJsonObject o = c->txq.statsJson();
+        o["user"] = c->user;
+        o["roomId"] = c->roomId;
+        o["socketBytesToWrite"] = c->sock->bytesToWrite();
+        const QJsonObject rtt = c->rtt.toJson();
+        for (auto it = rtt.constBegin(); it != rtt.constEnd(); ++it) o[it.key()] = it.value();
+        o["idleMs"] = heartbeatClockUs() / 1000 - c->lastRxMs;
+        const ReliableReceiver::Stats& rs = c->reliableRx.stats();
+        o["reliableReceived"] = qint64(rs.received);
+        o["reliableDuplicates"] = qint64(rs.duplicates);
+        o["reliableNacked"] = qint64(rs.nacked);
+        const ReliableSender::Stats& ts = c->reliableTx.stats();
+        o["reliableTxUnacked"] = c->reliableTx.size();
+        o["reliableTxRetransmitted"] = qint64(ts.retransmitted);
+        o["reliableTxOverflow"] = qint64(ts.overflow);
+        if (!c->layerSel.isEmpty()) {
+            QJsonObject layers; // 发布者 -> 当前转发给该连接的视频层
+            for (auto it = c->layerSel.constBegin(); it != c->layerSel.constEnd(); ++it) {
+                layers[it.key()] = it.value().currentLayer();
+            }
+            o["videoLayers"] = layers;
+        }
+        out.append(o);
     }
-    
-    // 生成会话令牌
-    QString token = generateSessionToken();
-    
-    // 存储会话（24小时有效期）
-    QSqlQuery sessionQuery(db_);
-    sessionQuery.prepare("INSERT INTO sessions (token, username, expires_at) VALUES (?, ?, datetime('now', '+24 hours'))");
-    sessionQuery.addBindValue(token);
-    sessionQuery.addBindValue(username);
-    
-    if (!sessionQuery.exec()) {
-        qWarning() << "Failed to create session:" << sessionQuery.lastError().text();
-        return QString();
+    return out;
+}
+
+void RoomHub::setStatsFile(const QString& path) {
+    statsFile_ = path;
+}
+
+void RoomHub::setRoomWeight(const QString& roomId, int weight) {
+    egress_.setRoomWeight(roomId, weight);
+}
+
+void RoomHub::writeStatsFile() {
+    // 分片级 RTT 汇总：一眼看出是否有连接链路变差，明细在 clients[] 里
+    QVector<double> srtt;
+    double maxJitter = 0;
+    for (ClientCtx* c : clients_) {
+        if (!c->rtt.hasSamples()) continue;
+        srtt.append(c->rtt.srttMs());
+        maxJitter = qMax(maxJitter, c->rtt.jitterMs());
     }
-    
-    qInfo() << "User logged in successfully:" << username;
-    return token;
+    QJsonObject rtt{{"clients", srtt.size()}};
+    if (!srtt.isEmpty()) {
+        std::sort(srtt.begin(), srtt.end());
+        rtt["medianMs"] = qRound(srtt.at(srtt.size() / 2) * 100) / 100.0;
+        rtt["maxMs"] = qRound(srtt.last() * 100) / 100.0;
+        rtt["maxJitterMs"] = qRound(maxJitter * 100) / 100.0;
+    }
+    QJsonObject doc{{"shard", shardIndex_},
+                    {"timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs)},
+                    {"rtt", rtt},
+                    {"clients", clientStats()}};
+    QSaveFile file(statsFile_);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(logRoomHub) << "cannot write stats" << statsFile_ << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(doc).toJson());
+    if (!file.commit()) qCWarning(logRoomHub) << "cannot write stats" << statsFile_ << file.errorString();
+}
+
+void RoomHub::onStatsTimer() {
+    if (!statsFile_.isEmpty()) writeStatsFile();
+
+    // 只记录有积压或丢帧的连接，避免刷屏
+    for (ClientCtx* c : clients_) {
+        const SendQueue::Stats& st = c->txq.stats();
+        if (st.queuedFrames == 0 && st.droppedVideo == 0 && st.droppedAudio == 0) continue;
+        qCInfo(logRoomHub) << "tx" << c->user << c->roomId
+                           << "queued" << st.queuedFrames << "frames" << st.queuedBytes << "bytes"
+                           << "dropped video" << st.droppedVideo << "audio" << st.droppedAudio;
+    }
+}
+
+/* ---------- 用户认证系统（异步，见 AuthService） ---------- */
+
+void RoomHub::setAuthService(AuthService* auth) {
+    auth_ = auth;
+}
+
+void RoomHub::setRecorder(RoomRecorder* recorder) {
+    recorder_ = recorder;
 }
 
-bool RoomHub::validateSessionToken(const QString& token) {
+/* ---------- 会话恢复 ---------- */
+
+void RoomHub::handleResume(ClientCtx* c, const Packet& p) {
+    const QString roomId = p.json().value("roomId").toString();
+    if (!roomId.isEmpty() && shardForRoom(roomId) != this) {
+        // 暂存的上下文在房间所属分片：复用加入房间的迁移路径，到那边再恢复
+        c->pendingResume = p.json();
+        c->pendingJoin = roomId;
+        return;
+    }
+    completeResume(c, p.json());
+}
+
+void RoomHub::completeResume(ClientCtx* c, const QJsonObject& req) {
+    const QString token = req.value("token").toString();
     if (token.isEmpty()) {
-        return false;
+        sendEvent(c, QJsonObject{{"code", 400}, {"message", "resume failed"}});
+        return;
     }
-    
-    QSqlQuery query(db_);
-    query.prepare("SELECT username FROM sessions WHERE token = ? AND expires_at > datetime('now')");
-    query.addBindValue(token);
-    
-    if (!query.exec() || !query.next()) {
-        return false;
+
+    // 客户端往往先于服务器发现断线：旧连接还在就踢掉，它的上下文随即进入暂存
+    const QList<ClientCtx*> live = clients_.values();
+    for (ClientCtx* other : live) {
+        if (other != c && other->authenticated && other->sessionToken == token) {
+            QTcpSocket* sock = other->sock;
+            sock->abort();
+            removeClient(sock);
+        }
     }
-    
-    return true;
+
+    QString roomId;
+    bool restored = false;
+    if (ClientCtx* parked = parked_.take(token)) {
+        liveness_.cancel(parked);
+        c->user = parked->user;
+        c->reliableRx = parked->reliableRx;
+        c->reliableTx = parked->reliableTx;
+        c->rtt = parked->rtt;
+        roomId = parked->resumeRoom;
+        delete parked;
+        restored = true;
+    } else {
+        // 宽限期已过或服务器重启过：令牌在内存会话表里仍有效，就直接认证并加入
+        const AuthService::Result r = auth_ ? auth_->validateSessionToken(token) : AuthService::Result();
+        if (!r.ok) {
+            sendEvent(c, QJsonObject{{"code", 401}, {"message", "resume failed"}});
+            return;
+        }
+        c->user = req.value("user").toString(r.username);
+        roomId = req.value("roomId").toString();
+    }
+    c->authenticated = true;
+    c->sessionToken = token;
+    if (!roomId.isEmpty()) joinRoom(c, roomId);
+
+    quint32 acceptCodecs = 0;
+    const CompressionCodec codec = negotiateCompression(req.value("compress").toArray(), &acceptCodecs);
+    QJsonObject reply{{"code", 0}, {"message", "resumed"}, {"roomId", roomId}, {"restored", restored}};
+    // 恢复时告诉客户端每个可靠流已收到哪里，它从下一条开始重发
+    if (restored) reply["ack"] = c->reliableRx.takeAck(true).value("ack");
+    if (codec != CODEC_NONE) reply["compress"] = compressionCodecName(codec);
+    sendEvent(c, reply);
+    c->compression = codec;
+    c->acceptCodecs = acceptCodecs;
+    if (restored) {
+        // 断线前发给它、还没确认的控制/文本：按它报告的各流接收位置丢掉已收到的，其余原序号补发
+        c->reliableTx.onAck(req);
+        const QVector<ReliableFrame> replay = c->reliableTx.unacked();
+        resendReliable(c, replay);
+        if (!replay.isEmpty()) qInfo() << "Resume" << c->user << "replaying" << replay.size() << "control/text frames";
+    }
+
+    qInfo() << "Resume" << c->user << "room" << roomId << (restored ? "(restored)" : "(token only)")
+            << "shard" << shardIndex_;
+    if (!roomId.isEmpty() && !replays_.isEmpty()) startWaitingReplays(roomId);
 }
 
-QString RoomHub::generateSessionToken() {
-    // 生成随机会话令牌
-    QByteArray token = QUuid::createUuid().toByteArray().toBase64();
-    return QString(token).remove('=').remove('+').remove('/');
+ClientCtx* RoomHub::clientFor(const QPointer<QTcpSocket>& sock) const {
+    // 认证结果异步返回时连接可能已断开或已迁移到其他分片
+    return sock ? clients_.value(sock.data(), nullptr) : nullptr;
 }
 
 void RoomHub::handleRegister(ClientCtx* c, const Packet& p) {
-    QString username = p.json.value("username").toString();
-    QString password = p.json.value("password").toString();
+    QString username = p.json().value("username").toString();
+    QString password = p.json().value("password").toString();
     
     if (username.isEmpty() || password.isEmpty()) {
         QJsonObject response{{"code", 400}, {"message", "username and password required"}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
+        sendEvent(c, response);
         return;
     }
     
-    if (registerUser(username, password)) {
-        QJsonObject response{{"code", 0}, {"message", "registration successful"}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
-    } else {
-        QJsonObject response{{"code", 409}, {"message", "username already exists or registration failed"}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
-    }
+    QPointer<QTcpSocket> sock(c->sock);
+    auth_->registerUser(username, password, this, c->sock, [this, sock](const AuthService::Result& r) {
+        ClientCtx* c = clientFor(sock);
+        if (!c) return;
+        QJsonObject response{{"code", r.code}, {"message", r.message}};
+        sendEvent(c, response);
+    });
 }
 
 void RoomHub::handleLogin(ClientCtx* c, const Packet& p) {
-    QString username = p.json.value("username").toString();
-    QString password = p.json.value("password").toString();
+    QString username = p.json().value("username").toString();
+    QString password = p.json().value("password").toString();
     
     if (username.isEmpty() || password.isEmpty()) {
         QJsonObject response{{"code", 400}, {"message", "username and password required"}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
+        sendEvent(c, response);
         return;
     }
     
-    QString token = loginUser(username, password);
-    if (!token.isEmpty()) {
-        c->authenticated = true;
-        c->sessionToken = token;
-        c->user = username;
-        
-        QJsonObject response{{"code", 0}, {"message", "login successful"}, {"token", token}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
-    } else {
-        QJsonObject response{{"code", 401}, {"message", "invalid username or password"}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
-    }
+    // 压缩协商：客户端在 "compress" 里按偏好列出能解的编码
+    quint32 acceptCodecs = 0;
+    const CompressionCodec codec = negotiateCompression(p.json().value("compress").toArray(), &acceptCodecs);
+
+    QPointer<QTcpSocket> sock(c->sock);
+    auth_->loginUser(username, password, this, c->sock, [this, sock, codec, acceptCodecs](const AuthService::Result& r) {
+        ClientCtx* c = clientFor(sock);
+        if (!c) return;
+        if (r.ok) {
+            c->authenticated = true;
+            c->sessionToken = r.token;
+            c->user = r.username;
+            
+            QJsonObject response{{"code", 0}, {"message", "login successful"}, {"token", r.token}};
+            if (codec != CODEC_NONE) response["compress"] = compressionCodecName(codec);
+            sendEvent(c, response); // 本条仍不压缩：客户端收到它才开始启用
+            c->compression = codec;
+            c->acceptCodecs = acceptCodecs;
+        } else {
+            QJsonObject response{{"code", r.code}, {"message", r.message}};
+            sendEvent(c, response);
+        }
+    });
 }
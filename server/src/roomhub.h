@@ -6,8 +6,18 @@
 // ===============================================
 #include <QtCore>
 #include <QtNetwork>
-#include <QtSql>
 #include "../../common/protocol.h"
+#include "../../common/sendqueue.h"
+#include "../../common/bufferpool.h"
+#include "../../common/compression.h"
+#include "../../common/heartbeat.h"
+#include "../../common/reliable.h"
+#include "authservice.h"
+#include "egressscheduler.h"
+#include "timerwheel.h"
+#include "simulcast.h"
+#include "roomrecorder.h"
+#include "roomreplayer.h"
 
 struct ClientCtx {
     QTcpSocket* sock = nullptr;
@@ -15,41 +25,107 @@ struct ClientCtx {
     QString roomId;     // 当前加入的房间；空字符串表示未加入任何房间
     QString sessionToken; // 登录会话令牌
     bool authenticated = false; // 是否已认证
+    CompressionCodec compression = CODEC_NONE; // 登录时协商：服务器发给它的帧用哪种压缩
+    quint32 acceptCodecs = 0;   // 它能解的压缩编码（codecBit 掩码），决定压缩帧能否原样转发
+    RecvBuffer rx;      // 接收缓冲（池化块，原地拆帧），随连接一起迁移分片，析构时归还池
+    QString pendingJoin; // 非空表示要加入的房间属于其他分片，等待迁移
+    QJsonObject pendingResume; // 非空：迁移到 pendingJoin 所属分片后完成会话恢复
+    QString resumeRoom;  // 断线暂存期间记住的房间（sock 为空表示处于暂存）
+    SendQueue txq;      // 发送队列：严格优先级 + 字节预算背压，超限先丢旧视频再丢音频
+    SimulcastSource videoLayers;                  // 作为发布者：最近在发的视频层
+    QHash<QString, SimulcastSelector> layerSel;   // 作为订阅者：发布者用户名 -> 选层状态
+    qint64 lastRxMs = 0; // 最近一次收到数据（heartbeatClockUs 毫秒），判定存活
+    RttEstimator rtt;    // 服务器心跳测得的往返时延/抖动
+    ReliableReceiver reliableRx; // 控制/文本可靠流：去重 + 待回的 ACK/NACK
+    ReliableSender reliableTx;   // 发给它的控制/文本：逐连接编号，保留到它确认
 };
 
 class RoomHub : public QObject {
     Q_OBJECT
 public:
     explicit RoomHub(QObject* parent=nullptr);
-    bool start(quint16 port);
+    bool start(quint16 port); // 单线程模式：自己监听端口
+    void setAuthService(AuthService* auth); // 认证线程池（多个分片共享）
+    void setRecorder(RoomRecorder* recorder); // 可选：录制转发的帧（多个分片共享）
+
+    // 分片模式（由 HubServer 驱动，每个分片一个线程）
+    void setShards(int index, const QVector<RoomHub*>& shards); // 启动线程前调用
+    void adoptSocket(qintptr socketDescriptor); // 在分片线程内接管新连接
+
+    // 把录制回放到房间（任意分片上调用，转交房间所属分片）；房间有成员后才开始
+    void startReplay(const QString& path, const QString& roomId, double speed);
+
+    // 每个连接的发送队列深度/丢帧计数、RTT/抖动、可靠流计数
+    QJsonArray clientStats() const;
+    // 每个统计周期把 clientStats() 整体写到该文件（原子替换），空字符串关闭
+    void setStatsFile(const QString& path);
+    // 出口调度里该房间相对其他房间的份额（默认 1），见 EgressScheduler
+    void setRoomWeight(const QString& roomId, int weight);
 
 private slots:
     void onNewConnection();
     void onReadyRead();
     void onDisconnected();
+    void onBytesWritten();
+    void onStatsTimer();
+    void onLivenessTick();
+    void flushFeedback();
 
 private:
     QTcpServer server_;
+    QTimer statsTimer_; // 定期记录有积压/丢帧的连接，并导出 statsFile_
+    QString statsFile_;
+    EgressScheduler egress_; // 房间间加权公平的出口调度
+    QTimer livenessTimer_;   // 驱动时间轮
+    TimerWheel liveness_;    // 每个连接一个条目：到点发心跳 / 判定静默超时
+    QSet<ClientCtx*> feedbackPending_; // 欠 ACK/NACK 的连接，攒一小段时间一起回
+    // 已认证连接断线后暂存的上下文（会话令牌 -> ctx），宽限期内重连可一次往返恢复
+    QHash<QString, ClientCtx*> parked_;
+    bool feedbackScheduled_ = false;
     // 连接索引：socket -> ClientCtx
     QHash<QTcpSocket*, ClientCtx*> clients_;
-    // 房间索引：roomId -> sockets（允许多人）
-    QMultiHash<QString, QTcpSocket*> rooms_;
+    // 房间索引：roomId -> 成员（允许多人）
+    QMultiHash<QString, ClientCtx*> rooms_;
     
-    // 数据库连接
-    QSqlDatabase db_;
+    // 认证服务：数据库操作不在本线程执行
+    AuthService* auth_ = nullptr;
+    RoomRecorder* recorder_ = nullptr;
+    QVector<RoomReplayer*> replays_; // 结束后也保留：映射的帧可能还在发送队列里
+
+    // 分片信息：shards_ 为空表示单线程模式；房间按 roomId 哈希固定归属某个分片
+    int shardIndex_ = 0;
+    QVector<RoomHub*> shards_;
 
-    void handlePacket(ClientCtx* c, const Packet& p);
+    void addClient(QTcpSocket* sock);
+    void writeStatsFile();
+    void removeClient(QTcpSocket* sock);
+    void parkClient(ClientCtx* c);
+    void watchSocket(QTcpSocket* sock);
+    void processIncoming(ClientCtx* c, QVector<Packet> pkts);
+    void handlePacket(ClientCtx* c, Packet& p); // 可原地改写 p.raw 头部用于转发
+    RoomHub* shardForRoom(const QString& roomId) const;
+    void handOff(ClientCtx* c, const QVector<Packet>& pending);  // 迁出到房间所属分片
+    void adoptClient(ClientCtx* c, QVector<Packet> pending);     // 在目标分片线程内接管
+    void completeJoin(ClientCtx* c, const QString& roomId);
     void joinRoom(ClientCtx* c, const QString& roomId);
+    void leaveRoom(ClientCtx* c);
+    void startWaitingReplays(const QString& roomId);
     void broadcastToRoom(const QString& roomId,
+                         quint16 type,
                          const QByteArray& packet,
-                         QTcpSocket* except = nullptr);
+                         ClientCtx* except = nullptr,
+                         quint16 flags = FLAG_NONE);
+    void forwardLayeredVideo(ClientCtx* publisher, const Packet& p); // 分层视频：每个订阅者只收一层
+    void sendTo(ClientCtx* c, quint16 type, const QByteArray& packet, quint16 flags = FLAG_NONE);
+    void resendReliable(ClientCtx* c, const QVector<ReliableFrame>& frames); // 原样重发，不重新编号
+    void sendEvent(ClientCtx* c, const QJsonObject& j);
+    void sendHeartbeat(ClientCtx* c);
+    void markFeedback(ClientCtx* c);
     
-    // 用户认证相关方法
-    bool initDatabase();
-    bool registerUser(const QString& username, const QString& password);
-    QString loginUser(const QString& username, const QString& password);
-    bool validateSessionToken(const QString& token);
-    QString generateSessionToken();
+    // 用户认证相关方法（结果异步回到本线程）
+    ClientCtx* clientFor(const QPointer<QTcpSocket>& sock) const;
     void handleRegister(ClientCtx* c, const Packet& p);
     void handleLogin(ClientCtx* c, const Packet& p);
+    void handleResume(ClientCtx* c, const Packet& p);
+    void completeResume(ClientCtx* c, const QJsonObject& req);
 };
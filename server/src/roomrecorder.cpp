@@ -0,0 +1,263 @@
+#include "roomrecorder.h"
+#include "segmentformat.h"
+#include "../../common/protocol.h"
+#include <QtEndian>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+static const qint64 RECORD_QUEUE_MAX_BYTES = 64 * 1024 * 1024; // 写线程落后超过这么多就丢帧
+static const qint64 SYNC_MAX_BYTES = 8 * 1024 * 1024;          // 未同步字节达到此值提前 fdatasync
+static const qint64 SEGMENT_MAX_AGE_MS = 10 * 60 * 1000;
+static const qint64 SEGMENT_IDLE_CLOSE_MS = 60 * 1000;         // 房间无帧这么久就关闭段文件
+static const qint64 INDEX_INTERVAL_MS = 1000;
+static const qint64 INDEX_INTERVAL_BYTES = 1024 * 1024;
+
+static void writeFileHeader(QFile& file, const char magic[8])
+{
+    char header[SEGMENT_FILE_HEADER_SIZE] = {};
+    memcpy(header, magic, 8);
+    qToLittleEndian<quint32>(SEGMENT_VERSION, header + 8);
+    file.write(header, sizeof(header));
+}
+
+static bool syncFile(QFile& file)
+{
+    if (!file.flush()) return false;
+#ifdef Q_OS_UNIX
+    return ::fdatasync(file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+RoomRecorder::RoomRecorder(const QString& dir, qint64 segmentBytes, int syncIntervalMs)
+    : dir_(dir)
+    , segmentBytes_(qMax<qint64>(1024 * 1024, segmentBytes))
+    , syncIntervalMs_(qMax(10, syncIntervalMs))
+{
+}
+
+RoomRecorder::~RoomRecorder()
+{
+    stop();
+}
+
+bool RoomRecorder::start()
+{
+    if (thread_) return true;
+    if (!QDir().mkpath(dir_)) {
+        qCWarning(logRecording) << "cannot create recording directory" << dir_;
+        return false;
+    }
+    stopping_ = false;
+    thread_ = QThread::create([this]() { run(); });
+    thread_->setObjectName("recorder");
+    thread_->start();
+    qCInfo(logRecording) << "recording rooms to" << QDir(dir_).absolutePath();
+    return true;
+}
+
+void RoomRecorder::stop()
+{
+    if (!thread_) return;
+    {
+        QMutexLocker lock(&mutex_);
+        stopping_ = true;
+        cond_.wakeAll();
+    }
+    thread_->wait();
+    delete thread_;
+    thread_ = nullptr;
+}
+
+void RoomRecorder::record(const QString& roomId, const QByteArray& frame)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QMutexLocker lock(&mutex_);
+    if (stopping_ || !thread_) return;
+    if (queuedBytes_ + frame.size() > RECORD_QUEUE_MAX_BYTES) {
+        stats_.dropped++;
+        if (!dropping_) {
+            dropping_ = true;
+            qCWarning(logRecording) << "writer behind by" << queuedBytes_ << "bytes, dropping frames";
+        }
+        return;
+    }
+    dropping_ = false;
+    Pending p;
+    p.roomId = roomId;
+    p.frame = frame;
+    p.arrivalMs = now;
+    queue_.append(p);
+    queuedBytes_ += frame.size();
+    if (queue_.size() == 1) cond_.wakeOne();
+}
+
+RoomRecorder::Stats RoomRecorder::stats() const
+{
+    QMutexLocker lock(&mutex_);
+    return stats_;
+}
+
+void RoomRecorder::run()
+{
+    QElapsedTimer sinceSync;
+    sinceSync.start();
+    QVector<Pending> batch;
+    for (;;) {
+        bool stopping;
+        {
+            QMutexLocker lock(&mutex_);
+            if (queue_.isEmpty() && !stopping_) cond_.wait(&mutex_, syncIntervalMs_);
+            batch.swap(queue_);
+            queuedBytes_ = 0;
+            stopping = stopping_;
+        }
+
+        quint64 bytes = 0;
+        for (const Pending& p : qAsConst(batch)) {
+            writeRecord(p);
+            bytes += p.frame.size();
+        }
+        unsyncedBytes_ += bytes;
+        {
+            QMutexLocker lock(&mutex_);
+            stats_.frames += batch.size();
+            stats_.bytes += bytes;
+        }
+        batch.clear();
+
+        // 批量同步：按时间间隔或未同步字节数，而不是每帧一次
+        if (sinceSync.elapsed() >= syncIntervalMs_ || unsyncedBytes_ >= SYNC_MAX_BYTES || stopping) {
+            syncAll();
+            closeIdle(QDateTime::currentMSecsSinceEpoch());
+            sinceSync.restart();
+        }
+
+        if (stopping) {
+            QMutexLocker lock(&mutex_);
+            if (queue_.isEmpty()) break;
+        }
+    }
+
+    for (Segment* seg : qAsConst(segments_)) {
+        closeSegment(seg);
+        delete seg;
+    }
+    segments_.clear();
+}
+
+void RoomRecorder::writeRecord(const Pending& p)
+{
+    Segment*& seg = segments_[p.roomId];
+    if (!seg) seg = new Segment;
+
+    const qint64 recordSize = SEGMENT_RECORD_HEADER_SIZE + p.frame.size();
+    const bool full = seg->data.isOpen() && seg->data.pos() > SEGMENT_FILE_HEADER_SIZE &&
+                      seg->data.pos() + recordSize > segmentBytes_;
+    const bool old = seg->data.isOpen() && p.arrivalMs - seg->openedMs >= SEGMENT_MAX_AGE_MS;
+    if (full || old) closeSegment(seg);
+    if (!seg->data.isOpen() && !openSegment(p.roomId, seg, p.arrivalMs)) return;
+
+    const qint64 offset = seg->data.pos();
+    if (offset == SEGMENT_FILE_HEADER_SIZE ||
+        p.arrivalMs - seg->lastIndexMs >= INDEX_INTERVAL_MS ||
+        offset - seg->lastIndexOffset >= INDEX_INTERVAL_BYTES) {
+        SegmentIndexEntry entry;
+        entry.arrivalMs = qToLittleEndian(p.arrivalMs);
+        entry.recordNo = qToLittleEndian(seg->nextRecordNo);
+        entry.offset = qToLittleEndian(quint64(offset));
+        seg->index.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        seg->lastIndexMs = p.arrivalMs;
+        seg->lastIndexOffset = offset;
+    }
+
+    char header[SEGMENT_RECORD_HEADER_SIZE];
+    qToLittleEndian<qint64>(p.arrivalMs, header);
+    qToLittleEndian<quint32>(quint32(p.frame.size()), header + 8);
+    if (seg->data.write(header, sizeof(header)) != sizeof(header) ||
+        seg->data.write(p.frame) != p.frame.size()) {
+        qCWarning(logRecording) << "write failed for room" << p.roomId << seg->data.errorString();
+        closeSegment(seg); // 下一帧重新开段，半条记录留在旧段尾部，读取时会被忽略
+        return;
+    }
+    seg->nextRecordNo++;
+    seg->lastWriteMs = p.arrivalMs;
+    seg->dirty = true;
+}
+
+bool RoomRecorder::openSegment(const QString& roomId, Segment* seg, qint64 nowMs)
+{
+    const QString roomDir = QDir(dir_).filePath(segmentRoomDirName(roomId));
+    QDir().mkpath(roomDir);
+    QFile roomFile(QDir(roomDir).filePath(SEGMENT_ROOM_FILE));
+    if (!roomFile.exists() && roomFile.open(QIODevice::WriteOnly)) {
+        // 目录名可能被清洗过：真实 roomId 另存，回放时默认注入回这个房间
+        roomFile.write(roomId.toUtf8());
+        roomFile.close();
+    }
+    const QString base = QString("%1/%2-%3")
+        .arg(roomDir, QDateTime::fromMSecsSinceEpoch(nowMs).toString("yyyyMMdd-HHmmss-zzz"))
+        .arg(seg->nextRecordNo);
+    seg->data.setFileName(base + ".rec");
+    seg->index.setFileName(base + ".idx");
+    if (!seg->data.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        !seg->index.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(logRecording) << "cannot open segment" << base << seg->data.errorString();
+        seg->data.close();
+        seg->index.close();
+        return false;
+    }
+    writeFileHeader(seg->data, SEGMENT_MAGIC);
+    writeFileHeader(seg->index, SEGMENT_INDEX_MAGIC);
+    seg->openedMs = nowMs;
+    seg->lastIndexMs = 0;
+    seg->lastIndexOffset = 0;
+    {
+        QMutexLocker lock(&mutex_);
+        stats_.segments++;
+    }
+    qCInfo(logRecording) << "room" << roomId << "segment" << seg->data.fileName();
+    return true;
+}
+
+void RoomRecorder::closeSegment(Segment* seg)
+{
+    if (!seg->data.isOpen()) return;
+    if (seg->dirty) {
+        syncFile(seg->data);
+        syncFile(seg->index);
+        seg->dirty = false;
+    }
+    seg->data.close();
+    seg->index.close();
+}
+
+void RoomRecorder::syncAll()
+{
+    quint64 synced = 0;
+    for (Segment* seg : qAsConst(segments_)) {
+        if (!seg->dirty) continue;
+        if (!syncFile(seg->data) || !syncFile(seg->index)) {
+            qCWarning(logRecording) << "fdatasync failed for" << seg->data.fileName();
+        }
+        seg->dirty = false;
+        synced++;
+    }
+    unsyncedBytes_ = 0;
+    if (synced) {
+        QMutexLocker lock(&mutex_);
+        stats_.syncs++;
+    }
+}
+
+// 只关文件，保留 Segment 对象：房间再有帧时新开段，录制序号继续递增
+void RoomRecorder::closeIdle(qint64 nowMs)
+{
+    for (Segment* seg : qAsConst(segments_)) {
+        if (seg->data.isOpen() && nowMs - seg->lastWriteMs >= SEGMENT_IDLE_CLOSE_MS) {
+            closeSegment(seg);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+// ===============================================
+// server/src/roomrecorder.h
+// 房间录制：把转发的每一帧原样追加写入段文件，供审计和回放（格式见 segmentformat.h）
+// - record() 在分片线程里调用，只把共享的帧缓冲放进队列，不拷贝、不做 I/O；
+//   队列超过字节上限时丢弃新帧并计数，转发路径永不阻塞
+// - 专用写线程批量写入，按时间/字节间隔批量 fdatasync
+// - 段按大小/时长滚动，房间空闲一段时间后关闭其段文件
+// ===============================================
+#include <QtCore>
+
+class RoomRecorder {
+public:
+    struct Stats {
+        quint64 frames = 0;     // 已写入
+        quint64 bytes = 0;
+        quint64 dropped = 0;    // 写线程跟不上被丢弃
+        quint64 syncs = 0;
+        quint64 segments = 0;
+    };
+
+    explicit RoomRecorder(const QString& dir,
+                          qint64 segmentBytes = 64 * 1024 * 1024,
+                          int syncIntervalMs = 1000);
+    ~RoomRecorder(); // 写完队列、同步并关闭所有段
+
+    bool start();
+    void stop();
+
+    // 任意线程；frame 是完整的线格式帧（QByteArray 隐式共享，之后不得原地修改）
+    void record(const QString& roomId, const QByteArray& frame);
+
+    Stats stats() const;
+    QString directory() const { return dir_; }
+
+private:
+    struct Pending {
+        QString roomId;
+        QByteArray frame;
+        qint64 arrivalMs = 0;
+    };
+    struct Segment { // 写线程独占
+        QFile data;
+        QFile index;
+        qint64 openedMs = 0;
+        qint64 lastWriteMs = 0;
+        quint64 nextRecordNo = 0;   // 跨段连续
+        qint64 lastIndexMs = 0;
+        qint64 lastIndexOffset = 0;
+        bool dirty = false;         // 有未 fdatasync 的数据
+    };
+
+    void run();
+    void writeRecord(const Pending& p);
+    bool openSegment(const QString& roomId, Segment* seg, qint64 nowMs);
+    void closeSegment(Segment* seg);
+    void syncAll();
+    void closeIdle(qint64 nowMs);
+
+    QString dir_;
+    qint64 segmentBytes_;
+    int syncIntervalMs_;
+
+    mutable QMutex mutex_;
+    QWaitCondition cond_;
+    QVector<Pending> queue_;
+    qint64 queuedBytes_ = 0;
+    bool stopping_ = false;
+    bool dropping_ = false;     // 只在开始丢帧时告警一次
+    Stats stats_;
+
+    QThread* thread_ = nullptr;
+    QHash<QString, Segment*> segments_; // roomId -> 当前段，写线程独占
+    qint64 unsyncedBytes_ = 0;
+};
@@ -0,0 +1,155 @@
+#include "roomreplayer.h"
+#include "../../common/protocol.h"
+#include <QtEndian>
+
+// 不限速时每轮事件循环最多注入这么久，然后让出给 socket 读写和出口调度
+static const qint64 REPLAY_MAX_BATCH_MS = 5;
+// 帧头时间比到达时间多跳出这么多，视为发送端时钟异常
+static const qint64 REPLAY_CLOCK_SLACK_MS = 1000;
+// 计划时间到之前最长睡这么久（之后重新计算，避免长间隔里定时器漂移）
+static const qint64 REPLAY_MAX_SLEEP_MS = 1000;
+
+static bool readHeader(const QByteArray& frame, quint16* type, quint16* flags, quint64* timestampMs)
+{
+    if (frame.size() < int(sizeof(FrameHeader))) return false;
+    FrameHeader h;
+    memcpy(&h, frame.constData(), sizeof(h));
+    if (qFromBigEndian(h.magic) != PROTOCOL_MAGIC) return false;
+    *type = qFromBigEndian(h.msgType);
+    *flags = qFromBigEndian(h.flags);
+    *timestampMs = qFromBigEndian(h.timestampMs);
+    return true;
+}
+
+RoomReplayer::RoomReplayer(const QString& roomId, double speed, QObject* parent)
+    : QObject(parent)
+    , roomId_(roomId)
+    , speed_(speed)
+    , timer_(this)
+{
+    timer_.setSingleShot(true);
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, &RoomReplayer::pump);
+}
+
+bool RoomReplayer::open(const QString& path, QString* error)
+{
+    if (!reader_.open(path, error)) return false;
+    recordedRoomId_ = recordedRoomId(path);
+    haveNext_ = advance();
+    if (!haveNext_) {
+        if (error) *error = QString("%1: no frames recorded").arg(path);
+        return false;
+    }
+    return true;
+}
+
+void RoomReplayer::start(Sink sink)
+{
+    if (state_ != Waiting) return;
+    sink_ = std::move(sink);
+    state_ = Running;
+    clock_.start();
+    qCInfo(logRecording) << "replay of room" << recordedRoomId_ << "into room" << roomId_
+                         << (speed_ > 0 ? QString("at %1x").arg(speed_) : QString("at max speed"));
+    pump();
+}
+
+bool RoomReplayer::advance()
+{
+    quint64 timestampMs = 0;
+    while (reader_.next(&next_)) {
+        if (!readHeader(next_.frame, &nextType_, &nextFlags_, &timestampMs)) continue; // 跳过损坏记录
+        if (haveTimestamp_) {
+            qint64 step = qint64(timestampMs - lastTimestampMs_);
+            const qint64 arrivalStep = next_.arrivalMs - lastArrivalMs_;
+            if (step < 0) step = 0;
+            else if (step > arrivalStep + REPLAY_CLOCK_SLACK_MS) step = qMax<qint64>(0, arrivalStep);
+            mediaMs_ += step;
+        }
+        lastTimestampMs_ = haveTimestamp_ ? qMax(lastTimestampMs_, timestampMs) : timestampMs;
+        haveTimestamp_ = true;
+        lastArrivalMs_ = next_.arrivalMs;
+        return true;
+    }
+    return false;
+}
+
+void RoomReplayer::pump()
+{
+    const qint64 batchStart = clock_.elapsed();
+    while (haveNext_) {
+        const qint64 now = clock_.elapsed();
+        if (speed_ > 0) {
+            const qint64 due = qint64(mediaMs_ / speed_);
+            if (due > now) {
+                timer_.start(int(qMin(due - now, REPLAY_MAX_SLEEP_MS)));
+                return;
+            }
+            stats_.maxLagMs = qMax(stats_.maxLagMs, now - due);
+        } else if (now - batchStart >= REPLAY_MAX_BATCH_MS) {
+            timer_.start(0);
+            return;
+        }
+        if (recordedRoomId_ == roomId_) {
+            sink_(nextType_, next_.frame, nextFlags_);
+        } else {
+            const QByteArray frame = retarget(next_.frame);
+            sink_(nextType_, frame, frameFlags(frame));
+        }
+        stats_.frames++;
+        stats_.bytes += next_.frame.size();
+        stats_.mediaMs = mediaMs_;
+        haveNext_ = advance();
+    }
+    finish();
+}
+
+QByteArray RoomReplayer::retarget(const QByteArray& frame) const
+{
+    QVector<Packet> packets;
+    if (decodeFrames(frame.constData(), frame.size(), packets) != frame.size() || packets.size() != 1) {
+        return frame;
+    }
+    const Packet& p = packets.first();
+    QByteArray jsonBytes = p.jsonBytes();
+    if (p.json().contains("roomId")) {
+        QJsonObject json = p.json();
+        json["roomId"] = roomId_;
+        jsonBytes = toJsonBytes(json);
+    }
+    const QByteArray bin = p.bin();
+
+    // 保留原帧头（时间戳、序号、分层、发送者），只改长度和房间；压缩帧改写后以明文注入
+    QByteArray out;
+    out.reserve(int(sizeof(FrameHeader)) + jsonBytes.size() + bin.size());
+    out.append(frame.constData(), int(sizeof(FrameHeader)));
+    out.append(jsonBytes);
+    out.append(bin);
+    FrameHeader* h = reinterpret_cast<FrameHeader*>(out.data());
+    h->length = qToBigEndian(quint32(out.size()));
+    h->jsonSize = qToBigEndian(quint32(jsonBytes.size()));
+    h->flags = qToBigEndian(quint16(qFromBigEndian(h->flags) & ~FLAG_COMPRESSED));
+    stampFrameHeader(out, roomId_, p.senderId);
+    return out;
+}
+
+void RoomReplayer::finish()
+{
+    state_ = Finished;
+    stats_.elapsedMs = clock_.elapsed();
+    const double seconds = qMax<qint64>(1, stats_.elapsedMs) / 1000.0;
+    qCInfo(logRecording).noquote()
+        << QString("replay into room %1 done: %2 frames, %3 MB, %4 s of recording in %5 s "
+                   "(%6 frames/s, %7 MB/s, %8x realtime, max lag %9 ms)")
+               .arg(roomId_)
+               .arg(stats_.frames)
+               .arg(stats_.bytes / 1e6, 0, 'f', 1)
+               .arg(stats_.mediaMs / 1000.0, 0, 'f', 1)
+               .arg(seconds, 0, 'f', 2)
+               .arg(stats_.frames / seconds, 0, 'f', 0)
+               .arg(stats_.bytes / 1e6 / seconds, 0, 'f', 1)
+               .arg(stats_.mediaMs / 1000.0 / seconds, 0, 'f', 1)
+               .arg(stats_.maxLagMs);
+    emit finished();
+}
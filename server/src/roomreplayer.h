@@ -0,0 +1,69 @@
+#pragma once
+// ===============================================
+// server/src/roomreplayer.h
+// 录制回放：把录制段（segmentreader.h）里的帧重新注入一个在线房间，用于培训和事故复盘
+// - 帧直接取自 mmap 的段文件（fromRawData 视图），注入回录制时的房间时不拷贝、不改写；
+//   注入到别的房间时逐帧改写 JSON 和帧头里的 roomId（客户端按 JSON roomId 认房间），需要拷贝
+// - 按帧头 timestampMs 定节奏，speed 倍速；speed <= 0 为不限速，
+//   每轮事件循环最多注入几毫秒的帧再让出，出口调度照常写 socket，可当作转发吞吐基准
+// - 多个发送端时钟不一致：媒体时间只前进不后退，帧头时间的跳变超过服务器到达时间的跳变时按后者计
+// - 帧视图在回放器析构前一直有效，所以回放结束后保留映射（慢连接的发送队列里可能还有帧）
+// ===============================================
+#include <QtCore>
+#include <functional>
+#include "segmentreader.h"
+
+class RoomReplayer : public QObject {
+    Q_OBJECT
+public:
+    enum State { Waiting, Running, Finished };
+    struct Stats {
+        quint64 frames = 0;
+        quint64 bytes = 0;
+        qint64 mediaMs = 0;     // 已回放的录制时长
+        qint64 elapsedMs = 0;   // 实际用时
+        qint64 maxLagMs = 0;    // 定速回放时落后计划的最大值（转发跟不上）
+    };
+    // 注入一帧：type/flags 取自帧头，frame 是完整线格式帧
+    using Sink = std::function<void(quint16 type, const QByteArray& frame, quint16 flags)>;
+
+    RoomReplayer(const QString& roomId, double speed, QObject* parent = nullptr);
+
+    bool open(const QString& path, QString* error = nullptr); // 房间录制目录或单个 .rec
+    void start(Sink sink);
+
+    QString roomId() const { return roomId_; }
+    QString recordedRoomId() const { return recordedRoomId_; }
+    State state() const { return state_; }
+    const Stats& stats() const { return stats_; }
+
+signals:
+    void finished();
+
+private slots:
+    void pump();
+
+private:
+    bool advance(); // 读下一帧并推进媒体时间
+    void finish();
+    QByteArray retarget(const QByteArray& frame) const; // 改写成 roomId_ 的帧，失败返回原帧
+
+    RecordingReader reader_;
+    RecordedFrame next_;
+    bool haveNext_ = false;
+    quint16 nextType_ = 0;
+    quint16 nextFlags_ = 0;
+    bool haveTimestamp_ = false;
+    quint64 lastTimestampMs_ = 0;
+    qint64 lastArrivalMs_ = 0;
+    qint64 mediaMs_ = 0;        // next_ 的媒体时间（相对第一帧）
+
+    QString roomId_;
+    QString recordedRoomId_;
+    double speed_;
+    State state_ = Waiting;
+    Sink sink_;
+    QTimer timer_;
+    QElapsedTimer clock_;
+    Stats stats_;
+};
@@ -0,0 +1,41 @@
+#pragma once
+// ===============================================
+// server/src/segmentformat.h
+// 房间录制的段文件格式（只追加，可 mmap；全部小端）
+// - 目录：<录制目录>/<房间目录名>/<开始时间>-<段号>.rec + 同名 .idx；
+//   目录名是清洗过的 roomId，原始 roomId（UTF-8）写在同目录的 room.id 里，回放以它为准
+// - .rec：16 字节文件头，之后逐条记录 [i64 到达时间ms][u32 帧长][原始帧]，
+//   原始帧就是转发给房间成员的线格式帧（含 64 字节帧头），不做任何转换
+// - .idx：同样的文件头 + 定长稀疏索引项 {到达时间, 记录序号, .rec 内偏移}，
+//   段首一项，之后每隔 1 秒或 1 MiB 一项；按时间/序号二分后顺序扫描
+// - 写入中断（崩溃/断电）只会留下不完整的尾记录，读取时在该处停止
+// ===============================================
+#include <QtCore>
+
+static const char SEGMENT_MAGIC[8] = {'R', 'E', 'X', 'P', 'R', 'E', 'C', '1'};
+static const char SEGMENT_INDEX_MAGIC[8] = {'R', 'E', 'X', 'P', 'I', 'D', 'X', '1'};
+static const quint32 SEGMENT_VERSION = 1;
+static const int SEGMENT_FILE_HEADER_SIZE = 16;   // magic + u32 version + u32 保留
+static const int SEGMENT_RECORD_HEADER_SIZE = 12; // i64 arrivalMs + u32 frameLength
+
+struct SegmentIndexEntry {
+    qint64 arrivalMs;
+    quint64 recordNo;   // 房间内从 0 开始的录制序号，跨段连续
+    quint64 offset;     // 记录头在 .rec 中的偏移
+} __attribute__((packed));
+
+static_assert(sizeof(SegmentIndexEntry) == 24, "SegmentIndexEntry must be 24 bytes");
+
+static const char SEGMENT_ROOM_FILE[] = "room.id";
+
+// 文件系统安全的房间目录名；有字符被替换时追加 roomId 的短哈希，
+// 避免 "工单-1" 和 "任务-1" 这类房间落进同一个目录
+inline QString segmentRoomDirName(const QString& roomId) {
+    QString name;
+    for (const QChar ch : roomId) {
+        name += (ch.isLetterOrNumber() && ch.unicode() < 128) || ch == '-' || ch == '_' ? ch : QChar('_');
+    }
+    if (name == roomId && !name.isEmpty()) return name;
+    const QByteArray hash = QCryptographicHash::hash(roomId.toUtf8(), QCryptographicHash::Sha1).toHex().left(8);
+    return name + '-' + QString::fromLatin1(hash);
+}
@@ -0,0 +1,261 @@
+#include "segmentreader.h"
+#include "../../common/protocol.h"
+#include <QtEndian>
+
+static bool checkFileHeader(const uchar* p, qint64 size, const char magic[8])
+{
+    return size >= SEGMENT_FILE_HEADER_SIZE && memcmp(p, magic, 8) == 0 &&
+           qFromLittleEndian<quint32>(p + 8) == SEGMENT_VERSION;
+}
+
+QString recordedRoomId(const QString& path)
+{
+    const QFileInfo info(path);
+    const QDir dir = info.isDir() ? QDir(path) : info.absoluteDir();
+    QFile roomFile(dir.filePath(SEGMENT_ROOM_FILE));
+    if (roomFile.open(QIODevice::ReadOnly)) {
+        const QString roomId = QString::fromUtf8(roomFile.readAll());
+        if (!roomId.isEmpty()) return roomId;
+    }
+    return dir.dirName();
+}
+
+/* ---------- 单个段 ---------- */
+
+SegmentReader::~SegmentReader()
+{
+    close();
+}
+
+bool SegmentReader::open(const QString& recPath, QString* error)
+{
+    close();
+    data_.setFileName(recPath);
+    if (!data_.open(QIODevice::ReadOnly)) {
+        if (error) *error = data_.errorString();
+        return false;
+    }
+    size_ = data_.size();
+    map_ = size_ > 0 ? data_.map(0, size_) : nullptr;
+    if (!map_ || !checkFileHeader(map_, size_, SEGMENT_MAGIC)) {
+        if (error) *error = QString("%1: not a recording segment").arg(recPath);
+        close();
+        return false;
+    }
+
+    // 索引可选：缺失或损坏时只是不能二分，顺序读取不受影响
+    QString idxPath = recPath;
+    idxPath.replace(QRegularExpression("\\.rec$"), ".idx");
+    index_.setFileName(idxPath);
+    if (index_.open(QIODevice::ReadOnly) && index_.size() > SEGMENT_FILE_HEADER_SIZE) {
+        const qint64 idxSize = index_.size();
+        indexMap_ = index_.map(0, idxSize);
+        if (indexMap_ && checkFileHeader(indexMap_, idxSize, SEGMENT_INDEX_MAGIC)) {
+            indexCount_ = int((idxSize - SEGMENT_FILE_HEADER_SIZE) / qint64(sizeof(SegmentIndexEntry)));
+        } else {
+            qCWarning(logRecording) << "ignoring bad index" << idxPath;
+            indexCount_ = 0;
+        }
+    }
+    firstRecordNo_ = indexCount_ > 0 ? indexAt(0).recordNo : 0;
+    rewind();
+    return true;
+}
+
+void SegmentReader::close()
+{
+    if (map_) data_.unmap(const_cast<uchar*>(map_));
+    if (indexMap_) index_.unmap(const_cast<uchar*>(indexMap_));
+    map_ = nullptr;
+    indexMap_ = nullptr;
+    indexCount_ = 0;
+    size_ = 0;
+    data_.close();
+    index_.close();
+}
+
+void SegmentReader::rewind()
+{
+    pos_ = SEGMENT_FILE_HEADER_SIZE;
+    recordNo_ = firstRecordNo_;
+}
+
+SegmentIndexEntry SegmentReader::indexAt(int i) const
+{
+    SegmentIndexEntry e;
+    memcpy(&e, indexMap_ + SEGMENT_FILE_HEADER_SIZE + qint64(i) * sizeof(SegmentIndexEntry), sizeof(e));
+    e.arrivalMs = qFromLittleEndian(e.arrivalMs);
+    e.recordNo = qFromLittleEndian(e.recordNo);
+    e.offset = qFromLittleEndian(e.offset);
+    return e;
+}
+
+// 最后一个不晚于目标的索引项；没有则 -1
+int SegmentReader::indexFloor(qint64 arrivalMs, quint64 recordNo, bool byTime) const
+{
+    int lo = 0, hi = indexCount_ - 1, found = -1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        const SegmentIndexEntry e = indexAt(mid);
+        const bool before = byTime ? e.arrivalMs <= arrivalMs : e.recordNo <= recordNo;
+        if (before) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+bool SegmentReader::peek(qint64 pos, RecordedFrame* out, qint64* nextPos) const
+{
+    if (!map_ || size_ - pos < SEGMENT_RECORD_HEADER_SIZE) return false;
+    const qint64 arrivalMs = qFromLittleEndian<qint64>(map_ + pos);
+    const quint32 length = qFromLittleEndian<quint32>(map_ + pos + 8);
+    if (length < sizeof(FrameHeader) || length > MAX_FRAME_SIZE ||
+        size_ - pos - SEGMENT_RECORD_HEADER_SIZE < qint64(length)) {
+        return false; // 不完整的尾记录
+    }
+    out->arrivalMs = arrivalMs;
+    out->frame = QByteArray::fromRawData(reinterpret_cast<const char*>(map_ + pos + SEGMENT_RECORD_HEADER_SIZE),
+                                         int(length));
+    *nextPos = pos + SEGMENT_RECORD_HEADER_SIZE + length;
+    return true;
+}
+
+bool SegmentReader::next(RecordedFrame* out)
+{
+    qint64 nextPos;
+    if (!peek(pos_, out, &nextPos)) return false;
+    out->recordNo = recordNo_++;
+    pos_ = nextPos;
+    return true;
+}
+
+bool SegmentReader::seekTime(qint64 arrivalMs)
+{
+    rewind();
+    const int i = indexFloor(arrivalMs, 0, true);
+    if (i >= 0) {
+        const SegmentIndexEntry e = indexAt(i);
+        if (qint64(e.offset) < size_) {
+            pos_ = qint64(e.offset);
+            recordNo_ = e.recordNo;
+        }
+    }
+    // 索引是稀疏的：从最近的索引点顺序扫到目标
+    RecordedFrame r;
+    qint64 nextPos;
+    while (peek(pos_, &r, &nextPos)) {
+        if (r.arrivalMs >= arrivalMs) return true;
+        pos_ = nextPos;
+        recordNo_++;
+    }
+    return false;
+}
+
+bool SegmentReader::seekRecord(quint64 recordNo)
+{
+    rewind();
+    const int i = indexFloor(0, recordNo, false);
+    if (i >= 0) {
+        const SegmentIndexEntry e = indexAt(i);
+        if (qint64(e.offset) < size_) {
+            pos_ = qint64(e.offset);
+            recordNo_ = e.recordNo;
+        }
+    }
+    RecordedFrame r;
+    qint64 nextPos;
+    while (recordNo_ < recordNo && peek(pos_, &r, &nextPos)) {
+        pos_ = nextPos;
+        recordNo_++;
+    }
+    return recordNo_ == recordNo && peek(pos_, &r, &nextPos);
+}
+
+qint64 SegmentReader::firstArrivalMs() const
+{
+    RecordedFrame r;
+    qint64 nextPos;
+    return peek(SEGMENT_FILE_HEADER_SIZE, &r, &nextPos) ? r.arrivalMs : -1;
+}
+
+/* ---------- 整个房间 ---------- */
+
+RecordingReader::~RecordingReader()
+{
+    close();
+}
+
+bool RecordingReader::open(const QString& path, QString* error)
+{
+    close();
+    const QFileInfo info(path);
+    if (info.isDir()) {
+        const QDir dir(path);
+        for (const QString& name : dir.entryList(QStringList() << "*.rec", QDir::Files, QDir::Name)) {
+            files_.append(dir.filePath(name));
+        }
+    } else if (info.isFile()) {
+        files_.append(path);
+    }
+    if (files_.isEmpty()) {
+        if (error) *error = QString("%1: no recording segments").arg(path);
+        return false;
+    }
+    readers_.resize(files_.size());
+    return segment(0, error) != nullptr;
+}
+
+void RecordingReader::close()
+{
+    qDeleteAll(readers_);
+    readers_.clear();
+    files_.clear();
+    current_ = 0;
+}
+
+SegmentReader* RecordingReader::segment(int i, QString* error)
+{
+    if (i < 0 || i >= files_.size()) return nullptr;
+    if (!readers_[i]) {
+        auto* reader = new SegmentReader;
+        if (!reader->open(files_.at(i), error)) {
+            delete reader;
+            return nullptr;
+        }
+        readers_[i] = reader;
+    }
+    return readers_[i];
+}
+
+bool RecordingReader::next(RecordedFrame* out)
+{
+    while (current_ < files_.size()) {
+        SegmentReader* reader = segment(current_);
+        if (reader && reader->next(out)) return true;
+        // 段读完（或打不开）：进入下一个段
+        if (++current_ < files_.size() && segment(current_)) segment(current_)->rewind();
+    }
+    return false;
+}
+
+bool RecordingReader::seekTime(qint64 arrivalMs)
+{
+    // 段按开始时间排序：从最后一个开始时间不晚于目标的段找起
+    int start = 0;
+    for (int i = 0; i < files_.size(); ++i) {
+        SegmentReader* reader = segment(i);
+        if (!reader) continue;
+        const qint64 first = reader->firstArrivalMs();
+        if (first >= 0 && first <= arrivalMs) start = i;
+        else if (first > arrivalMs) break;
+    }
+    for (current_ = start; current_ < files_.size(); ++current_) {
+        SegmentReader* reader = segment(current_);
+        if (reader && reader->seekTime(arrivalMs)) return true;
+    }
+    return false;
+}
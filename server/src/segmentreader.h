@@ -0,0 +1,79 @@
+#pragma once
+// ===============================================
+// server/src/segmentreader.h
+// 录制段的只读访问（格式见 segmentformat.h）
+// - SegmentReader：mmap 一个 .rec 及其 .idx，按稀疏索引二分定位时间/序号，
+//   next() 返回的帧是映射内存上的 QByteArray::fromRawData 视图，不拷贝
+// - RecordingReader：按文件名（开始时间）顺序串起一个房间目录下的所有段；
+//   已打开的段在 RecordingReader 析构前一直保持映射，帧视图可以放心排进发送队列
+// - 末尾不完整的记录（写入中断）视为段结束
+// - recordedRoomId()：录制目录的 room.id 里的原始 roomId（旧录制没有该文件时退回目录名）
+// ===============================================
+#include <QtCore>
+#include "segmentformat.h"
+
+// path：房间目录或其中的 .rec 文件
+QString recordedRoomId(const QString& path);
+
+struct RecordedFrame {
+    qint64 arrivalMs = 0;   // 服务器收到该帧的时间
+    quint64 recordNo = 0;   // 房间内录制序号
+    QByteArray frame;       // 原始线格式帧（映射内存视图）
+};
+
+class SegmentReader {
+public:
+    SegmentReader() = default;
+    ~SegmentReader();
+
+    bool open(const QString& recPath, QString* error = nullptr);
+    void close();
+    QString fileName() const { return data_.fileName(); }
+
+    bool seekTime(qint64 arrivalMs);    // 定位到第一条到达时间 >= arrivalMs 的记录
+    bool seekRecord(quint64 recordNo);  // 定位到该序号的记录
+    void rewind();
+    bool next(RecordedFrame* out);      // 段结束（或遇到不完整记录）返回 false
+
+    qint64 firstArrivalMs() const;      // 空段返回 -1
+
+private:
+    Q_DISABLE_COPY(SegmentReader)
+
+    bool peek(qint64 pos, RecordedFrame* out, qint64* nextPos) const;
+    int indexFloor(qint64 arrivalMs, quint64 recordNo, bool byTime) const;
+    SegmentIndexEntry indexAt(int i) const;
+
+    QFile data_;
+    QFile index_;
+    const uchar* map_ = nullptr;
+    qint64 size_ = 0;
+    const uchar* indexMap_ = nullptr;
+    int indexCount_ = 0;
+    qint64 pos_ = SEGMENT_FILE_HEADER_SIZE;
+    quint64 recordNo_ = 0;
+    quint64 firstRecordNo_ = 0;
+};
+
+class RecordingReader {
+public:
+    RecordingReader() = default;
+    ~RecordingReader();
+
+    // path：房间目录（读全部段）或单个 .rec 文件
+    bool open(const QString& path, QString* error = nullptr);
+    void close();
+    QStringList segments() const { return files_; }
+
+    bool seekTime(qint64 arrivalMs);
+    bool next(RecordedFrame* out);
+
+private:
+    Q_DISABLE_COPY(RecordingReader)
+
+    SegmentReader* segment(int i, QString* error = nullptr);
+
+    QStringList files_;
+    QVector<SegmentReader*> readers_; // 懒打开，析构时统一解除映射
+    int current_ = 0;
+};
@@ -0,0 +1,165 @@
+#include "sessionstore.h"
+#include <QUuid>
+#include <QSqlQuery>
+#include <QSqlError>
+
+SessionStore::SessionStore(qint64 ttlMs)
+    : ttlMs_(ttlMs)
+    , wheel_(WHEEL_SLOTS)
+{
+}
+
+// sessions.expires_at 与 SQLite datetime('now') 同格式（UTC）
+QString SessionStore::toSqlTime(qint64 ms) {
+    return QDateTime::fromMSecsSinceEpoch(ms, Qt::UTC).toString("yyyy-MM-dd HH:mm:ss");
+}
+
+qint64 SessionStore::fromSqlTime(const QString& text) {
+    QDateTime dt = QDateTime::fromString(text, "yyyy-MM-dd HH:mm:ss");
+    dt.setTimeSpec(Qt::UTC);
+    return dt.isValid() ? dt.toMSecsSinceEpoch() : 0;
+}
+
+void SessionStore::scheduleExpiry(const QString& token, qint64 expiresAtMs) {
+    // 调用方已持锁；超过一圈的会话在到期槽里会被跳过，下一圈再处理
+    const qint64 minute = expiresAtMs / SLOT_MS;
+    wheel_[static_cast<int>(minute % WHEEL_SLOTS)].append(token);
+}
+
+int SessionStore::load(QSqlDatabase db) {
+    QMutexLocker locker(&mutex_);
+
+    QSqlQuery query(db);
+    if (!query.exec("DELETE FROM sessions WHERE expires_at <= datetime('now')")) {
+        qWarning() << "Failed to purge expired sessions:" << query.lastError().text();
+    }
+    if (!query.exec("SELECT token, username, expires_at FROM sessions WHERE expires_at > datetime('now')")) {
+        qWarning() << "Failed to load sessions:" << query.lastError().text();
+        return 0;
+    }
+
+    int loaded = 0;
+    while (query.next()) {
+        Session s;
+        s.username = query.value(1).toString();
+        s.expiresAtMs = fromSqlTime(query.value(2).toString());
+        const QString token = query.value(0).toString();
+        sessions_.insert(token, s);
+        scheduleExpiry(token, s.expiresAtMs);
+        ++loaded;
+    }
+    wheelMinute_ = QDateTime::currentMSecsSinceEpoch() / SLOT_MS;
+    return loaded;
+}
+
+QString SessionStore::create(const QString& username) {
+    // 生成随机会话令牌
+    QByteArray raw = QUuid::createUuid().toByteArray().toBase64();
+    const QString token = QString(raw).remove('=').remove('+').remove('/');
+
+    Session s;
+    s.username = username;
+    s.expiresAtMs = QDateTime::currentMSecsSinceEpoch() + ttlMs_;
+
+    QMutexLocker locker(&mutex_);
+    sessions_.insert(token, s);
+    scheduleExpiry(token, s.expiresAtMs);
+    pendingInserts_.append(qMakePair(token, s));
+    return token;
+}
+
+bool SessionStore::lookup(const QString& token, Session* out) const {
+    if (token.isEmpty()) return false;
+
+    QMutexLocker locker(&mutex_);
+    auto it = sessions_.constFind(token);
+    if (it == sessions_.constEnd()) return false;
+    if (it->expiresAtMs <= QDateTime::currentMSecsSinceEpoch()) return false; // 未到清理时刻也视为过期
+    if (out) *out = it.value();
+    return true;
+}
+
+int SessionStore::sweepExpired(qint64 nowMs) {
+    QMutexLocker locker(&mutex_);
+
+    const qint64 nowMinute = nowMs / SLOT_MS;
+    if (wheelMinute_ < 0) wheelMinute_ = nowMinute;
+    // 长时间没推进（例如挂起）时最多转一圈
+    qint64 from = qMax(wheelMinute_, nowMinute - WHEEL_SLOTS + 1);
+
+    int removed = 0;
+    for (qint64 minute = from; minute <= nowMinute; ++minute) {
+        QVector<QString>& slot = wheel_[static_cast<int>(minute % WHEEL_SLOTS)];
+        QVector<QString> keep;
+        for (const QString& token : slot) {
+            auto it = sessions_.find(token);
+            if (it == sessions_.end()) continue;
+            if (it->expiresAtMs <= nowMs) {
+                sessions_.erase(it);
+                ++removed;
+            } else {
+                keep.append(token);
+            }
+        }
+        slot.swap(keep);
+    }
+    wheelMinute_ = nowMinute;
+
+    if (removed > 0) pendingDelete_ = true;
+    return removed;
+}
+
+bool SessionStore::flush(QSqlDatabase db) {
+    QVector<QPair<QString, Session>> inserts;
+    bool purge = false;
+    {
+        QMutexLocker locker(&mutex_);
+        inserts.swap(pendingInserts_);
+        purge = pendingDelete_;
+        pendingDelete_ = false;
+    }
+    if (inserts.isEmpty() && !purge) return true;
+
+    db.transaction();
+    bool ok = true;
+
+    if (!inserts.isEmpty()) {
+        QVariantList tokens, usernames, expires;
+        for (const auto& entry : inserts) {
+            tokens << entry.first;
+            usernames << entry.second.username;
+            expires << toSqlTime(entry.second.expiresAtMs);
+        }
+        QSqlQuery query(db);
+        query.prepare("INSERT OR REPLACE INTO sessions (token, username, expires_at) VALUES (?, ?, ?)");
+        query.addBindValue(tokens);
+        query.addBindValue(usernames);
+        query.addBindValue(expires);
+        if (!query.execBatch()) {
+            qWarning() << "Failed to persist sessions:" << query.lastError().text();
+            ok = false;
+        }
+    }
+
+    if (ok && purge) {
+        QSqlQuery query(db);
+        if (!query.exec("DELETE FROM sessions WHERE expires_at <= datetime('now')")) {
+            qWarning() << "Failed to purge expired sessions:" << query.lastError().text();
+            ok = false;
+        }
+    }
+
+    if (ok && db.commit()) return true;
+
+    // 写库失败：回滚并放回队列，下次 flush 重试
+    db.rollback();
+    QMutexLocker locker(&mutex_);
+    pendingInserts_ = inserts + pendingInserts_;
+    pendingDelete_ = pendingDelete_ || purge;
+    return false;
+}
+
+int SessionStore::size() const {
+    QMutexLocker locker(&mutex_);
+    return sessions_.size();
+}
@@ -0,0 +1,45 @@
+#pragma once
+// ===============================================
+// server/src/sessionstore.h
+// 内存会话表：token -> {username, 过期时间}，令牌校验为 O(1) 内存查找
+// - 过期：按分钟分槽的时间轮，每次只检查到期槽，批量清理
+// - 持久化：新会话先进内存，再由 flush() 批量写回 sessions 表（write-behind）
+// - 启动时从 sessions 表恢复未过期会话
+// 线程安全：所有接口可在任意线程调用
+// ===============================================
+#include <QtCore>
+#include <QtSql>
+
+class SessionStore {
+public:
+    struct Session {
+        QString username;
+        qint64 expiresAtMs = 0; // UTC 毫秒
+    };
+
+    explicit SessionStore(qint64 ttlMs = 24LL * 3600 * 1000);
+
+    int load(QSqlDatabase db);                       // 启动时恢复；返回恢复条数
+    QString create(const QString& username);         // 新建会话并排队写库，返回 token
+    bool lookup(const QString& token, Session* out = nullptr) const;
+    int sweepExpired(qint64 nowMs);                  // 推进时间轮，返回清理条数
+    bool flush(QSqlDatabase db);                     // 批量写入新会话 + 删除过期行
+
+    int size() const;
+
+private:
+    static const int WHEEL_SLOTS = 24 * 60 + 1; // 1 分钟一槽，覆盖 24 小时有效期
+    static const qint64 SLOT_MS = 60 * 1000;
+
+    mutable QMutex mutex_;
+    qint64 ttlMs_;
+    QHash<QString, Session> sessions_;
+    QVector<QVector<QString>> wheel_;   // 槽 -> 该分钟到期的 token
+    qint64 wheelMinute_ = -1;           // 时间轮已推进到的分钟
+    QVector<QPair<QString, Session>> pendingInserts_;
+    bool pendingDelete_ = false;        // 内存里清理过，库里也需要删一次
+
+    void scheduleExpiry(const QString& token, qint64 expiresAtMs);
+    static QString toSqlTime(qint64 ms);
+    static qint64 fromSqlTime(const QString& text);
+};
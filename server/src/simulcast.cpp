@@ -0,0 +1,131 @@
+#include "simulcast.h"
+
+// 超过这个时间没收到某层的帧，视为发布者已停发该层。
+// 静止画面下 tile16 只在周期关键帧时出帧，低帧率时间隔可达十几秒
+static const qint64 LAYER_TIMEOUT_MS = 15000;
+// 同一发布者最多每秒收到一次服务器代发的关键帧请求
+static const qint64 KEYFRAME_REQUEST_INTERVAL_MS = 1000;
+
+// 订阅者队列积压超过此值即降层；低于 UP 阈值并保持 upHold 才升层
+static const qint64 DOWN_BACKLOG_BYTES = 256 * 1024;
+static const qint64 UP_BACKLOG_BYTES = 32 * 1024;
+static const qint64 DOWN_COOLDOWN_MS = 1000;    // 降层后等队列消化再判断
+static const qint64 UP_HOLD_BASE_MS = 4000;
+static const qint64 UP_HOLD_MAX_MS = 60000;
+static const qint64 PROBE_WINDOW_MS = 10000;    // 升层后这么久内又降层，算试探失败
+
+static int lowestLayer(quint32 active)
+{
+    for (int l = 1; l <= SIMULCAST_MAX_LAYERS; ++l)
+        if (active & (1u << (l - 1))) return l;
+    return 0;
+}
+
+static int highestLayer(quint32 active)
+{
+    for (int l = SIMULCAST_MAX_LAYERS; l >= 1; --l)
+        if (active & (1u << (l - 1))) return l;
+    return 0;
+}
+
+static int layerBelow(quint32 active, int layer)
+{
+    for (int l = layer - 1; l >= 1; --l)
+        if (active & (1u << (l - 1))) return l;
+    return 0;
+}
+
+static int layerAbove(quint32 active, int layer)
+{
+    for (int l = layer + 1; l <= SIMULCAST_MAX_LAYERS; ++l)
+        if (active & (1u << (l - 1))) return l;
+    return 0;
+}
+
+/* ---------- 发布者 ---------- */
+
+void SimulcastSource::onFrame(int layer, qint64 nowMs)
+{
+    if (layer >= 1 && layer <= SIMULCAST_MAX_LAYERS) lastSeenMs_[layer - 1] = nowMs;
+}
+
+quint32 SimulcastSource::activeLayers(qint64 nowMs) const
+{
+    quint32 mask = 0;
+    for (int i = 0; i < SIMULCAST_MAX_LAYERS; ++i) {
+        if (lastSeenMs_[i] > 0 && nowMs - lastSeenMs_[i] <= LAYER_TIMEOUT_MS) mask |= 1u << i;
+    }
+    return mask;
+}
+
+bool SimulcastSource::keyframeRequestDue(qint64 nowMs)
+{
+    if (nowMs - lastKeyframeRequestMs_ < KEYFRAME_REQUEST_INTERVAL_MS) return false;
+    lastKeyframeRequestMs_ = nowMs;
+    return true;
+}
+
+/* ---------- 订阅者 ---------- */
+
+void SimulcastSelector::updateTarget(quint32 active, qint64 backlogBytes,
+                                     quint64 droppedVideo, qint64 nowMs)
+{
+    if (upHoldMs_ == 0) upHoldMs_ = UP_HOLD_BASE_MS;
+    // droppedVideo 是订阅者连接的累计值：新选择器以当前值为基线，
+    // 订阅之前（或对其他发布者）的丢帧不算本次拥塞
+    if (target_ == 0) lastDropped_ = droppedVideo;
+    const bool congested = backlogBytes > DOWN_BACKLOG_BYTES || droppedVideo > lastDropped_;
+    lastDropped_ = droppedVideo;
+
+    if (target_ == 0) {
+        // 新订阅：队列空闲就直接从最高层开始，否则从最低层试探
+        target_ = congested || backlogBytes > UP_BACKLOG_BYTES ? lowestLayer(active) : highestLayer(active);
+        lastDownMs_ = nowMs;
+    } else if (!(active & (1u << (target_ - 1)))) {
+        // 目标层已停发：退到不高于它的最高在发层
+        const int below = layerBelow(active, target_);
+        target_ = below ? below : lowestLayer(active);
+    }
+
+    if (congested) {
+        calmSinceMs_ = -1;
+        if (nowMs - lastDownMs_ < DOWN_COOLDOWN_MS) return;
+        const int from = current_ ? qMin(current_, target_) : target_;
+        const int lower = layerBelow(active, from);
+        if (!lower) return;
+        target_ = lower;
+        lastDownMs_ = nowMs;
+        upHoldMs_ = nowMs - lastUpMs_ < PROBE_WINDOW_MS ? qMin(upHoldMs_ * 2, UP_HOLD_MAX_MS)
+                                                       : UP_HOLD_BASE_MS;
+        return;
+    }
+
+    if (backlogBytes >= UP_BACKLOG_BYTES || current_ != target_) {
+        calmSinceMs_ = -1;
+        return;
+    }
+    if (calmSinceMs_ < 0) {
+        calmSinceMs_ = nowMs;
+        return;
+    }
+    if (nowMs - calmSinceMs_ < upHoldMs_) return;
+    const int higher = layerAbove(active, target_);
+    if (!higher) return;
+    target_ = higher;
+    calmSinceMs_ = -1;
+    lastUpMs_ = nowMs;
+}
+
+SimulcastSelector::Decision SimulcastSelector::onFrame(int layer, bool switchPoint, quint32 activeLayers,
+                                                       qint64 backlogBytes, quint64 droppedVideo, qint64 nowMs)
+{
+    updateTarget(activeLayers, backlogBytes, droppedVideo, nowMs);
+
+    Decision d;
+    if (layer == target_ && current_ != target_) {
+        if (switchPoint) current_ = target_;
+        else d.needKeyframe = true;
+    }
+    d.forward = layer == current_;
+    return d;
+}
@@ -0,0 +1,51 @@
+#pragma once
+// ===============================================
+// server/src/simulcast.h
+// 分层转发（simulcast）：发布者同时发送 2~3 个质量层的 MSG_VIDEO_FRAME，
+// 帧头 layer 字段标出层号（1 = 最低质量，0 = 未分层，按普通广播处理）
+// - SimulcastSource：发布者最近在发哪些层（上行自适应可能停发高层）
+// - SimulcastSelector：某个订阅者针对某个发布者的选层状态。
+//   依据订阅者自己的发送队列：积压超限或新增丢视频帧 -> 降一层；
+//   持续空闲一段时间 -> 试探升一层，试探失败则拉长下次试探的等待
+// - 只在目标层的关键帧处切换（tile16 增量帧依赖同一层的前一帧），
+//   等待期间继续转发当前层，并提示服务器代为向发布者请求关键帧
+// ===============================================
+#include <QtCore>
+#include "../../common/protocol.h"
+
+class SimulcastSource {
+public:
+    void onFrame(int layer, qint64 nowMs);
+    quint32 activeLayers(qint64 nowMs) const;  // bit (layer-1) = 最近发过该层
+    bool keyframeRequestDue(qint64 nowMs);     // 代订阅者请求关键帧的限频
+
+private:
+    qint64 lastSeenMs_[SIMULCAST_MAX_LAYERS] = {};
+    qint64 lastKeyframeRequestMs_ = 0;
+};
+
+class SimulcastSelector {
+public:
+    struct Decision {
+        bool forward = false;       // 把这一帧发给订阅者
+        bool needKeyframe = false;  // 在等目标层的关键帧
+    };
+
+    // layer: 1..SIMULCAST_MAX_LAYERS；switchPoint: 帧可独立解码（非增量帧）
+    Decision onFrame(int layer, bool switchPoint, quint32 activeLayers,
+                     qint64 backlogBytes, quint64 droppedVideo, qint64 nowMs);
+
+    int currentLayer() const { return current_; }  // 0 = 尚未锁定任何层
+    int targetLayer() const { return target_; }
+
+private:
+    void updateTarget(quint32 active, qint64 backlogBytes, quint64 droppedVideo, qint64 nowMs);
+
+    int current_ = 0;
+    int target_ = 0;
+    quint64 lastDropped_ = 0;  // 上次看到的累计丢帧数，建立选择器时取当前值
+    qint64 calmSinceMs_ = -1;   // 积压持续低于升层阈值的起点
+    qint64 lastDownMs_ = 0;
+    qint64 lastUpMs_ = 0;
+    qint64 upHoldMs_ = 0;       // 当前的升层等待时长（试探失败后翻倍）
+};
@@ -0,0 +1,52 @@
+#include "timerwheel.h"
+
+TimerWheel::TimerWheel(int slots, qint64 tickMs)
+    : tickMs_(qMax<qint64>(1, tickMs))
+    , slots_(qMax(1, slots))
+{
+}
+
+int TimerWheel::slotFor(qint64 dueMs) const
+{
+    return int((dueMs / tickMs_) % slots_.size());
+}
+
+void TimerWheel::schedule(ClientCtx* c, qint64 dueMs)
+{
+    cancel(c);
+    // 已经走过的 tick 不会再扫：过期时间至少落在下一个 tick
+    if (cursorTick_ >= 0) dueMs = qMax(dueMs, (cursorTick_ + 1) * tickMs_);
+    due_.insert(c, dueMs);
+    slots_[slotFor(dueMs)].insert(c);
+}
+
+void TimerWheel::cancel(ClientCtx* c)
+{
+    auto it = due_.find(c);
+    if (it == due_.end()) return;
+    slots_[slotFor(it.value())].remove(c);
+    due_.erase(it);
+}
+
+QVector<ClientCtx*> TimerWheel::expire(qint64 nowMs)
+{
+    QVector<ClientCtx*> out;
+    const qint64 nowTick = nowMs / tickMs_;
+    if (cursorTick_ < 0) cursorTick_ = nowTick - 1;
+    // 停顿超过一圈时每个槽扫一次就够了
+    const qint64 first = qMax(cursorTick_ + 1, nowTick - slots_.size() + 1);
+    for (qint64 tick = first; tick <= nowTick; ++tick) {
+        QSet<ClientCtx*>& slot = slots_[int(tick % slots_.size())];
+        for (auto it = slot.begin(); it != slot.end(); ) {
+            if (due_.value(*it) <= nowMs) {
+                out.append(*it);
+                due_.remove(*it);
+                it = slot.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    cursorTick_ = qMax(cursorTick_, nowTick);
+    return out;
+}
@@ -0,0 +1,32 @@
+#pragma once
+// ===============================================
+// server/src/timerwheel.h
+// 分片内所有连接共用的哈希时间轮（心跳/空闲检测），代替每个 socket 一个 QTimer
+// - 槽宽 tickMs，共 slots 个槽；到期时间落在 (due/tickMs) % slots 槽，
+//   超过一圈的条目留在槽里，转到时比较到期时间再决定是否取出
+// - schedule/cancel O(1)；expire 只遍历走过的槽
+// - 每个连接最多一个条目，重新 schedule 会替换旧条目
+// ===============================================
+#include <QtCore>
+
+struct ClientCtx;
+
+class TimerWheel {
+public:
+    TimerWheel(int slots, qint64 tickMs);
+
+    void schedule(ClientCtx* c, qint64 dueMs);
+    void cancel(ClientCtx* c);
+    QVector<ClientCtx*> expire(qint64 nowMs); // 取出所有到期条目（按槽顺序）
+
+    int size() const { return due_.size(); }
+    qint64 tickMs() const { return tickMs_; }
+
+private:
+    int slotFor(qint64 dueMs) const;
+
+    qint64 tickMs_;
+    QVector<QSet<ClientCtx*>> slots_;
+    QHash<ClientCtx*, qint64> due_;   // 条目 -> 到期时间
+    qint64 cursorTick_ = -1;          // 上次 expire 走到的 tick
+};